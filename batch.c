@@ -0,0 +1,2380 @@
+/* Batch SGP4 propagation, see the sgp4_batch_t notes in predict.h.
+
+   SGP4Group() is SGP4() rewritten to work on a group of satellites at
+   once.  It follows SGP4() operation for operation, so each lane gives
+   exactly the same result SGP4() would for that satellite.  Arithmetic
+   is done on whole vectors; transcendental functions go through libm
+   one lane at a time.  Asked not to be exact, it takes its sines,
+   cosines and arctangents from the vector math of lanemath.h instead,
+   and its powers from multiplying and square roots.
+
+   Satellites are grouped by orbit class as well, so that every lane of
+   a group either has SIMPLE_FLAG set or hasn't.  SGP4Group() is built
+   from GroupKernel() for each class, exact or not, and picks between
+   them once per group instead of testing and masking lanes inside the
+   equations.
+
+   The kernels are built again for each instruction set the compiler
+   can target beyond the baseline (AVX2 and AVX-512 on x86-64), and
+   SGP4BatchSelectKernels() picks the best the processor has once, at
+   start up.  Everything a kernel calls is forced inline, so all of it
+   is built for the kernel's instruction set.  Floating point is never
+   contracted into fused multiply-adds (setup.py builds with
+   -ffp-contract=off), so every build gives the same bits. */
+
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "predict.h"
+#include "lanemath.h"
+
+#define LANE_MAP(name, fn) \
+	LANE_INLINE lane_t name(lane_t x) \
+	{ \
+		lane_t r; \
+		int i; \
+		for (i=0; i<SGP4_LANES; i++) \
+			r[i]=fn(x[i]); \
+		return r; \
+	}
+
+LANE_MAP(lane_sin, sin)
+LANE_MAP(lane_cos, cos)
+
+LANE_INLINE lane_t lane_pow(lane_t x, double y)
+{
+	lane_t r;
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+		r[i]=pow(x[i],y);
+
+	return r;
+}
+
+LANE_INLINE void lane_sincos_masked(lane_mask_t mask, lane_t x, lane_t *sinx, lane_t *cosx)
+{
+	/* Updates sinx and cosx only in the lanes where mask is set */
+
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+		if (mask[i])
+		{
+			(*sinx)[i]=sin(x[i]);
+			(*cosx)[i]=cos(x[i]);
+		}
+}
+
+LANE_INLINE lane_t lane_actan(lane_t sinx, lane_t cosx)
+{
+	lane_t r;
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+		r[i]=AcTan(sinx[i],cosx[i]);
+
+	return r;
+}
+
+/* The kernel's trigonometry, through libm one lane at a time when */
+/* exact, as SGP4() does it, or else through lanemath.h.           */
+
+LANE_INLINE void lane_trig(lane_t x, lane_t *sinx, lane_t *cosx, const int exact)
+{
+	if (exact)
+	{
+		*sinx=lane_sin(x);
+		*cosx=lane_cos(x);
+	}
+	else
+		lane_sincos(x, sinx, cosx);
+}
+
+LANE_INLINE lane_t lane_trig_sin(lane_t x, const int exact)
+{
+	lane_t sinx, cosx;
+
+	if (exact)
+		return lane_sin(x);
+
+	lane_sincos(x, &sinx, &cosx);
+	return sinx;
+}
+
+LANE_INLINE lane_t lane_trig_cos(lane_t x, const int exact)
+{
+	lane_t sinx, cosx;
+
+	if (exact)
+		return lane_cos(x);
+
+	lane_sincos(x, &sinx, &cosx);
+	return cosx;
+}
+
+LANE_INLINE void lane_trig_masked(lane_mask_t mask, lane_t x, lane_t *sinx, lane_t *cosx, const int exact)
+{
+	/* Updates sinx and cosx only in the lanes where mask is set */
+
+	lane_t sinv, cosv;
+
+	if (exact)
+		lane_sincos_masked(mask, x, sinx, cosx);
+	else
+	{
+		lane_sincos(x, &sinv, &cosv);
+		*sinx=lane_select(mask, sinv, *sinx);
+		*cosx=lane_select(mask, cosv, *cosx);
+	}
+}
+
+LANE_INLINE lane_t lane_trig_actan(lane_t sinx, lane_t cosx, const int exact)
+{
+	/* AcTan(), from 0 to 2 pi */
+
+	lane_t r;
+
+	if (exact)
+		return lane_actan(sinx, cosx);
+
+	r=lane_atan2(sinx, cosx);
+	return lane_select(r<0.0, r+twopi, r);
+}
+
+LANE_INLINE void GroupKernel(const sgp4_group_t *g, const lane_t *times, lane_t pos[3], lane_t vel[3], const int simple, const int exact)
+{
+	/* SGP4Group() for a group whose lanes all have SIMPLE_FLAG */
+	/* set if simple is, or all have it clear if it isn't.  It  */
+	/* is only called with simple and exact constant, so each   */
+	/* caller gets its own copy with the other orbit class, and */
+	/* libm or lanemath.h, compiled out.                        */
+
+	lane_t cosuk, sinuk, rfdotk, vx, vy, vz, ux, uy, uz, xmy, xmx, cosnok,
+	sinnok, cosik, sinik, rdotk, xinck, xnodek, uk, rk, cos2u, sin2u,
+	u, sinu, cosu, betal, rfdot, rdot, r, pl, elsq, esine, ecose, epw,
+	cosepw, tfour, sinepw, capu, ayn, xlt, aynl, xll, axn, xn, beta,
+	xl, e, a, tcube, delm, delomg, templ, tempe, tempa, xnode, tsq, xmp,
+	omega, xnoddf, omgadf, xmdf, temp, temp1, temp2, temp3, temp4,
+	temp5, temp6, delta, sinomg, cosomg, tsince=*times;
+
+	lane_mask_t active, converged;
+
+	int i;
+
+	/* Update for secular gravity and atmospheric drag. */
+	xmdf=g->xmo+g->xmdot*tsince;
+	omgadf=g->omegao+g->omgdot*tsince;
+	xnoddf=g->xnodeo+g->xnodot*tsince;
+	omega=omgadf;
+	xmp=xmdf;
+	tsq=tsince*tsince;
+	xnode=xnoddf+g->xnodcf*tsq;
+	tempa=1-g->c1*tsince;
+	tempe=g->bstar*g->c4*tsince;
+	templ=g->t2cof*tsq;
+
+	if (!simple)
+	{
+		delomg=g->omgcof*tsince;
+		temp=1+g->eta*lane_trig_cos(xmdf,exact);
+		delm=g->xmcof*((exact ? lane_pow(temp,3) : temp*temp*temp)-g->delmo);
+		temp=delomg+delm;
+		xmp=xmdf+temp;
+		omega=omgadf-temp;
+		tcube=tsq*tsince;
+		tfour=tsince*tcube;
+		tempa=tempa-g->d2*tsq-g->d3*tcube-g->d4*tfour;
+		tempe=tempe+g->bstar*g->c5*(lane_trig_sin(xmp,exact)-g->sinmo);
+		templ=templ+g->t3cof*tcube+tfour*(g->t4cof+tsince*g->t5cof);
+	}
+
+	a=g->aodp*(tempa*tempa);  /* pow(tempa,2) is exactly this */
+	e=g->eo-tempe;
+	xl=xmp+omega+xnode+g->xnodp*templ;
+	beta=lane_sqrt(1-e*e);
+	xn=xke/(exact ? lane_pow(a,1.5) : a*lane_sqrt(a));
+
+	/* Long period periodics */
+	lane_trig(omega,&sinomg,&cosomg,exact);
+	axn=e*cosomg;
+	temp=1/(a*beta*beta);
+	xll=temp*g->xlcof*axn;
+	aynl=temp*g->aycof;
+	xlt=xl+xll;
+	ayn=e*sinomg+aynl;
+
+	/* Solve Kepler's Equation.  Each lane stops iterating, and */
+	/* keeps the terms of its last iteration, as soon as it has */
+	/* converged; the group stops once every lane has.          */
+	capu=lane_fmod2p(xlt-xnode);
+	temp2=capu;
+	temp3=temp4=temp5=temp6=sinepw=cosepw=capu;
+	active=~(lane_mask_t){0};
+
+	for (i=0; i<=10 && lane_any(active); i++)
+	{
+		lane_trig_masked(active,temp2,&sinepw,&cosepw,exact);
+		temp3=lane_select(active,axn*sinepw,temp3);
+		temp4=lane_select(active,ayn*cosepw,temp4);
+		temp5=lane_select(active,axn*cosepw,temp5);
+		temp6=lane_select(active,ayn*sinepw,temp6);
+		epw=(capu-temp4+temp3-temp2)/(1-temp5-temp6)+temp2;
+
+		delta=epw-temp2;
+		converged=(delta<=e6a)&(delta>=-e6a);
+		active&=~converged;
+		temp2=lane_select(active,epw,temp2);
+	}
+
+	/* Short period preliminary quantities */
+	ecose=temp5+temp6;
+	esine=temp3-temp4;
+	elsq=axn*axn+ayn*ayn;
+	temp=1-elsq;
+	pl=a*temp;
+	r=a*(1-ecose);
+	temp1=1/r;
+	rdot=xke*lane_sqrt(a)*esine*temp1;
+	rfdot=xke*lane_sqrt(pl)*temp1;
+	temp2=a*temp1;
+	betal=lane_sqrt(temp);
+	temp3=1/(1+betal);
+	cosu=temp2*(cosepw-axn+ayn*esine*temp3);
+	sinu=temp2*(sinepw-ayn-axn*esine*temp3);
+	u=lane_trig_actan(sinu,cosu,exact);
+	sin2u=2*sinu*cosu;
+	cos2u=2*cosu*cosu-1;
+	temp=1/pl;
+	temp1=ck2*temp;
+	temp2=temp1*temp;
+
+	/* Update for short periodics */
+	rk=r*(1-1.5*temp2*betal*g->x3thm1)+0.5*temp1*g->x1mth2*cos2u;
+	uk=u-0.25*temp2*g->x7thm1*sin2u;
+	xnodek=xnode+1.5*temp2*g->cosio*sin2u;
+	xinck=g->xincl+1.5*temp2*g->cosio*g->sinio*cos2u;
+	rdotk=rdot-xn*temp1*g->x1mth2*sin2u;
+	rfdotk=rfdot+xn*temp1*(g->x1mth2*cos2u+1.5*g->x3thm1);
+
+	/* Orientation vectors */
+	lane_trig(uk,&sinuk,&cosuk,exact);
+	lane_trig(xinck,&sinik,&cosik,exact);
+	lane_trig(xnodek,&sinnok,&cosnok,exact);
+	xmx=-sinnok*cosik;
+	xmy=cosnok*cosik;
+	ux=xmx*sinuk+cosnok*cosuk;
+	uy=xmy*sinuk+sinnok*cosuk;
+	uz=sinik*sinuk;
+	vx=xmx*cosuk-cosnok*sinuk;
+	vy=xmy*cosuk-sinnok*sinuk;
+	vz=sinik*cosuk;
+
+	/* Position and velocity */
+	pos[0]=rk*ux;
+	pos[1]=rk*uy;
+	pos[2]=rk*uz;
+	vel[0]=rdotk*ux+rfdotk*vx;
+	vel[1]=rdotk*uy+rfdotk*vy;
+	vel[2]=rdotk*uz+rfdotk*vz;
+}
+
+static void SetLane(sgp4_group_t *g, int i, const context_t *c)
+{
+	/* Puts the satellite of context c, which PreCalc() has */
+	/* initialized, into lane i of group g.                 */
+
+	g->xmo[i]=c->tle.xmo;
+	g->xnodeo[i]=c->tle.xnodeo;
+	g->omegao[i]=c->tle.omegao;
+	g->eo[i]=c->tle.eo;
+	g->xincl[i]=c->tle.xincl;
+	g->bstar[i]=c->tle.bstar;
+	g->jul_epoch[i]=Julian_Date_of_Epoch(c->tle.epoch);
+	g->aodp[i]=c->sgp4.aodp;
+	g->aycof[i]=c->sgp4.aycof;
+	g->c1[i]=c->sgp4.c1;
+	g->c4[i]=c->sgp4.c4;
+	g->c5[i]=c->sgp4.c5;
+	g->cosio[i]=c->sgp4.cosio;
+	g->d2[i]=c->sgp4.d2;
+	g->d3[i]=c->sgp4.d3;
+	g->d4[i]=c->sgp4.d4;
+	g->delmo[i]=c->sgp4.delmo;
+	g->omgcof[i]=c->sgp4.omgcof;
+	g->eta[i]=c->sgp4.eta;
+	g->omgdot[i]=c->sgp4.omgdot;
+	g->sinio[i]=c->sgp4.sinio;
+	g->xnodp[i]=c->sgp4.xnodp;
+	g->sinmo[i]=c->sgp4.sinmo;
+	g->t2cof[i]=c->sgp4.t2cof;
+	g->t3cof[i]=c->sgp4.t3cof;
+	g->t4cof[i]=c->sgp4.t4cof;
+	g->t5cof[i]=c->sgp4.t5cof;
+	g->x1mth2[i]=c->sgp4.x1mth2;
+	g->x3thm1[i]=c->sgp4.x3thm1;
+	g->x7thm1[i]=c->sgp4.x7thm1;
+	g->xmcof[i]=c->sgp4.xmcof;
+	g->xmdot[i]=c->sgp4.xmdot;
+	g->xnodcf[i]=c->sgp4.xnodcf;
+	g->xnodot[i]=c->sgp4.xnodot;
+	g->xlcof[i]=c->sgp4.xlcof;
+	g->simple=isFlagSet((context_t *)c, SIMPLE_FLAG)!=0;
+}
+
+/* Satellites are found by NORAD id through an open addressed table */
+/* of batch index+1 (0 where empty), at most half full.              */
+
+static int IndexSlots(int count)
+{
+	int slots=16;
+
+	while (slots<2*count)
+		slots*=2;
+
+	return slots;
+}
+
+static inline long IndexCatnum(sat_struct *const *sat, int index)
+{
+	/* NORAD id of sat[index], which SGP4BatchUpdate() may be */
+	/* swapping for a copy with the same one                  */
+
+	return __atomic_load_n(&sat[index], __ATOMIC_ACQUIRE)->catnum;
+}
+
+static int IndexFind(const int *slot, int slots, sat_struct *const *sat, long catnum)
+{
+	unsigned long h;
+
+	for (h=(unsigned long)catnum*2654435761UL; slot[h&(slots-1)]!=0; h++)
+		if (IndexCatnum(sat, slot[h&(slots-1)]-1)==catnum)
+			return slot[h&(slots-1)]-1;
+
+	return -1;
+}
+
+static void IndexAdd(int *slot, int slots, sat_struct *const *sat, int index)
+{
+	/* The first satellite with a NORAD id keeps it */
+
+	unsigned long h;
+
+	for (h=(unsigned long)sat[index]->catnum*2654435761UL; slot[h&(slots-1)]!=0; h++)
+		if (IndexCatnum(sat, slot[h&(slots-1)]-1)==sat[index]->catnum)
+			return;
+
+	slot[h&(slots-1)]=index+1;
+}
+
+int SGP4BatchIndex(const sgp4_batch_t *batch, long catnum)
+{
+	/* Batch index of the satellite with NORAD id catnum, or -1 */
+
+	return IndexFind(batch->slot, batch->slots, batch->sat, catnum);
+}
+
+const sat_struct *SGP4BatchSat(const sgp4_batch_t *batch, int i)
+{
+	/* Elements of satellite i, whole, while a reader holds */
+	/* SGP4ReadLock() or the updater holds rcu->lock        */
+
+	return __atomic_load_n(&batch->sat[i], __ATOMIC_ACQUIRE);
+}
+
+int SGP4BatchInit(sgp4_batch_t *batch, context_t *ctx, int count)
+{
+	/* Builds a batch from count contexts that PreCalc() has   */
+	/* already initialized.  Returns -1 if memory runs out,    */
+	/* in which case the batch is left empty.                  */
+
+	int i, j, lane, last, near_count=0, simple_count=0, full_lane, simple_lane;
+	context_t *c;
+
+	memset(batch, 0, sizeof(*batch));
+	batch->count=count;
+
+	for (i=0; i<count; i++)
+		if (isFlagClear(&ctx[i], DEEP_SPACE_EPHEM_FLAG))
+		{
+			near_count++;
+
+			if (isFlagSet(&ctx[i], SIMPLE_FLAG))
+				simple_count++;
+		}
+
+	/* Near-earth satellites are grouped by orbit class: those  */
+	/* with SIMPLE_FLAG clear take the first groups and those   */
+	/* with it set the rest, each class padded to whole groups. */
+
+	full_lane=0;
+	simple_lane=(near_count-simple_count+SGP4_LANES-1)/SGP4_LANES*SGP4_LANES;
+	batch->groups=simple_lane/SGP4_LANES+(simple_count+SGP4_LANES-1)/SGP4_LANES;
+	batch->deep_count=count-near_count;
+	batch->slots=IndexSlots(count);
+
+	batch->group=calloc(batch->groups+1, sizeof(sgp4_group_t *));
+	batch->near_index=malloc(sizeof(int)*(batch->groups*SGP4_LANES+1));
+	batch->deep_index=malloc(sizeof(int)*(batch->deep_count+1));
+	batch->deep=calloc(batch->deep_count+1, sizeof(context_t *));
+	batch->where=malloc(sizeof(int)*(count+1));
+	batch->slot=calloc(batch->slots, sizeof(int));
+	batch->sat=calloc(count+1, sizeof(sat_struct *));
+
+	if (batch->group==NULL || batch->near_index==NULL || batch->deep_index==NULL ||
+	    batch->deep==NULL || batch->where==NULL || batch->slot==NULL || batch->sat==NULL)
+	{
+		SGP4BatchFree(batch);
+		return -1;
+	}
+
+	for (i=0; i<batch->groups; i++)
+		if (posix_memalign((void **)&batch->group[i], sizeof(lane_t), sizeof(sgp4_group_t))!=0)
+		{
+			batch->group[i]=NULL;
+			SGP4BatchFree(batch);
+			return -1;
+		}
+
+	for (lane=0; lane<batch->groups*SGP4_LANES; lane++)
+		batch->near_index[lane]=-1;
+
+	for (i=0, j=0; i<count; i++)
+	{
+		c=&ctx[i];
+		batch->sat[i]=malloc(sizeof(sat_struct));
+
+		if (batch->sat[i]==NULL)
+		{
+			SGP4BatchFree(batch);
+			return -1;
+		}
+
+		*batch->sat[i]=c->sat;
+		IndexAdd(batch->slot, batch->slots, batch->sat, i);
+
+		if (isFlagSet(c, DEEP_SPACE_EPHEM_FLAG))
+		{
+			batch->deep[j]=malloc(sizeof(context_t));
+
+			if (batch->deep[j]==NULL)
+			{
+				SGP4BatchFree(batch);
+				return -1;
+			}
+
+			*batch->deep[j]=*c;
+			batch->deep[j]->sdp4.deep.kept=NULL;
+
+			if (KeepDeepCheckpoints(batch->deep[j])!=0)
+			{
+				SGP4BatchFree(batch);
+				return -1;
+			}
+
+			batch->deep_index[j]=i;
+			batch->where[i]=-1-j++;
+			continue;
+		}
+
+		lane=isFlagSet(c, SIMPLE_FLAG) ? simple_lane++ : full_lane++;
+		batch->where[i]=lane;
+		batch->near_index[lane]=i;
+	}
+
+	/* Fill every lane, repeating the last satellite of a class */
+	/* into the unused lanes of its final group so they compute */
+	/* something sensible.  Their results are never stored.     */
+
+	for (lane=0, last=-1; lane<batch->groups*SGP4_LANES; lane++)
+	{
+		if (batch->near_index[lane]>=0)
+			last=batch->near_index[lane];
+
+		SetLane(batch->group[lane/SGP4_LANES], lane%SGP4_LANES, &ctx[last]);
+	}
+
+	return 0;
+}
+
+static void BatchRelease(const sgp4_batch_t *batch, void *p)
+{
+	/* Frees p, unless it is part of a compiled catalog's mapping */
+
+	if (batch->map==NULL || (char *)p<(char *)batch->map || (char *)p>=(char *)batch->map+batch->map_size)
+		free(p);
+}
+
+static void DeepRelease(const sgp4_batch_t *batch, context_t *c)
+{
+	/* Frees deep-space context c, as BatchRelease(), and the */
+	/* checkpoints it keeps, which are never in the mapping.  */
+
+	if (c!=NULL)
+		FreeDeepCheckpoints(c->sdp4.deep.kept);
+
+	BatchRelease(batch, c);
+}
+
+void SGP4BatchFree(sgp4_batch_t *batch)
+{
+	int i;
+
+	for (i=0; batch->group!=NULL && i<batch->groups; i++)
+		BatchRelease(batch, batch->group[i]);
+
+	for (i=0; batch->deep!=NULL && i<batch->deep_count; i++)
+		DeepRelease(batch, batch->deep[i]);
+
+	for (i=0; batch->sat!=NULL && i<batch->count; i++)
+		BatchRelease(batch, batch->sat[i]);
+
+	free(batch->group);
+	free(batch->deep);
+	free(batch->sat);
+	BatchRelease(batch, batch->near_index);
+	BatchRelease(batch, batch->deep_index);
+	BatchRelease(batch, batch->where);
+	BatchRelease(batch, batch->slot);
+
+	if (batch->map!=NULL)
+		munmap(batch->map, batch->map_size);
+
+	memset(batch, 0, sizeof(*batch));
+}
+
+/* Batches are updated while they are being read, RCU style.  Each  */
+/* group, deep-space context and satellite's elements are reached   */
+/* through a pointer, and a satellite is updated by swapping in an  */
+/* updated copy of whichever hold it, so readers see either all of  */
+/* its old elements or all of its new ones.  The copies swapped out */
+/* are freed once every reader that might still be using them is    */
+/* done.                                                            */
+
+static inline const sgp4_group_t *BatchGroup(const sgp4_batch_t *batch, int i)
+{
+	return __atomic_load_n(&batch->group[i], __ATOMIC_ACQUIRE);
+}
+
+static inline const context_t *BatchDeep(const sgp4_batch_t *batch, int j)
+{
+	return __atomic_load_n(&batch->deep[j], __ATOMIC_ACQUIRE);
+}
+
+void SGP4RcuInit(sgp4_rcu_t *rcu)
+{
+	rcu->epoch=0;
+	rcu->readers[0]=0;
+	rcu->readers[1]=0;
+	pthread_mutex_init(&rcu->lock, NULL);
+}
+
+int SGP4ReadLock(sgp4_rcu_t *rcu)
+{
+	/* Starts reading, which never waits.  Returns what to hand */
+	/* SGP4ReadUnlock() when done.                              */
+
+	int index=__atomic_load_n(&rcu->epoch, __ATOMIC_SEQ_CST)&1;
+
+	__sync_fetch_and_add(&rcu->readers[index], 1);
+	return index;
+}
+
+void SGP4ReadUnlock(sgp4_rcu_t *rcu, int index)
+{
+	__sync_fetch_and_sub(&rcu->readers[index], 1);
+}
+
+void SGP4Synchronize(sgp4_rcu_t *rcu)
+{
+	/* Waits until no reader can still see what was swapped out */
+	/* before the call: first for any counted against the other */
+	/* epoch, having read it before the last flip, then, after  */
+	/* flipping, for those counted against this one.            */
+
+	int epoch=__atomic_load_n(&rcu->epoch, __ATOMIC_SEQ_CST);
+
+	while (__atomic_load_n(&rcu->readers[(epoch+1)&1], __ATOMIC_SEQ_CST)!=0)
+		sched_yield();
+
+	__atomic_store_n(&rcu->epoch, epoch+1, __ATOMIC_SEQ_CST);
+
+	while (__atomic_load_n(&rcu->readers[epoch&1], __ATOMIC_SEQ_CST)!=0)
+		sched_yield();
+}
+
+void SGP4BatchReplace(sgp4_batch_t **batch, sgp4_rcu_t *rcu, sgp4_batch_t *replacement)
+{
+	/* Swaps in a whole new batch, and frees the old one once */
+	/* nobody is reading it.  The caller holds rcu->lock.     */
+
+	sgp4_batch_t *old=*batch;
+
+	__atomic_store_n(batch, replacement, __ATOMIC_SEQ_CST);
+	SGP4Synchronize(rcu);
+
+	if (old!=NULL)
+	{
+		SGP4BatchFree(old);
+		free(old);
+	}
+}
+
+static int BatchRebuild(sgp4_batch_t **batch, sgp4_rcu_t *rcu, context_t *ctx, int count)
+{
+	/* SGP4BatchUpdate() when satellites are added or change  */
+	/* orbit class: the whole batch is built again, in its old */
+	/* order, with new ones at the end.                        */
+
+	sgp4_batch_t *old=*batch, *replacement;
+	context_t *all;
+	sat_struct **sat;
+	char *fresh;
+	int *slot, slots, i, k, n=old->count, result=-1;
+
+	slots=IndexSlots(old->count+count);
+	slot=calloc(slots, sizeof(int));
+	sat=malloc(sizeof(sat_struct *)*(old->count+count+1));
+	all=calloc(old->count+count+1, sizeof(context_t));
+	fresh=calloc(old->count+count+1, 1);
+	replacement=malloc(sizeof(sgp4_batch_t));
+
+	if (slot==NULL || sat==NULL || all==NULL || fresh==NULL || replacement==NULL)
+		goto cleanup;
+
+	for (i=0; i<n; i++)
+	{
+		sat[i]=old->sat[i];
+		IndexAdd(slot, slots, sat, i);
+	}
+
+	for (k=0; k<count; k++)
+	{
+		i=IndexFind(slot, slots, sat, ctx[k].sat.catnum);
+
+		if (i<0)
+		{
+			i=n++;
+			sat[i]=&ctx[k].sat;
+			IndexAdd(slot, slots, sat, i);
+		}
+
+		all[i]=ctx[k];
+		fresh[i]=1;
+	}
+
+	for (i=0; i<n; i++)
+		if (!fresh[i])
+		{
+			all[i].sat=*sat[i];
+			PreCalc(&all[i]);
+		}
+
+	if (SGP4BatchInit(replacement, all, n)==0)
+	{
+		SGP4BatchReplace(batch, rcu, replacement);
+		replacement=NULL;
+		result=0;
+	}
+
+cleanup:
+	free(replacement);
+	free(slot);
+	free(sat);
+	free(all);
+	free(fresh);
+	return result;
+}
+
+int SGP4BatchUpdate(sgp4_batch_t **batch, sgp4_rcu_t *rcu, context_t *ctx, int count)
+{
+	/* Replaces the satellites of *batch that have the NORAD ids */
+	/* of the count contexts, which PreCalc() has initialized,   */
+	/* and adds those it doesn't have, while it is being read.   */
+	/* Satellites are replaced one by one unless any are added   */
+	/* or change orbit class (near-earth, simple or deep-space), */
+	/* which rebuilds the whole batch.  The caller holds         */
+	/* rcu->lock.  Returns -1 if memory runs out, in which case  */
+	/* nothing is changed.                                       */
+
+	sgp4_batch_t *b=*batch;
+	sgp4_group_t **group;
+	context_t **deep;
+	sat_struct **sat;
+	int i, k, where, result=0;
+
+	for (k=0; k<count; k++)
+	{
+		i=SGP4BatchIndex(b, ctx[k].sat.catnum);
+
+		if (i<0 || (b->where[i]<0)!=(isFlagSet(&ctx[k], DEEP_SPACE_EPHEM_FLAG)!=0) ||
+		    (b->where[i]>=0 && b->group[b->where[i]/SGP4_LANES]->simple!=(isFlagSet(&ctx[k], SIMPLE_FLAG)!=0)))
+			return BatchRebuild(batch, rcu, ctx, count);
+	}
+
+	/* Make every updated copy before swapping any in, so that */
+	/* no copy is changed once readers can see it.             */
+
+	group=calloc(b->groups+1, sizeof(sgp4_group_t *));
+	deep=calloc(b->deep_count+1, sizeof(context_t *));
+	sat=calloc(b->count+1, sizeof(sat_struct *));
+
+	if (group==NULL || deep==NULL || sat==NULL)
+	{
+		result=-1;
+		goto cleanup;
+	}
+
+	for (k=0; k<count; k++)
+	{
+		i=SGP4BatchIndex(b, ctx[k].sat.catnum);
+
+		if (sat[i]==NULL && (sat[i]=malloc(sizeof(sat_struct)))==NULL)
+		{
+			result=-1;
+			goto cleanup;
+		}
+
+		*sat[i]=ctx[k].sat;
+		where=b->where[i];
+
+		if (where>=0)
+		{
+			if (group[where/SGP4_LANES]==NULL)
+			{
+				if (posix_memalign((void **)&group[where/SGP4_LANES], sizeof(lane_t), sizeof(sgp4_group_t))!=0)
+				{
+					group[where/SGP4_LANES]=NULL;
+					result=-1;
+					goto cleanup;
+				}
+
+				*group[where/SGP4_LANES]=*b->group[where/SGP4_LANES];
+			}
+
+			SetLane(group[where/SGP4_LANES], where%SGP4_LANES, &ctx[k]);
+		}
+		else
+		{
+			if (deep[-1-where]!=NULL)
+				FreeDeepCheckpoints(deep[-1-where]->sdp4.deep.kept);
+
+			else if ((deep[-1-where]=malloc(sizeof(context_t)))==NULL)
+			{
+				result=-1;
+				goto cleanup;
+			}
+
+			*deep[-1-where]=ctx[k];
+			deep[-1-where]->sdp4.deep.kept=NULL;
+
+			if (KeepDeepCheckpoints(deep[-1-where])!=0)
+			{
+				result=-1;
+				goto cleanup;
+			}
+		}
+	}
+
+	/* Swap them in, keeping what they replace to free later */
+
+	for (i=0; i<b->groups; i++)
+		if (group[i]!=NULL)
+			group[i]=__atomic_exchange_n(&b->group[i], group[i], __ATOMIC_SEQ_CST);
+
+	for (i=0; i<b->deep_count; i++)
+		if (deep[i]!=NULL)
+			deep[i]=__atomic_exchange_n(&b->deep[i], deep[i], __ATOMIC_SEQ_CST);
+
+	for (i=0; i<b->count; i++)
+		if (sat[i]!=NULL)
+			sat[i]=__atomic_exchange_n(&b->sat[i], sat[i], __ATOMIC_SEQ_CST);
+
+	SGP4Synchronize(rcu);
+
+cleanup:
+	for (i=0; group!=NULL && i<b->groups; i++)
+		BatchRelease(b, group[i]);
+
+	for (i=0; deep!=NULL && i<b->deep_count; i++)
+		DeepRelease(b, deep[i]);
+
+	for (i=0; sat!=NULL && i<b->count; i++)
+		BatchRelease(b, sat[i]);
+
+	free(group);
+	free(deep);
+	free(sat);
+	return result;
+}
+
+static inline int BatchIndex(const sgp4_batch_t *batch, int item, int lane)
+{
+	/* Batch index of the satellite in lane of a work item, where */
+	/* items are the groups followed by the deep-space satellites */
+	/* (one per item, in lane 0).  -1 if there isn't one.         */
+
+	if (item<batch->groups)
+		return batch->near_index[item*SGP4_LANES+lane];
+
+	return lane==0 ? batch->deep_index[item-batch->groups] : -1;
+}
+
+static void GroupState(const sgp4_group_t *g, double jul_utc, vector_t pos[SGP4_LANES], vector_t vel[SGP4_LANES], int exact)
+{
+	/* Propagates group g to jul_utc and returns the ECI position */
+	/* (km) and velocity (km/s) of each lane.                     */
+
+	int j;
+	lane_t tsince, lpos[3], lvel[3];
+
+	tsince=(jul_utc-g->jul_epoch)*xmnpda;
+	SGP4Group(g, &tsince, lpos, lvel, exact);
+
+	for (j=0; j<SGP4_LANES; j++)
+	{
+		/* Scale to km and km/sec, as Convert_Sat_State() does */
+		pos[j].x=lpos[0][j]*xkmper;
+		pos[j].y=lpos[1][j]*xkmper;
+		pos[j].z=lpos[2][j]*xkmper;
+		vel[j].x=lvel[0][j]*(xkmper*xmnpda/secday);
+		vel[j].y=lvel[1][j]*(xkmper*xmnpda/secday);
+		vel[j].z=lvel[2][j]*(xkmper*xmnpda/secday);
+	}
+}
+
+static void DeepState(context_t *ctx, double jul_utc, vector_t *pos, vector_t *vel)
+{
+	/* The same for a deep-space satellite, given a copy of its */
+	/* context that it's alright to propagate.                  */
+
+	ResetDeep(ctx);
+	SDP4(ctx, (jul_utc-Julian_Date_of_Epoch(ctx->tle.epoch))*xmnpda, pos, vel);
+	Convert_Sat_State(pos, vel);
+}
+
+void SGP4Batch(const sgp4_batch_t *batch, double daynum, double *x, double *y, double *z, double *x_vel, double *y_vel, double *z_vel, int exact)
+{
+	/* Propagates every satellite in the batch to daynum.  The */
+	/* i'th element of x, y, z and x_vel, y_vel, z_vel receive */
+	/* the ECI position (km) and velocity (km/s) of the i'th   */
+	/* satellite the batch was built from, as Calc() leaves    */
+	/* them in sat_struct if exact, or else as SGP4Group()     */
+	/* leaves them when not exact (see above).                 */
+
+	int i, j, index;
+	double jul_utc;
+	vector_t pos[SGP4_LANES], vel[SGP4_LANES];
+	context_t ctx;
+
+	jul_utc=daynum+2444238.5;
+
+	for (i=0; i<batch->groups+batch->deep_count; i++)
+	{
+		if (i<batch->groups)
+			GroupState(BatchGroup(batch, i), jul_utc, pos, vel, exact);
+		else
+		{
+			ctx=*BatchDeep(batch, i-batch->groups);
+			DeepState(&ctx, jul_utc, &pos[0], &vel[0]);
+		}
+
+		for (j=0; j<SGP4_LANES; j++)
+		{
+			index=BatchIndex(batch, i, j);
+
+			if (index<0)
+				break;
+
+			x[index]=pos[j].x;
+			y[index]=pos[j].y;
+			z[index]=pos[j].z;
+			x_vel[index]=vel[j].x;
+			y_vel[index]=vel[j].y;
+			z_vel[index]=vel[j].z;
+		}
+	}
+}
+
+/* Single precision propagation, for uses such as drawing the whole
+   catalog on a map, where a few hundred metres don't matter.  Two
+   groups of the same orbit class are propagated at once, in vectors of
+   floats with twice as many lanes as the doubles in the same width.
+   The time since epoch and the secular angles that grow with it are
+   worked out in double precision and reduced to one revolution before
+   they are rounded, so the error doesn't grow with the time from
+   epoch; everything after that is single precision, sines, cosines
+   and arctangents included, which lanemath.h works out in floats.
+   Deep-space satellites are still propagated in double precision by
+   SDP4(), and only their results are rounded.  test_float32.py holds
+   the error to its documented bound. */
+
+LANE_INLINE lane32_t lane32_join(lane_t a, lane_t b)
+{
+	/* The lanes of a followed by those of b, rounded */
+
+	lane32_t r;
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+	{
+		r[i]=a[i];
+		r[i+SGP4_LANES]=b[i];
+	}
+
+	return r;
+}
+
+LANE_INLINE lane32_t lane32_sin(lane32_t x)
+{
+	lane32_t sinx, cosx;
+
+	lane32_sincos(x, &sinx, &cosx);
+	return sinx;
+}
+
+LANE_INLINE lane32_t lane32_cos(lane32_t x)
+{
+	lane32_t sinx, cosx;
+
+	lane32_sincos(x, &sinx, &cosx);
+	return cosx;
+}
+
+LANE_INLINE void lane32_sincos_masked(lane32_mask_t mask, lane32_t x, lane32_t *sinx, lane32_t *cosx)
+{
+	lane32_t sinv, cosv;
+
+	lane32_sincos(x, &sinv, &cosv);
+	*sinx=lane32_select(mask, sinv, *sinx);
+	*cosx=lane32_select(mask, cosv, *cosx);
+}
+
+LANE_INLINE lane32_t lane32_actan(lane32_t sinx, lane32_t cosx)
+{
+	/* AcTan(), from 0 to 2 pi */
+
+	lane32_t r=lane32_atan2(sinx, cosx);
+
+	return lane32_select(r<0.0f, r+(float)twopi, r);
+}
+
+/* A constant of groups g0 and g1 in single precision */
+#define JOIN(name)  lane32_join(g0->name, g1->name)
+
+LANE_INLINE void GroupKernel32(const sgp4_group_t *g0, const sgp4_group_t *g1, double jul_utc, lane32_t pos[3], lane32_t vel[3], const int simple)
+{
+	/* Propagates groups g0 and g1, whose lanes all have SIMPLE_FLAG */
+	/* set if simple is and clear if not, to jul_utc in single       */
+	/* precision, as SGP4Group() does in double.  pos and vel        */
+	/* receive the ECI position (km) and velocity (km/s) of the      */
+	/* lanes of g0 followed by those of g1.                          */
+
+	lane_t t0, t1;
+	lane32_t cosuk, sinuk, rfdotk, vx, vy, vz, ux, uy, uz, xmy, xmx, cosnok,
+	sinnok, cosik, sinik, rdotk, xinck, xnodek, uk, rk, cos2u, sin2u,
+	u, sinu, cosu, betal, rfdot, rdot, r, pl, elsq, esine, ecose, epw,
+	cosepw, tfour, sinepw, capu, ayn, xlt, aynl, xll, axn, xn, beta,
+	xl, e, a, tcube, delm, delomg, templ, tempe, tempa, xnode, tsq, xmp,
+	omega, xnoddf, omgadf, xmdf, temp, temp1, temp2, temp3, temp4,
+	temp5, temp6, delta, sinomg, cosomg, tsince;
+
+	lane32_mask_t active, converged;
+
+	int i;
+
+	/* Update for secular gravity and atmospheric drag, with the */
+	/* angles taken to a revolution in double precision first.   */
+	t0=(jul_utc-g0->jul_epoch)*xmnpda;
+	t1=(jul_utc-g1->jul_epoch)*xmnpda;
+	tsince=lane32_join(t0,t1);
+	xmdf=lane32_join(lane_fmod2p(g0->xmo+g0->xmdot*t0),lane_fmod2p(g1->xmo+g1->xmdot*t1));
+	omgadf=lane32_join(lane_fmod2p(g0->omegao+g0->omgdot*t0),lane_fmod2p(g1->omegao+g1->omgdot*t1));
+	xnoddf=lane32_join(lane_fmod2p(g0->xnodeo+g0->xnodot*t0),lane_fmod2p(g1->xnodeo+g1->xnodot*t1));
+	omega=omgadf;
+	xmp=xmdf;
+	tsq=tsince*tsince;
+	xnode=xnoddf+JOIN(xnodcf)*tsq;
+	tempa=1-JOIN(c1)*tsince;
+	tempe=JOIN(bstar)*JOIN(c4)*tsince;
+	templ=JOIN(t2cof)*tsq;
+
+	if (!simple)
+	{
+		delomg=JOIN(omgcof)*tsince;
+		temp=1+JOIN(eta)*lane32_cos(xmdf);
+		delm=JOIN(xmcof)*(temp*temp*temp-JOIN(delmo));
+		temp=delomg+delm;
+		xmp=xmdf+temp;
+		omega=omgadf-temp;
+		tcube=tsq*tsince;
+		tfour=tsince*tcube;
+		tempa=tempa-JOIN(d2)*tsq-JOIN(d3)*tcube-JOIN(d4)*tfour;
+		tempe=tempe+JOIN(bstar)*JOIN(c5)*(lane32_sin(xmp)-JOIN(sinmo));
+		templ=templ+JOIN(t3cof)*tcube+tfour*(JOIN(t4cof)+tsince*JOIN(t5cof));
+	}
+
+	a=JOIN(aodp)*(tempa*tempa);
+	e=JOIN(eo)-tempe;
+	xl=xmp+omega+xnode+JOIN(xnodp)*templ;
+	beta=lane32_sqrt(1-e*e);
+	xn=(float)xke/(a*lane32_sqrt(a));
+
+	/* Long period periodics */
+	lane32_sincos(omega,&sinomg,&cosomg);
+	axn=e*cosomg;
+	temp=1/(a*beta*beta);
+	xll=temp*JOIN(xlcof)*axn;
+	aynl=temp*JOIN(aycof);
+	xlt=xl+xll;
+	ayn=e*sinomg+aynl;
+
+	/* Solve Kepler's Equation, lane by lane as SGP4Group() does */
+	capu=lane32_fmod2p(xlt-xnode);
+	temp2=capu;
+	temp3=temp4=temp5=temp6=sinepw=cosepw=capu;
+	active=~(lane32_mask_t){0};
+
+	for (i=0; i<=10 && lane32_any(active); i++)
+	{
+		lane32_sincos_masked(active,temp2,&sinepw,&cosepw);
+		temp3=lane32_select(active,axn*sinepw,temp3);
+		temp4=lane32_select(active,ayn*cosepw,temp4);
+		temp5=lane32_select(active,axn*cosepw,temp5);
+		temp6=lane32_select(active,ayn*sinepw,temp6);
+		epw=(capu-temp4+temp3-temp2)/(1-temp5-temp6)+temp2;
+
+		delta=epw-temp2;
+		converged=(delta<=(float)e6a)&(delta>=-(float)e6a);
+		active&=~converged;
+		temp2=lane32_select(active,epw,temp2);
+	}
+
+	/* Short period preliminary quantities */
+	ecose=temp5+temp6;
+	esine=temp3-temp4;
+	elsq=axn*axn+ayn*ayn;
+	temp=1-elsq;
+	pl=a*temp;
+	r=a*(1-ecose);
+	temp1=1/r;
+	rdot=(float)xke*lane32_sqrt(a)*esine*temp1;
+	rfdot=(float)xke*lane32_sqrt(pl)*temp1;
+	temp2=a*temp1;
+	betal=lane32_sqrt(temp);
+	temp3=1/(1+betal);
+	cosu=temp2*(cosepw-axn+ayn*esine*temp3);
+	sinu=temp2*(sinepw-ayn-axn*esine*temp3);
+	u=lane32_actan(sinu,cosu);
+	sin2u=2*sinu*cosu;
+	cos2u=2*cosu*cosu-1;
+	temp=1/pl;
+	temp1=(float)ck2*temp;
+	temp2=temp1*temp;
+
+	/* Update for short periodics */
+	rk=r*(1-1.5f*temp2*betal*JOIN(x3thm1))+0.5f*temp1*JOIN(x1mth2)*cos2u;
+	uk=u-0.25f*temp2*JOIN(x7thm1)*sin2u;
+	xnodek=xnode+1.5f*temp2*JOIN(cosio)*sin2u;
+	xinck=JOIN(xincl)+1.5f*temp2*JOIN(cosio)*JOIN(sinio)*cos2u;
+	rdotk=rdot-xn*temp1*JOIN(x1mth2)*sin2u;
+	rfdotk=rfdot+xn*temp1*(JOIN(x1mth2)*cos2u+1.5f*JOIN(x3thm1));
+
+	/* Orientation vectors */
+	lane32_sincos(uk,&sinuk,&cosuk);
+	lane32_sincos(xinck,&sinik,&cosik);
+	lane32_sincos(xnodek,&sinnok,&cosnok);
+	xmx=-sinnok*cosik;
+	xmy=cosnok*cosik;
+	ux=xmx*sinuk+cosnok*cosuk;
+	uy=xmy*sinuk+sinnok*cosuk;
+	uz=sinik*sinuk;
+	vx=xmx*cosuk-cosnok*sinuk;
+	vy=xmy*cosuk-sinnok*sinuk;
+	vz=sinik*cosuk;
+
+	/* Position and velocity, in km and km/sec */
+	rk=rk*(float)xkmper;
+	rdotk=rdotk*(float)(xkmper*xmnpda/secday);
+	rfdotk=rfdotk*(float)(xkmper*xmnpda/secday);
+	pos[0]=rk*ux;
+	pos[1]=rk*uy;
+	pos[2]=rk*uz;
+	vel[0]=rdotk*ux+rfdotk*vx;
+	vel[1]=rdotk*uy+rfdotk*vy;
+	vel[2]=rdotk*uz+rfdotk*vz;
+}
+
+#undef JOIN
+
+LANE_INLINE void LatLonAlt32(double jul_utc, const lane32_t pos[3], lane32_t *lat, lane32_t *lon, lane32_t *alt)
+{
+	/* Calculate_LatLonAlt() in single precision, giving degrees */
+	/* north and east and km.  Three rounds of its iteration for */
+	/* latitude leave less than a float's rounding to go.  The   */
+	/* altitude is taken along the normal, r cos(lat)+z sin(lat) */
+	/* less the radius of curvature term, which unlike r/cos(lat) */
+	/* keeps its precision near the poles.                        */
+
+	lane32_t r, c, phi, sinphi, cosphi;
+	float e2=(float)(f*(2-f));
+	int i;
+
+	*lon=lane32_fmod2p(lane32_actan(pos[1],pos[0])-(float)ThetaG_JD(jul_utc));
+	r=lane32_sqrt(pos[0]*pos[0]+pos[1]*pos[1]);
+	*lat=lane32_actan(pos[2],r);
+	*lat=lane32_select(*lat>(float)pi,*lat-(float)twopi,*lat);
+	c=r;
+
+	for (i=0; i<3; i++)
+	{
+		phi=*lat;
+		sinphi=lane32_sin(phi);
+		c=1/lane32_sqrt(1-e2*sinphi*sinphi);
+		*lat=lane32_actan(pos[2]+(float)xkmper*c*e2*sinphi,r);
+		*lat=lane32_select(*lat>(float)pi,*lat-(float)twopi,*lat);
+	}
+
+	lane32_sincos(*lat,&sinphi,&cosphi);
+	*alt=r*cosphi+pos[2]*sinphi-(float)xkmper*lane32_sqrt(1-e2*sinphi*sinphi);
+	*lat=*lat*(float)(180.0/pi);
+	*lon=*lon*(float)(180.0/pi);
+}
+
+/* The kernels built for each instruction set, and the one in use.
+   KERNELS() builds every kernel with the given attributes: nothing
+   for the baseline, or the target() to build them for.              */
+
+typedef struct  {
+           const char  *name;
+           void  (*group[2][2])(const sgp4_group_t *, const lane_t *, lane_t [3], lane_t [3]);   /* [exact][simple] */
+           void  (*group32[2])(const sgp4_group_t *, const sgp4_group_t *, double, lane32_t [3], lane32_t [3]);
+           void  (*latlonalt32)(double, const lane32_t [3], lane32_t *, lane32_t *, lane32_t *);
+        }  batch_kernels_t;
+
+#define KERNELS(isa, attributes) \
+	static attributes void GroupFull_##isa(const sgp4_group_t *g, const lane_t *times, lane_t pos[3], lane_t vel[3]) \
+	{ \
+		GroupKernel(g, times, pos, vel, 0, 1); \
+	} \
+	static attributes void GroupSimple_##isa(const sgp4_group_t *g, const lane_t *times, lane_t pos[3], lane_t vel[3]) \
+	{ \
+		GroupKernel(g, times, pos, vel, 1, 1); \
+	} \
+	static attributes void GroupFullVector_##isa(const sgp4_group_t *g, const lane_t *times, lane_t pos[3], lane_t vel[3]) \
+	{ \
+		GroupKernel(g, times, pos, vel, 0, 0); \
+	} \
+	static attributes void GroupSimpleVector_##isa(const sgp4_group_t *g, const lane_t *times, lane_t pos[3], lane_t vel[3]) \
+	{ \
+		GroupKernel(g, times, pos, vel, 1, 0); \
+	} \
+	static attributes void GroupFull32_##isa(const sgp4_group_t *g0, const sgp4_group_t *g1, double jul_utc, lane32_t pos[3], lane32_t vel[3]) \
+	{ \
+		GroupKernel32(g0, g1, jul_utc, pos, vel, 0); \
+	} \
+	static attributes void GroupSimple32_##isa(const sgp4_group_t *g0, const sgp4_group_t *g1, double jul_utc, lane32_t pos[3], lane32_t vel[3]) \
+	{ \
+		GroupKernel32(g0, g1, jul_utc, pos, vel, 1); \
+	} \
+	static attributes void LatLonAlt32_##isa(double jul_utc, const lane32_t pos[3], lane32_t *lat, lane32_t *lon, lane32_t *alt) \
+	{ \
+		LatLonAlt32(jul_utc, pos, lat, lon, alt); \
+	} \
+	static const batch_kernels_t kernels_##isa={#isa, \
+		{{GroupFullVector_##isa, GroupSimpleVector_##isa}, {GroupFull_##isa, GroupSimple_##isa}}, \
+		{GroupFull32_##isa, GroupSimple32_##isa}, \
+		LatLonAlt32_##isa};
+
+#if defined(__x86_64__)
+
+KERNELS(sse2, )
+KERNELS(avx2, __attribute__ ((target ("avx2"))))
+KERNELS(avx512, __attribute__ ((target ("avx2,avx512f,avx512vl"))))
+
+/* Best first, ending with the baseline */
+static const batch_kernels_t *const kernel_list[]={&kernels_avx512, &kernels_avx2, &kernels_sse2};
+
+#elif defined(__aarch64__)
+
+/* Advanced SIMD is part of the baseline of every AArch64 processor */
+KERNELS(neon, )
+
+static const batch_kernels_t *const kernel_list[]={&kernels_neon};
+
+#else
+
+KERNELS(generic, )
+
+static const batch_kernels_t *const kernel_list[]={&kernels_generic};
+
+#endif
+
+#define KERNEL_COUNT  (int)(sizeof(kernel_list)/sizeof(kernel_list[0]))
+
+static const batch_kernels_t *kernels=kernel_list[KERNEL_COUNT-1];
+
+static int KernelsSupported(const batch_kernels_t *k)
+{
+	/* Whether this processor (and its operating system, which */
+	/* has to save the wider registers) can run kernels k.     */
+
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+
+	if (k==&kernels_avx512)
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+
+	if (k==&kernels_avx2)
+		return __builtin_cpu_supports("avx2");
+#endif
+
+	return 1;
+}
+
+int SGP4BatchSelectKernels(const char *name)
+{
+	/* Switches the batch kernels to those built for the named */
+	/* instruction set, or to the best this processor supports */
+	/* if name is NULL or empty.  Returns 0, or -1 leaving the */
+	/* kernels as they were if name is unknown or unsupported. */
+	/* Not to be called while other threads are propagating.   */
+
+	int i;
+
+	for (i=0; i<KERNEL_COUNT; i++)
+		if ((name==NULL || *name==0 || strcmp(name, kernel_list[i]->name)==0) && KernelsSupported(kernel_list[i]))
+		{
+			kernels=kernel_list[i];
+			return 0;
+		}
+
+	return -1;
+}
+
+const char *SGP4BatchKernels(void)
+{
+	/* Name of the instruction set the batch kernels in use */
+	/* were built for: "avx512", "avx2" or "sse2" on x86-64, */
+	/* "neon" on AArch64 and "generic" elsewhere.            */
+
+	return kernels->name;
+}
+
+void SGP4Group(const sgp4_group_t *g, const lane_t *times, lane_t pos[3], lane_t vel[3], int exact)
+{
+	/* Propagates the SGP4_LANES satellites of group g to times */
+	/* minutes past their epochs.  pos and vel receive the ECI  */
+	/* position and velocity of each lane, in the same units as  */
+	/* SGP4() returns them: exactly if exact, or else within a   */
+	/* few units in the last place through lanemath.h.           */
+
+	kernels->group[exact!=0][g->simple](g, times, pos, vel);
+}
+
+static void Batch32(const sgp4_batch_t *batch, double daynum, float *x, float *y, float *z, float *x_vel, float *y_vel, float *z_vel, float *lat, float *lon, float *alt)
+{
+	/* SGP4Batch32() and SGP4BatchGeodetic32(), for whichever */
+	/* outputs aren't NULL.                                   */
+
+	int i, j, k, pair, index;
+	double jul_utc;
+	const sgp4_group_t *g0, *g1;
+	lane32_t pos[3], vel[3], glat, glon, galt;
+	vector_t dpos, dvel;
+	geodetic_t geodetic;
+	context_t ctx;
+
+	jul_utc=daynum+2444238.5;
+
+	for (i=0; i<batch->groups; i+=pair)
+	{
+		/* Pair each group with the next when it's of the same */
+		/* class, or else with itself, ignoring the copy.      */
+
+		g0=BatchGroup(batch, i);
+		g1=i+1<batch->groups ? BatchGroup(batch, i+1) : g0;
+		pair=g1->simple==g0->simple && g1!=g0 ? 2 : 1;
+
+		if (pair==1)
+			g1=g0;
+
+		kernels->group32[g0->simple](g0, g1, jul_utc, pos, vel);
+
+		if (lat!=NULL)
+			kernels->latlonalt32(jul_utc, pos, &glat, &glon, &galt);
+
+		for (j=0; j<pair*SGP4_LANES; j++)
+		{
+			index=batch->near_index[i*SGP4_LANES+j];
+
+			if (index<0)
+				continue;
+
+			if (x!=NULL)
+			{
+				x[index]=pos[0][j];
+				y[index]=pos[1][j];
+				z[index]=pos[2][j];
+				x_vel[index]=vel[0][j];
+				y_vel[index]=vel[1][j];
+				z_vel[index]=vel[2][j];
+			}
+
+			if (lat!=NULL)
+			{
+				lat[index]=glat[j];
+				lon[index]=glon[j];
+				alt[index]=galt[j];
+			}
+		}
+	}
+
+	for (k=0; k<batch->deep_count; k++)
+	{
+		ctx=*BatchDeep(batch, k);
+		DeepState(&ctx, jul_utc, &dpos, &dvel);
+		index=batch->deep_index[k];
+
+		if (x!=NULL)
+		{
+			x[index]=dpos.x;
+			y[index]=dpos.y;
+			z[index]=dpos.z;
+			x_vel[index]=dvel.x;
+			y_vel[index]=dvel.y;
+			z_vel[index]=dvel.z;
+		}
+
+		if (lat!=NULL)
+		{
+			Calculate_LatLonAlt(jul_utc, &dpos, &geodetic);
+			lat[index]=Degrees(geodetic.lat);
+			lon[index]=Degrees(geodetic.lon);
+			alt[index]=geodetic.alt;
+		}
+	}
+}
+
+void SGP4Batch32(const sgp4_batch_t *batch, double daynum, float *x, float *y, float *z, float *x_vel, float *y_vel, float *z_vel)
+{
+	/* SGP4Batch() in single precision, see above */
+
+	Batch32(batch, daynum, x, y, z, x_vel, y_vel, z_vel, NULL, NULL, NULL);
+}
+
+void SGP4BatchGeodetic32(const sgp4_batch_t *batch, double daynum, float *lat, float *lon, float *alt)
+{
+	/* Propagates every satellite in the batch to daynum in */
+	/* single precision, see above, and gives the latitude  */
+	/* (degrees north), longitude (degrees east) and        */
+	/* altitude (km) of each as Calc() works them out.      */
+
+	Batch32(batch, daynum, NULL, NULL, NULL, NULL, NULL, NULL, lat, lon, alt);
+}
+
+void SGP4BatchGeodetic(const sgp4_batch_t *batch, double daynum, double *lat, double *lon, double *alt)
+{
+	/* SGP4BatchGeodetic32() in double precision, each as */
+	/* Calc() gives it exactly.                           */
+
+	int i, j, index;
+	double jul_utc;
+	vector_t pos[SGP4_LANES], vel[SGP4_LANES];
+	geodetic_t geodetic;
+	context_t ctx;
+
+	jul_utc=daynum+2444238.5;
+
+	for (i=0; i<batch->groups+batch->deep_count; i++)
+	{
+		if (i<batch->groups)
+			GroupState(BatchGroup(batch, i), jul_utc, pos, vel, 1);
+		else
+		{
+			ctx=*BatchDeep(batch, i-batch->groups);
+			DeepState(&ctx, jul_utc, &pos[0], &vel[0]);
+		}
+
+		for (j=0; j<SGP4_LANES; j++)
+		{
+			index=BatchIndex(batch, i, j);
+
+			if (index<0)
+				break;
+
+			Calculate_LatLonAlt(jul_utc, &pos[j], &geodetic);
+			lat[index]=Degrees(geodetic.lat);
+			lon[index]=Degrees(geodetic.lon);
+			alt[index]=geodetic.alt;
+		}
+	}
+}
+
+/* Work shared by the threads of SGP4BatchVisibility().  Work units */
+/* are the batch's groups followed by its deep-space satellites, and */
+/* each thread claims the next VISIBILITY_CHUNK of them at a time    */
+/* until there are none left.                                        */
+
+#define VISIBILITY_CHUNK  16
+
+typedef struct  {
+           const sgp4_batch_t  *batch;
+           const station_t  *station;
+           int  stations, steps, next;
+           double  start, step, min_elevation;
+           double  sin_low, sin_high;   /* Sine of elevation is in doubt between these */
+           unsigned char  *bits;
+        }  visibility_t;
+
+typedef struct  {
+           visibility_t  *v;
+           station_eci_t  *eci;     /* Where each station is at the current step */
+           context_t  ctx[VISIBILITY_CHUNK];
+        }  visibility_worker_t;
+
+static void *VisibilityWorker(void *arg)
+{
+	visibility_worker_t *w=arg;
+	visibility_t *v=w->v;
+	const sgp4_batch_t *batch=v->batch;
+	int i, first, last, units, j, k, n, index, row_bytes;
+	double daynum, jul_utc, thetag, sin_el;
+	vector_t pos[SGP4_LANES], vel[SGP4_LANES];
+	unsigned char *row;
+
+	row_bytes=(v->steps+7)/8;
+	units=batch->groups+batch->deep_count;
+
+	while ((first=__sync_fetch_and_add(&v->next, VISIBILITY_CHUNK)) < units)
+	{
+		last=first+VISIBILITY_CHUNK<units ? first+VISIBILITY_CHUNK : units;
+
+		for (i=first; i<last; i++)
+			if (i>=batch->groups)
+				w->ctx[i-first]=*BatchDeep(batch, i-batch->groups);
+
+		for (k=0; k<v->steps; k++)
+		{
+			/* The same daynum and jul_utc that observing at this */
+			/* time would use, so the answers agree exactly.      */
+			daynum=((v->start+k*v->step)/86400.0)-3651.0;
+			jul_utc=daynum+2444238.5;
+			thetag=ThetaG_JD(jul_utc);
+
+			/* Stations move once per step, for the whole chunk */
+			for (n=0; n<v->stations; n++)
+				Calculate_Station_ECI(thetag, &v->station[n], &w->eci[n]);
+
+			for (i=first; i<last; i++)
+			{
+				if (i<batch->groups)
+					GroupState(BatchGroup(batch, i), jul_utc, pos, vel, 1);
+				else
+					DeepState(&w->ctx[i-first], jul_utc, &pos[0], &vel[0]);
+
+				for (j=0; j<SGP4_LANES; j++)
+				{
+					index=BatchIndex(batch, i, j);
+
+					if (index<0)
+						break;
+
+					row=v->bits+(size_t)index*v->stations*row_bytes;
+
+					for (n=0; n<v->stations; n++, row+=row_bytes)
+					{
+						/* Only work out the elevation itself when */
+						/* the sine is too close to call.          */
+						sin_el=Calculate_Station_Sin_Elevation(&pos[j], &v->station[n], &w->eci[n]);
+
+						if (sin_el>v->sin_high || (sin_el>=v->sin_low && Degrees(ArcSin(sin_el))>=v->min_elevation))
+							row[k>>3]|=1<<(k&7);
+					}
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+int SGP4BatchVisibility(const sgp4_batch_t *batch, const station_t *station, int stations, double start, double step, int steps, double min_elevation, unsigned char *bits, int threads)
+{
+	/* Works out whether each satellite of the batch is at or above */
+	/* min_elevation degrees from each station at each of the steps */
+	/* times start, start+step, ... (unix epoch seconds).  bits     */
+	/* holds a row of (steps+7)/8 bytes for every satellite and     */
+	/* station, satellite major, and must start out zeroed; bit k%8 */
+	/* of byte k/8 of a row is set when visible at the k'th time.   */
+	/* Satellites are divided up between up to threads threads, the */
+	/* calling thread being one of them.  Besides bits, memory use  */
+	/* is a fixed amount per thread and station.  Returns -1 if     */
+	/* that can't be allocated.                                     */
+
+	visibility_t v;
+	visibility_worker_t *w;
+	pthread_t *tid;
+	int t, started, result=0;
+
+	v.batch=batch;
+	v.station=station;
+	v.stations=stations;
+	v.steps=steps;
+	v.next=0;
+	v.start=start;
+	v.step=step;
+	v.min_elevation=min_elevation;
+	v.bits=bits;
+
+	/* Leave a margin far wider than any rounding error, and leave */
+	/* everything in doubt when the sine isn't monotonic around it. */
+	if (fabs(min_elevation)<89.0)
+	{
+		v.sin_low=sin(min_elevation*deg2rad)-1.0E-9;
+		v.sin_high=sin(min_elevation*deg2rad)+1.0E-9;
+	}
+	else
+	{
+		v.sin_low=-2.0;
+		v.sin_high=2.0;
+	}
+
+	t=(batch->groups+batch->deep_count+VISIBILITY_CHUNK-1)/VISIBILITY_CHUNK;
+
+	if (threads>t)
+		threads=t;
+
+	if (threads<1)
+		threads=1;
+
+	w=calloc(threads, sizeof(visibility_worker_t));
+	tid=malloc(sizeof(pthread_t)*threads);
+
+	for (t=0; w!=NULL && t<threads; t++)
+	{
+		w[t].v=&v;
+		w[t].eci=malloc(sizeof(station_eci_t)*(stations ? stations : 1));
+
+		if (w[t].eci==NULL)
+			result=-1;
+	}
+
+	if (w==NULL || tid==NULL || result!=0)
+	{
+		result=-1;
+		goto cleanup;
+	}
+
+	for (started=0; started<threads-1; started++)
+		if (pthread_create(&tid[started], NULL, VisibilityWorker, &w[started+1])!=0)
+			break;
+
+	/* This thread works too, and finishes whatever is left */
+	VisibilityWorker(&w[0]);
+
+	for (t=0; t<started; t++)
+		pthread_join(tid[t], NULL);
+
+cleanup:
+	for (t=0; w!=NULL && t<threads; t++)
+		free(w[t].eci);
+
+	free(w);
+	free(tid);
+	return result;
+}
+
+/* Loading a batch straight from the text of a TLE file.  Records   */
+/* are found in one pass over the text, then parsed and initialized */
+/* by threads that each claim the next LOAD_CHUNK of them at a time. */
+
+#define LOAD_CHUNK  64
+
+typedef struct  {
+           const char  *line[3];    /* Name (or NULL), line 1 and line 2 */
+           int  length[3];
+        }  tle_record_t;
+
+typedef struct  {
+           const tle_record_t  *record;
+           context_t  *ctx;
+           int  count, next, failed;
+        }  load_t;
+
+static int NextLine(const char **text, const char *end, const char **line)
+{
+	/* Sets *line to the next line of the text that isn't blank and */
+	/* moves *text past it.  Returns its length, less any trailing  */
+	/* whitespace (which takes care of CR LF), or -1 at the end.    */
+
+	const char *eol;
+	int length;
+
+	while (*text<end)
+	{
+		eol=memchr(*text, '\n', end-*text);
+
+		if (eol==NULL)
+			eol=end;
+
+		*line=*text;
+		*text=eol<end ? eol+1 : end;
+
+		for (length=(int)(eol-*line); length>0 && isspace((unsigned char)(*line)[length-1]); length--);
+
+		if (length>0)
+			return length;
+	}
+
+	return -1;
+}
+
+static void CopyLine(char *to, size_t size, const char *from, int length)
+{
+	/* Copies what fits of a line, NUL terminated.  Lines longer */
+	/* than the TLE fields leave them full, so ReadTLE refuses.  */
+
+	if ((size_t)length>=size)
+		length=(int)size-1;
+
+	memcpy(to, from, length);
+	to[length]=0;
+}
+
+static char ReadRecord(sat_struct *sat, const tle_record_t *r)
+{
+	/* ReadTLE() of a record found by ScanRecords() */
+
+	char name[sizeof(((sat_struct *)0)->name)];
+	char line1[sizeof(((sat_struct *)0)->line1)+1];
+	char line2[sizeof(((sat_struct *)0)->line2)+1];
+
+	/* Names are only checked for being there; a 2LE record */
+	/* is named by its catalog number.                      */
+	if (r->line[0]!=NULL)
+		CopyLine(name, sizeof(name), r->line[0], r->length[0]);
+	else
+		CopyLine(name, sizeof(name), r->line[1]+2, 5);
+
+	CopyLine(line1, sizeof(line1), r->line[1], r->length[1]);
+	CopyLine(line2, sizeof(line2), r->line[2], r->length[2]);
+
+	return ReadTLE(sat, name, line1, line2);
+}
+
+static void *LoadWorker(void *arg)
+{
+	load_t *l=arg;
+	int i, first, last, failed;
+
+	while ((first=__sync_fetch_and_add(&l->next, LOAD_CHUNK)) < l->count)
+	{
+		last=first+LOAD_CHUNK<l->count ? first+LOAD_CHUNK : l->count;
+
+		for (i=first; i<last; i++)
+		{
+			if (ReadRecord(&l->ctx[i].sat, &l->record[i])!=0)
+			{
+				/* Keep the first bad record of all */
+				while ((failed=l->failed)>i)
+					if (__sync_bool_compare_and_swap(&l->failed, failed, i))
+						break;
+				continue;
+			}
+
+			PreCalc(&l->ctx[i]);
+		}
+	}
+
+	return NULL;
+}
+
+static int ScanRecords(const char *text, size_t length, tle_record_t **records, int *count, int *failed)
+{
+	/* Finds the records of a file of TLEs, three lines (name, line */
+	/* 1, line 2) or two to a record, blank lines ignored.  Returns */
+	/* 0, -1 if memory runs out or -2 if the text ends part way     */
+	/* through a record, whose index is then *failed.  The caller   */
+	/* frees *records in any case.                                  */
+
+	const char *end=text+length, *line;
+	tle_record_t *record=NULL, *grown;
+	int size=0, n;
+
+	*count=0;
+	*records=NULL;
+
+	while ((n=NextLine(&text, end, &line))>=0)
+	{
+		if (*count==size)
+		{
+			size=size ? 2*size : 1024;
+			grown=realloc(record, sizeof(tle_record_t)*size);
+
+			if (grown==NULL)
+				return -1;
+
+			*records=record=grown;
+		}
+
+		record[*count].line[0]=NULL;
+
+		/* A name, unless it is line 1 of a 2LE record */
+		if (line[0]!='1' || n<2 || line[1]!=' ')
+		{
+			record[*count].line[0]=line;
+			record[*count].length[0]=n;
+			n=NextLine(&text, end, &line);
+		}
+
+		record[*count].line[1]=line;
+		record[*count].length[1]=n;
+		record[*count].line[2]=line;
+		record[*count].length[2]=n<0 ? -1 : NextLine(&text, end, &record[*count].line[2]);
+
+		if (record[*count].length[1]<0 || record[*count].length[2]<0)
+		{
+			*failed=*count;
+			return -2;
+		}
+
+		(*count)++;
+	}
+
+	return 0;
+}
+
+int SGP4BatchLoad(sgp4_batch_t *batch, const char *text, size_t length, int threads, int *failed)
+{
+	/* Builds a batch from the text of a file of TLEs, three lines */
+	/* (name, line 1, line 2) or two to a record, blank lines      */
+	/* ignored, without going through python.  Up to threads       */
+	/* threads, the calling thread being one, parse and initialize */
+	/* the records.  Returns 0 on success, -1 if memory runs out,  */
+	/* or -2 if a record is not a valid TLE, in which case *failed */
+	/* is the index of the first one that isn't.                   */
+
+	tle_record_t *record;
+	int count, t, started, result;
+	load_t l;
+	pthread_t *tid=NULL;
+
+	memset(batch, 0, sizeof(*batch));
+	memset(&l, 0, sizeof(l));
+	*failed=-1;
+
+	if ((result=ScanRecords(text, length, &record, &count, failed))!=0)
+		goto cleanup;
+
+	l.record=record;
+	l.count=count;
+	l.failed=count;
+	l.ctx=calloc(count ? count : 1, sizeof(context_t));
+	tid=malloc(sizeof(pthread_t)*(threads>1 ? threads : 1));
+
+	if (l.ctx==NULL || tid==NULL)
+	{
+		result=-1;
+		goto cleanup;
+	}
+
+	t=(count+LOAD_CHUNK-1)/LOAD_CHUNK;
+
+	if (threads>t)
+		threads=t;
+
+	for (started=0; started<threads-1; started++)
+		if (pthread_create(&tid[started], NULL, LoadWorker, &l)!=0)
+			break;
+
+	LoadWorker(&l);
+
+	for (t=0; t<started; t++)
+		pthread_join(tid[t], NULL);
+
+	if (l.failed<count)
+	{
+		*failed=l.failed;
+		result=-2;
+	}
+	else
+		result=SGP4BatchInit(batch, l.ctx, count);
+
+cleanup:
+	free(record);
+	free(l.ctx);
+	free(tid);
+	return result;
+}
+
+/* Compiled catalogs: a batch written out as it lies in memory, so that
+   loading one is an mmap() with no parsing or initialization at all,
+   and the pages are shared by every process that maps the same file.
+   The structures are laid out by the compiler for the target, so a
+   file is only loaded by a build that lays them out the same way as
+   the one that wrote it.
+
+   The file is a compiled_header_t, then the groups, the deep-space
+   contexts, the elements (with the source TLE lines) of every
+   satellite and the index arrays, each section COMPILED_ALIGN aligned. */
+
+#define COMPILED_MAGIC    "PREDICTC"
+#define COMPILED_VERSION  3
+#define COMPILED_ORDER    0x01020304
+#define COMPILED_ALIGN    64
+
+typedef struct  {
+           char  magic[8];
+           int  version, order, lanes;
+           int  group_size, context_size, sat_size;
+           int  count, groups, deep_count, slots;
+           long long  group_offset, deep_offset, sat_offset, near_offset,
+               deep_index_offset, where_offset, slot_offset, size;
+        }  compiled_header_t;
+
+static long long CompiledSection(long long *offset, long long bytes)
+{
+	long long start=(*offset+COMPILED_ALIGN-1)/COMPILED_ALIGN*COMPILED_ALIGN;
+
+	*offset=start+bytes;
+	return start;
+}
+
+static void CompiledLayout(compiled_header_t *h, const sgp4_batch_t *batch)
+{
+	/* Fills in everything about the file but its offsets from the */
+	/* batch (or from the counts already in h if batch is NULL),   */
+	/* and the offsets from that.                                   */
+
+	long long offset=sizeof(compiled_header_t);
+
+	memcpy(h->magic, COMPILED_MAGIC, sizeof(h->magic));
+	h->version=COMPILED_VERSION;
+	h->order=COMPILED_ORDER;
+	h->lanes=SGP4_LANES;
+	h->group_size=sizeof(sgp4_group_t);
+	h->context_size=sizeof(context_t);
+	h->sat_size=sizeof(sat_struct);
+
+	if (batch!=NULL)
+	{
+		h->count=batch->count;
+		h->groups=batch->groups;
+		h->deep_count=batch->deep_count;
+		h->slots=batch->slots;
+	}
+
+	h->group_offset=CompiledSection(&offset, (long long)h->groups*sizeof(sgp4_group_t));
+	h->deep_offset=CompiledSection(&offset, (long long)h->deep_count*sizeof(context_t));
+	h->sat_offset=CompiledSection(&offset, (long long)h->count*sizeof(sat_struct));
+	h->near_offset=CompiledSection(&offset, (long long)h->groups*SGP4_LANES*sizeof(int));
+	h->deep_index_offset=CompiledSection(&offset, (long long)h->deep_count*sizeof(int));
+	h->where_offset=CompiledSection(&offset, (long long)h->count*sizeof(int));
+	h->slot_offset=CompiledSection(&offset, (long long)h->slots*sizeof(int));
+	h->size=offset;
+}
+
+static int WriteAt(int fd, long long *written, long long offset, const void *data, size_t length)
+{
+	/* Writes length bytes of data at offset, zero filling from */
+	/* what has been written so far.                            */
+
+	static const char zero[COMPILED_ALIGN];
+	ssize_t n;
+
+	while (*written<offset)
+	{
+		n=write(fd, zero, offset-*written<COMPILED_ALIGN ? offset-*written : COMPILED_ALIGN);
+
+		if (n<0 && errno==EINTR)
+			continue;
+		if (n<0)
+			return -1;
+
+		*written+=n;
+	}
+
+	while (length>0)
+	{
+		n=write(fd, data, length);
+
+		if (n<0 && errno==EINTR)
+			continue;
+		if (n<0)
+			return -1;
+
+		data=(const char *)data+n;
+		length-=n;
+		*written+=n;
+	}
+
+	return 0;
+}
+
+int SGP4BatchSave(const sgp4_batch_t *batch, int fd)
+{
+	/* Writes batch to fd as a compiled catalog.  The caller keeps */
+	/* it from being updated meanwhile.  Returns 0, or -1 with     */
+	/* errno set.                                                  */
+
+	compiled_header_t h;
+	context_t deep;
+	long long written=0;
+	int i;
+
+	memset(&h, 0, sizeof(h));
+	CompiledLayout(&h, batch);
+
+	if (WriteAt(fd, &written, 0, &h, sizeof(h))!=0)
+		return -1;
+
+	for (i=0; i<batch->groups; i++)
+		if (WriteAt(fd, &written, h.group_offset+(long long)i*sizeof(sgp4_group_t), BatchGroup(batch, i), sizeof(sgp4_group_t))!=0)
+			return -1;
+
+	for (i=0; i<batch->deep_count; i++)
+	{
+		/* Checkpoints are kept afresh by whoever maps the file */
+		deep=*BatchDeep(batch, i);
+		deep.sdp4.deep.kept=NULL;
+
+		if (WriteAt(fd, &written, h.deep_offset+(long long)i*sizeof(context_t), &deep, sizeof(context_t))!=0)
+			return -1;
+	}
+
+	for (i=0; i<batch->count; i++)
+		if (WriteAt(fd, &written, h.sat_offset+(long long)i*sizeof(sat_struct), SGP4BatchSat(batch, i), sizeof(sat_struct))!=0)
+			return -1;
+
+	if (WriteAt(fd, &written, h.near_offset, batch->near_index, (size_t)batch->groups*SGP4_LANES*sizeof(int))!=0 ||
+	    WriteAt(fd, &written, h.deep_index_offset, batch->deep_index, (size_t)batch->deep_count*sizeof(int))!=0 ||
+	    WriteAt(fd, &written, h.where_offset, batch->where, (size_t)batch->count*sizeof(int))!=0 ||
+	    WriteAt(fd, &written, h.slot_offset, batch->slot, (size_t)batch->slots*sizeof(int))!=0 ||
+	    WriteAt(fd, &written, h.size, NULL, 0)!=0)
+		return -1;
+
+	return 0;
+}
+
+static int Terminated(const sat_struct *sat)
+{
+	/* Whether the name and lines of mapped elements end inside */
+	/* their arrays, as they must to be read as C strings.       */
+
+	return memchr(sat->name, 0, sizeof(sat->name))!=NULL &&
+	       memchr(sat->line1, 0, sizeof(sat->line1))!=NULL &&
+	       memchr(sat->line2, 0, sizeof(sat->line2))!=NULL;
+}
+
+static int CompiledValid(const compiled_header_t *h, size_t size)
+{
+	compiled_header_t layout;
+
+	if (size<sizeof(compiled_header_t) || memcmp(h->magic, COMPILED_MAGIC, sizeof(h->magic))!=0)
+		return 0;
+
+	if (h->count<0 || h->groups<0 || h->deep_count<0 || h->deep_count>h->count ||
+	    h->groups<(h->count-h->deep_count+SGP4_LANES-1)/SGP4_LANES ||
+	    h->groups>(h->count-h->deep_count+SGP4_LANES-1)/SGP4_LANES+1 ||
+	    h->slots<16 || (h->slots&(h->slots-1))!=0 || h->slots<2*h->count)
+		return 0;
+
+	memset(&layout, 0, sizeof(layout));
+	layout.count=h->count;
+	layout.groups=h->groups;
+	layout.deep_count=h->deep_count;
+	layout.slots=h->slots;
+	CompiledLayout(&layout, NULL);
+
+	return memcmp(&layout, h, sizeof(layout))==0 && (size_t)h->size<=size;
+}
+
+int SGP4BatchMap(sgp4_batch_t *batch, int fd)
+{
+	/* Loads the compiled catalog in fd into batch by mapping it.  */
+	/* The mapping is private, so pages are shared between the      */
+	/* processes that map the file until SGP4BatchUpdate() changes  */
+	/* one.  Returns 0, -1 with errno set, or -2 if fd isn't a      */
+	/* compiled catalog this build can load.                        */
+
+	compiled_header_t *h;
+	const deep_t *dp;
+	struct stat st;
+	char *map;
+	int i, lanes, used;
+
+	memset(batch, 0, sizeof(*batch));
+
+	if (fstat(fd, &st)!=0)
+		return -1;
+
+	if (S_ISDIR(st.st_mode))
+	{
+		errno=EISDIR;
+		return -1;
+	}
+
+	if ((size_t)st.st_size<sizeof(compiled_header_t))
+		return -2;
+
+	map=mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+	if (map==MAP_FAILED)
+		return -1;
+
+	batch->map=map;
+	batch->map_size=st.st_size;
+	h=(compiled_header_t *)map;
+
+	if (!CompiledValid(h, st.st_size))
+	{
+		SGP4BatchFree(batch);
+		return -2;
+	}
+
+	batch->count=h->count;
+	batch->groups=h->groups;
+	batch->deep_count=h->deep_count;
+	batch->slots=h->slots;
+	batch->near_index=(int *)(map+h->near_offset);
+	batch->deep_index=(int *)(map+h->deep_index_offset);
+	batch->where=(int *)(map+h->where_offset);
+	batch->slot=(int *)(map+h->slot_offset);
+
+	/* Everything read through an index is checked for being in */
+	/* range, so that a damaged file can't send readers astray.  */
+
+	lanes=h->groups*SGP4_LANES;
+
+	for (i=0; i<lanes; i++)
+		if (batch->near_index[i]<-1 || batch->near_index[i]>=h->count)
+			goto invalid;
+
+	for (i=0; i<h->deep_count; i++)
+		if (batch->deep_index[i]<0 || batch->deep_index[i]>=h->count)
+			goto invalid;
+
+	for (i=0; i<h->count; i++)
+		if (batch->where[i]<-h->deep_count || batch->where[i]>=lanes)
+			goto invalid;
+
+	for (i=0, used=0; i<h->slots; used+=batch->slot[i]!=0, i++)
+		if (batch->slot[i]<0 || batch->slot[i]>h->count)
+			goto invalid;
+
+	if (used>h->count)
+		goto invalid;
+
+	/* Which kernel runs a group is looked up by its class */
+	for (i=0; i<h->groups; i++)
+		if ((unsigned)((sgp4_group_t *)(map+h->group_offset))[i].simple>1)
+			goto invalid;
+
+	/* and each deep-space satellite's checkpoints are kept in a */
+	/* table allocated below, which the file has no pointer to   */
+	for (i=0; i<h->deep_count; i++)
+	{
+		dp=&((context_t *)(map+h->deep_offset))[i].sdp4.deep;
+
+		if (dp->kept!=NULL || !Terminated(&((context_t *)(map+h->deep_offset))[i].sat))
+			goto invalid;
+	}
+
+	/* and the elements' strings are read up to their NUL */
+	for (i=0; i<h->count; i++)
+		if (!Terminated((sat_struct *)(map+h->sat_offset)+i))
+			goto invalid;
+
+	batch->group=malloc(sizeof(sgp4_group_t *)*(h->groups+1));
+	batch->deep=malloc(sizeof(context_t *)*(h->deep_count+1));
+	batch->sat=malloc(sizeof(sat_struct *)*(h->count+1));
+
+	if (batch->group==NULL || batch->deep==NULL || batch->sat==NULL)
+	{
+		free(batch->group);
+		free(batch->deep);
+		free(batch->sat);
+		batch->group=NULL;
+		batch->deep=NULL;
+		batch->sat=NULL;
+		SGP4BatchFree(batch);
+		errno=ENOMEM;
+		return -1;
+	}
+
+	for (i=0; i<h->groups; i++)
+		batch->group[i]=(sgp4_group_t *)(map+h->group_offset)+i;
+
+	for (i=0; i<h->deep_count; i++)
+		batch->deep[i]=(context_t *)(map+h->deep_offset)+i;
+
+	for (i=0; i<h->count; i++)
+		batch->sat[i]=(sat_struct *)(map+h->sat_offset)+i;
+
+	/* Only the pages of the satellites in resonance are written */
+	/* to, becoming this process's own copies.                   */
+	for (i=0; i<h->deep_count; i++)
+		if (KeepDeepCheckpoints(batch->deep[i])!=0)
+		{
+			SGP4BatchFree(batch);
+			errno=ENOMEM;
+			return -1;
+		}
+
+	return 0;
+
+invalid:
+	SGP4BatchFree(batch);
+	return -2;
+}
+
+/* History archives: every element set of many satellites over years,
+   sorted by NORAD id and then epoch, so that the one to use for a
+   satellite at any time is found by binary search.  Archives are
+   written out and mapped back the way compiled catalogs are, as a
+   header and then the entries. */
+
+#define ARCHIVE_MAGIC    "PREDICTA"
+#define ARCHIVE_VERSION  1
+
+typedef struct  {
+           char  magic[8];
+           int  version, order, entry_size, count;
+           long long  entry_offset, size;
+        }  archive_header_t;
+
+static void SetEntry(tle_entry_t *entry, const sat_struct *sat)
+{
+	memset(entry, 0, sizeof(*entry));
+	entry->catnum=sat->catnum;
+	entry->epoch=Julian_Date_of_Epoch(1000.0*(double)sat->year+sat->refepoch)-2444238.5;
+	memcpy(entry->name, sat->name, sizeof(entry->name));
+	memcpy(entry->line1, sat->line1, sizeof(entry->line1));
+	memcpy(entry->line2, sat->line2, sizeof(entry->line2));
+}
+
+char TLEEntry(tle_entry_t *entry, const char *name, const char *line1, const char *line2)
+{
+	/* Fills in an archive entry from a TLE, returning ReadTLE()'s */
+	/* error flags, 0 if the TLE is valid.                         */
+
+	sat_struct sat;
+	char error_flags;
+
+	memset(&sat, 0, sizeof(sat));
+
+	if ((error_flags=ReadTLE(&sat, name, line1, line2))==0)
+		SetEntry(entry, &sat);
+
+	return error_flags;
+}
+
+static int CompareEntries(const void *a, const void *b)
+{
+	const tle_entry_t *x=a, *y=b;
+
+	if (x->catnum!=y->catnum)
+		return x->catnum<y->catnum ? -1 : 1;
+
+	if (x->epoch!=y->epoch)
+		return x->epoch<y->epoch ? -1 : 1;
+
+	return strcmp(x->line1, y->line1);
+}
+
+void TLEArchiveInit(tle_archive_t *archive, tle_entry_t *entry, int count)
+{
+	/* Makes an archive of count entries allocated with malloc(), */
+	/* which it sorts and takes over.                              */
+
+	memset(archive, 0, sizeof(*archive));
+	qsort(entry, count, sizeof(tle_entry_t), CompareEntries);
+	archive->entry=entry;
+	archive->count=count;
+}
+
+int TLEArchiveLoad(tle_archive_t *archive, const char *text, size_t length, int *failed)
+{
+	/* Makes an archive of every TLE in the text of a file, as   */
+	/* SGP4BatchLoad() reads them.  Returns 0, -1 if memory runs */
+	/* out, or -2 if a record is not a valid TLE, in which case  */
+	/* *failed is the index of the first one that isn't.         */
+
+	tle_record_t *record;
+	tle_entry_t *entry=NULL;
+	sat_struct sat;
+	int count, i, result;
+
+	memset(archive, 0, sizeof(*archive));
+	*failed=-1;
+
+	if ((result=ScanRecords(text, length, &record, &count, failed))!=0)
+		goto cleanup;
+
+	if ((entry=malloc(sizeof(tle_entry_t)*(count+1)))==NULL)
+	{
+		result=-1;
+		goto cleanup;
+	}
+
+	for (i=0; i<count; i++)
+	{
+		memset(&sat, 0, sizeof(sat));
+
+		if (ReadRecord(&sat, &record[i])!=0)
+		{
+			*failed=i;
+			result=-2;
+			goto cleanup;
+		}
+
+		SetEntry(&entry[i], &sat);
+	}
+
+	TLEArchiveInit(archive, entry, count);
+	entry=NULL;
+
+cleanup:
+	free(record);
+	free(entry);
+	return result;
+}
+
+void TLEArchiveFree(tle_archive_t *archive)
+{
+	if (archive->map!=NULL)
+		munmap(archive->map, archive->map_size);
+	else
+		free(archive->entry);
+
+	memset(archive, 0, sizeof(*archive));
+}
+
+int TLEArchiveFind(const tle_archive_t *archive, long catnum, double daynum, int before)
+{
+	/* Index of the element set of catnum to use at daynum: the   */
+	/* one whose epoch is nearest to it or, if before is set, the */
+	/* latest at or before it.  Returns -1 if there is none.      */
+
+	const tle_entry_t *entry=archive->entry;
+	int low=0, high=archive->count, middle, after, prior;
+
+	/* The first entry at or after (catnum, daynum) */
+	while (low<high)
+	{
+		middle=low+(high-low)/2;
+
+		if (entry[middle].catnum<catnum || (entry[middle].catnum==catnum && entry[middle].epoch<daynum))
+			low=middle+1;
+		else
+			high=middle;
+	}
+
+	after=low<archive->count && entry[low].catnum==catnum ? low : -1;
+	prior=low>0 && entry[low-1].catnum==catnum ? low-1 : -1;
+
+	if (before)
+		return after>=0 && entry[after].epoch==daynum ? after : prior;
+
+	if (after<0 || prior<0)
+		return after<0 ? prior : after;
+
+	return daynum-entry[prior].epoch<=entry[after].epoch-daynum ? prior : after;
+}
+
+int TLEArchiveSave(const tle_archive_t *archive, int fd)
+{
+	/* Writes archive to fd, to be mapped by TLEArchiveMap(). */
+	/* Returns 0, or -1 with errno set.                        */
+
+	archive_header_t h;
+	long long written=0, offset=sizeof(h);
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, ARCHIVE_MAGIC, sizeof(h.magic));
+	h.version=ARCHIVE_VERSION;
+	h.order=COMPILED_ORDER;
+	h.entry_size=sizeof(tle_entry_t);
+	h.count=archive->count;
+	h.entry_offset=CompiledSection(&offset, (long long)archive->count*sizeof(tle_entry_t));
+	h.size=offset;
+
+	if (WriteAt(fd, &written, 0, &h, sizeof(h))!=0 ||
+	    WriteAt(fd, &written, h.entry_offset, archive->entry, (size_t)archive->count*sizeof(tle_entry_t))!=0)
+		return -1;
+
+	return 0;
+}
+
+int TLEArchiveMap(tle_archive_t *archive, int fd)
+{
+	/* Loads the archive written to fd by TLEArchiveSave() by    */
+	/* mapping it read only.  Returns 0, -1 with errno set, or   */
+	/* -2 if fd isn't an archive this build can load.            */
+
+	const archive_header_t *h;
+	struct stat st;
+	long long offset=sizeof(archive_header_t);
+	char *map;
+	int i;
+
+	memset(archive, 0, sizeof(*archive));
+
+	if (fstat(fd, &st)!=0)
+		return -1;
+
+	if (S_ISDIR(st.st_mode))
+	{
+		errno=EISDIR;
+		return -1;
+	}
+
+	if ((size_t)st.st_size<sizeof(archive_header_t))
+		return -2;
+
+	map=mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (map==MAP_FAILED)
+		return -1;
+
+	archive->map=map;
+	archive->map_size=st.st_size;
+	h=(const archive_header_t *)map;
+
+	if (memcmp(h->magic, ARCHIVE_MAGIC, sizeof(h->magic))!=0 || h->version!=ARCHIVE_VERSION ||
+	    h->order!=COMPILED_ORDER || h->entry_size!=sizeof(tle_entry_t) || h->count<0 ||
+	    h->entry_offset!=CompiledSection(&offset, (long long)h->count*sizeof(tle_entry_t)) ||
+	    h->size!=offset || h->size>(long long)st.st_size)
+	{
+		TLEArchiveFree(archive);
+		return -2;
+	}
+
+	archive->entry=(tle_entry_t *)(map+h->entry_offset);
+	archive->count=h->count;
+
+	/* Entries are compared and read as C strings, which must */
+	/* end inside their arrays, and not run on past the map     */
+	for (i=0; i<archive->count; i++)
+		if (memchr(archive->entry[i].name, 0, sizeof(archive->entry[i].name))==NULL ||
+		    memchr(archive->entry[i].line1, 0, sizeof(archive->entry[i].line1))==NULL ||
+		    memchr(archive->entry[i].line2, 0, sizeof(archive->entry[i].line2))==NULL)
+		{
+			TLEArchiveFree(archive);
+			return -2;
+		}
+
+	/* Searches are only right if it really is in order */
+	for (i=1; i<archive->count; i++)
+		if (CompareEntries(&archive->entry[i-1], &archive->entry[i])>0)
+		{
+			TLEArchiveFree(archive);
+			return -2;
+		}
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+/* Benchmark of incremental propagation: sweeps through time at a fixed
+   step with INCREMENTAL_FLAG set, each call starting Kepler's equation
+   from the last solution and stepping the deep-space state on, against
+   the stateless path that calls ResetDeep() and starts from capu every
+   time.  Reports the propagations per second of each and how far apart
+   their positions come out, which should stay within e6a radians of
+   eccentric anomaly, 1.1e-6 of the semi-major axis (test_incremental.py
+   holds them to it).
+
+	make bench_step && ./bench_step [seconds]
+*/
+
+#include "predict.h"
+
+#define STEPS  8640
+
+static const char *tles[][3]={
+	{"ISS", "1 25544U 98067A   26285.50000000  .00016717  00000-0  10270-3 0  9993",
+	        "2 25544  51.6416 247.4627 0006703 130.5360 325.0288 15.72125391563537"},
+	{"SSO", "1 40044U 14033AL  26284.74135905  .00002013  00000-0  31503-3 0  6111",
+	        "2 40044  97.9584 269.2923 0059425 258.2447 101.2095 14.72707190304436"},
+	{"GPS", "1 32711U 08012A   26285.50000000 -.00000058  00000-0  00000+0 0  9996",
+	        "2 32711  55.4408 300.3623 0111131  52.5620 308.4826  2.00563146 85345"},
+	{"MOLNIYA", "1 21118U 91012A   26285.50000000  .00000136  00000-0  10000-3 0  9998",
+	        "2 21118  62.8640 103.1190 7283420 269.4519  16.6823  2.00612789199996"},
+	{"GEO", "1 28884U 05041A   26285.50000000 -.00000100  00000-0  00000+0 0  9999",
+	        "2 28884   8.5000  60.0000 0002000 100.0000 260.0000  1.00400000 70004"}
+};
+
+static double Seconds(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec+tv.tv_usec/1.0e6;
+}
+
+static void Sweep(context_t *ctx, int incremental, double start, double step, vector_t *pos)
+{
+	/* Propagates the template ctx to STEPS times step days apart */
+
+	context_t c=*ctx;
+	vector_t vel;
+	int x;
+
+	ResetDeep(&c);
+
+	if (incremental)
+		SetFlag(&c, INCREMENTAL_FLAG);
+
+	for (x=0; x<STEPS; x++)
+	{
+		if (!incremental)
+			ResetDeep(&c);
+
+		c.daynum=start+x*step;
+		Propagate(&c, &pos[x], &vel);
+	}
+}
+
+static double Throughput(context_t *ctx, int incremental, double start, double step, double seconds)
+{
+	/* Propagations per second, over about the given time */
+
+	static vector_t pos[STEPS];
+	long n=0;
+	double begin=Seconds(), elapsed;
+
+	do
+	{
+		Sweep(ctx, incremental, start, step, pos);
+		n+=STEPS;
+		elapsed=Seconds()-begin;
+	} while (elapsed<seconds);
+
+	return n/elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	static vector_t cold[STEPS], warm[STEPS];
+	static const double steps[]={1.0, 10.0, 60.0};
+	context_t ctx;
+	int x, y, z, bad=0;
+	double seconds=argc>1 ? atof(argv[1]) : 0.5, start, worst, dr, stateless, incremental;
+
+	printf("%-8s %5s  %12s  %12s  %10s\n", "", "step", "stateless/s", "stepping/s", "max |dr|");
+
+	for (x=0; x<(int)(sizeof(tles)/sizeof(tles[0])); x++)
+	{
+		memset(&ctx, 0, sizeof(ctx));
+
+		if (ReadTLE(&ctx.sat, tles[x][0], tles[x][1], tles[x][2])!=0)
+		{
+			printf("%s: bad TLE\n", tles[x][0]);
+			return 1;
+		}
+
+		PreCalc(&ctx);
+
+		/* A day and a half after epoch, in predict's day numbers */
+		start=DayNum(1, 1, 26)+284.5+1.5;
+
+		for (y=0; y<(int)(sizeof(steps)/sizeof(steps[0])); y++)
+		{
+			Sweep(&ctx, 0, start, steps[y]/86400.0, cold);
+			Sweep(&ctx, 1, start, steps[y]/86400.0, warm);
+
+			for (z=0, worst=0.0; z<STEPS; z++)
+			{
+				dr=sqrt(Sqr(cold[z].x-warm[z].x)+Sqr(cold[z].y-warm[z].y)+Sqr(cold[z].z-warm[z].z));
+
+				if (dr>worst)
+					worst=dr;
+			}
+
+			/* e6a radians of eccentric anomaly on a geostationary orbit, and some */
+			if (worst>0.1)
+				bad=1;
+
+			stateless=Throughput(&ctx, 0, start, steps[y]/86400.0, seconds);
+			incremental=Throughput(&ctx, 1, start, steps[y]/86400.0, seconds);
+
+			printf("%-8s %4.0fs  %12.0f  %12.0f  %8.2f m  (%.2fx)\n", tles[x][0], steps[y],
+				stateless, incremental, 1000.0*worst, incremental/stateless);
+		}
+	}
+
+	if (bad)
+	{
+		printf("stepping strayed more than 100 m from the stateless path\n");
+		return 1;
+	}
+
+	return 0;
+}
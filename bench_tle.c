@@ -0,0 +1,234 @@
+/* Microbenchmark of TLE parsing: ReadTLE() (KepCheck() and
+   InternalUpdate()) against the SubString()/atof() decoder it
+   replaced, which is kept here for comparison.  Every TLE is decoded
+   both ways first, and the fields must come out bit for bit the same,
+   including for TLEs with garbage in their fields.
+
+	make bench_tle && ./bench_tle [seconds]
+*/
+
+#include "predict.h"
+
+#define DISTINCT  1024
+
+static char LegacyKepCheck(const char *line1, const char *line2)
+{
+	int x;
+	unsigned sum1, sum2;
+
+	for (x=0, sum1=0, sum2=0; x<=67; sum1+=val[(int)line1[x]], sum2+=val[(int)line2[x]], x++);
+
+	x=(val[(int)line1[68]]^(sum1%10)) | (val[(int)line2[68]]^(sum2%10)) |
+	  (line1[0]^'1')  | (line1[1]^' ')  | (line1[7]^'U')  |
+	  (line1[8]^' ')  | (line1[17]^' ') | (line1[23]^'.') |
+	  (line1[32]^' ') | (line1[34]^'.') | (line1[43]^' ') |
+	  (line1[52]^' ') | (line1[61]^' ') | (line1[62]^'0') |
+	  (line1[63]^' ') | (line2[0]^'2')  | (line2[1]^' ')  |
+	  (line2[7]^' ')  | (line2[11]^'.') | (line2[16]^' ') |
+	  (line2[20]^'.') | (line2[25]^' ') | (line2[33]^' ') |
+	  (line2[37]^'.') | (line2[42]^' ') | (line2[46]^'.') |
+	  (line2[51]^' ') | (line2[54]^'.') | (line1[2]^line2[2]) |
+	  (line1[3]^line2[3]) | (line1[4]^line2[4]) |
+	  (line1[5]^line2[5]) | (line1[6]^line2[6]) |
+	  (isdigit(line1[68]) ? 0 : 1) | (isdigit(line2[68]) ? 0 : 1) |
+	  (isdigit(line1[18]) ? 0 : 1) | (isdigit(line1[19]) ? 0 : 1) |
+	  (isdigit(line2[31]) ? 0 : 1) | (isdigit(line2[32]) ? 0 : 1);
+
+	return (x ? 0 : 1);
+}
+
+static void LegacyInternalUpdate(sat_struct *sat)
+{
+	double tempnum;
+	char temp[80];
+
+	memset(sat->designator, 0, sizeof(sat->designator));
+	strncpy(sat->designator,SubString(sat->line1,9,16,temp),8);
+	sat->designator[9]=0;
+	sat->catnum=atol(SubString(sat->line1,2,6,temp));
+	sat->year=atoi(SubString(sat->line1,18,19,temp));
+	sat->refepoch=atof(SubString(sat->line1,20,31,temp));
+	tempnum=1.0e-5*atof(SubString(sat->line1,44,49,temp));
+	sat->nddot6=tempnum/pow(10.0,(sat->line1[51]-'0'));
+	tempnum=1.0e-5*atof(SubString(sat->line1,53,58,temp));
+	sat->bstar=tempnum/pow(10.0,(sat->line1[60]-'0'));
+	sat->setnum=atol(SubString(sat->line1,64,67,temp));
+	sat->incl=atof(SubString(sat->line2,8,15,temp));
+	sat->raan=atof(SubString(sat->line2,17,24,temp));
+	sat->eccn=1.0e-07*atof(SubString(sat->line2,26,32,temp));
+	sat->argper=atof(SubString(sat->line2,34,41,temp));
+	sat->meanan=atof(SubString(sat->line2,43,50,temp));
+	sat->meanmo=atof(SubString(sat->line2,52,62,temp));
+	sat->drag=atof(SubString(sat->line1,33,42,temp));
+	sat->orbitnum=atof(SubString(sat->line2,63,67,temp));
+}
+
+static char LegacyReadTLE(sat_struct *sat, const char *line0, const char *line1, const char *line2)
+{
+	/* ReadTLE() as it was, over the legacy decoder */
+
+	unsigned long la, lb, lc;
+	char error_flags,a,b,c,d;
+
+	la = strnlen(line0,sizeof(sat->name));
+	lb = strnlen(line1,sizeof(sat->line1));
+	lc = strnlen(line2,sizeof(sat->line2));
+	a = ((la == 0) || (la >= sizeof(sat->name)));
+	b = ((lb == 0) || (lb >= sizeof(sat->line1)));
+	c = ((lc == 0) || (lc >= sizeof(sat->line2)));
+	d = !LegacyKepCheck(line1, line2);
+	error_flags = (a << 3) | (b << 2) | (c << 1) | (d << 0);
+	if (error_flags == 0)
+	{
+		strncpy(sat->name,line0,sizeof(sat->name)-1);
+		strncpy(sat->line1,line1,sizeof(sat->line1)-1);
+		strncpy(sat->line2,line2,sizeof(sat->line2)-1);
+		LegacyInternalUpdate(sat);
+	}
+	return error_flags;
+}
+
+static int Checksum(const char *line)
+{
+	int x, sum;
+
+	for (x=0, sum=0; x<68; x++)
+		sum+=isdigit(line[x]) ? line[x]-'0' : (line[x]=='-');
+
+	return sum%10;
+}
+
+static double Uniform(double low, double high)
+{
+	return low+(high-low)*(rand()/(RAND_MAX+1.0));
+}
+
+static void MakeTLE(char *line1, char *line2, long catnum)
+{
+	/* A random, valid TLE in the published layout */
+
+	int sign=rand()%3;
+
+	sprintf(line1, "1 %05ldU %-8s %02d%012.8f %c.%08ld %c%05ld-%d %c%05ld-%d 0 %4ld",
+		catnum, "98067A", rand()%100, Uniform(1.0, 366.0),
+		sign ? ' ' : '-', (long)(rand()%100000), ' ', 0L, 0,
+		sign==2 ? '-' : ' ', 10000+(long)(rand()%90000), rand()%10, (long)(rand()%10000));
+	line1[68]='0'+Checksum(line1);
+	line1[69]=0;
+
+	sprintf(line2, "2 %05ld %8.4f %8.4f %07ld %8.4f %8.4f %11.8f%5ld",
+		catnum, Uniform(0.0, 180.0), Uniform(0.0, 360.0), (long)(rand()%10000000),
+		Uniform(0.0, 360.0), Uniform(0.0, 360.0), Uniform(0.5, 16.5), (long)(rand()%100000));
+	line2[68]='0'+Checksum(line2);
+	line2[69]=0;
+}
+
+static int SameFields(const sat_struct *a, const sat_struct *b)
+{
+	return strcmp(a->designator, b->designator)==0 && a->catnum==b->catnum &&
+		a->year==b->year && a->setnum==b->setnum && a->orbitnum==b->orbitnum &&
+		memcmp(&a->refepoch, &b->refepoch, sizeof(double))==0 &&
+		memcmp(&a->nddot6, &b->nddot6, sizeof(double))==0 &&
+		memcmp(&a->bstar, &b->bstar, sizeof(double))==0 &&
+		memcmp(&a->incl, &b->incl, sizeof(double))==0 &&
+		memcmp(&a->raan, &b->raan, sizeof(double))==0 &&
+		memcmp(&a->eccn, &b->eccn, sizeof(double))==0 &&
+		memcmp(&a->argper, &b->argper, sizeof(double))==0 &&
+		memcmp(&a->meanan, &b->meanan, sizeof(double))==0 &&
+		memcmp(&a->meanmo, &b->meanmo, sizeof(double))==0 &&
+		memcmp(&a->drag, &b->drag, sizeof(double))==0;
+}
+
+static double Seconds(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec+tv.tv_usec/1.0e6;
+}
+
+static double Throughput(char (*read)(sat_struct *, const char *, const char *, const char *),
+	char line1[][70], char line2[][70], double seconds)
+{
+	/* TLEs read per second, over about the given time */
+
+	sat_struct sat;
+	long n=0;
+	int x, bad=0;
+	double start=Seconds(), elapsed;
+
+	do
+	{
+		for (x=0; x<DISTINCT; x++, n++)
+			bad|=read(&sat, "BENCH", line1[x], line2[x]);
+		elapsed=Seconds()-start;
+	} while (elapsed<seconds);
+
+	if (bad)
+		fprintf(stderr, "a benchmark TLE failed to parse\n");
+
+	return n/elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	static char line1[DISTINCT][70], line2[DISTINCT][70];
+	static const char garbage[]=" +-.0123456789eEx";
+	char bad1[70], bad2[70];
+	sat_struct a, b;
+	int x, y, mismatches=0;
+	double seconds=argc>1 ? atof(argv[1]) : 1.0, legacy, fixed;
+
+	for (x=0; x<=255; val[x]=0, x++);
+	for (x='0'; x<='9'; val[x]=x-'0', x++);
+	val['-']=1;
+
+	srand(16);
+
+	for (x=0; x<DISTINCT; x++)
+	{
+		MakeTLE(line1[x], line2[x], 10000+x);
+
+		memset(&a, 0, sizeof(a));
+		memset(&b, 0, sizeof(b));
+
+		if (ReadTLE(&a, "BENCH", line1[x], line2[x])!=0 ||
+		    LegacyReadTLE(&b, "BENCH", line1[x], line2[x])!=0 || !SameFields(&a, &b))
+			mismatches++;
+
+		/* Field columns full of junk must decode the same too */
+		for (y=0; y<8; y++)
+		{
+			strcpy(bad1, line1[x]);
+			strcpy(bad2, line2[x]);
+			bad1[18+rand()%50]=garbage[rand()%(sizeof(garbage)-1)];
+			bad2[8+rand()%60]=garbage[rand()%(sizeof(garbage)-1)];
+
+			if (KepCheck(bad1, bad2)!=LegacyKepCheck(bad1, bad2))
+				mismatches++;
+
+			strcpy(a.line1, bad1);
+			strcpy(a.line2, bad2);
+			strcpy(b.line1, bad1);
+			strcpy(b.line2, bad2);
+			InternalUpdate(&a);
+			LegacyInternalUpdate(&b);
+
+			if (!SameFields(&a, &b))
+				mismatches++;
+		}
+	}
+
+	if (mismatches)
+	{
+		printf("%d mismatches between the decoders\n", mismatches);
+		return 1;
+	}
+
+	legacy=Throughput(LegacyReadTLE, line1, line2, seconds);
+	fixed=Throughput(ReadTLE, line1, line2, seconds);
+
+	printf("SubString/atof: %10.0f TLEs/s\n", legacy);
+	printf("fixed column:   %10.0f TLEs/s  (%.1fx)\n", fixed, fixed/legacy);
+	return 0;
+}
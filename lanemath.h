@@ -0,0 +1,424 @@
+/* Vector math over lanes of doubles (lane_t, see predict.h), for the
+   batch kernels in batch.c.  Include predict.h first.
+
+   lane_sincos() and lane_atan2() work on whole vectors, without a call
+   into libm per lane.  They are fdlibm's algorithms (as musl has
+   them): Cody and Waite's reduction by pi/2 and the minimax
+   polynomials of __sin() and __cos(), and atan() reduced by its table
+   of breakpoints.  Each is within a unit or two in the last place of
+   libm (test_lanemath.c holds them to it), but not bit for bit the
+   same.  Lanes whose arguments these don't cover (huge, infinite or
+   NaN, and atan2(0,0)) fall back to libm.
+
+   lane_fmod2p() is FMod2p() exactly, so the kernels that must agree
+   with SGP4() bit for bit can use it too.
+
+   Everything is built from vector arithmetic, bit operations and
+   selects, so it compiles for whichever instruction set its caller is
+   built for (see SGP4BatchSelectKernels()), and nothing may be
+   contracted into fused multiply-adds, which the reductions rely on.
+   Lanes are compared by the sign of a difference (lane_negative())
+   rather than with < and the like, which GCC does one lane at a time
+   on SSE2, where that made lane_sincos() slower than libm. */
+
+#ifndef LANEMATH_H
+#define LANEMATH_H
+
+#define LANE_INLINE  static inline __attribute__ ((always_inline))
+
+typedef int lane_int_t __attribute__ ((vector_size (SGP4_LANES*sizeof(int))));
+typedef unsigned long long lane_bits_t __attribute__ ((vector_size (SGP4_LANES*sizeof(long long))));
+
+#define LANE_SIGN  ((long long)0x8000000000000000ULL)
+
+LANE_INLINE lane_t lane_select(lane_mask_t mask, lane_t a, lane_t b)
+{
+	/* Lanes of a where mask is set, lanes of b elsewhere */
+
+	return (lane_t)(((lane_mask_t)a&mask)|((lane_mask_t)b&~mask));
+}
+
+LANE_INLINE int lane_any(lane_mask_t mask)
+{
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+		if (mask[i])
+			return 1;
+
+	return 0;
+}
+
+LANE_INLINE lane_mask_t lane_negative(lane_t x)
+{
+	/* Mask of the lanes of x with the sign bit set, -0.0 and    */
+	/* NaNs included.  Comparing a-b (or a+0.0, which is +0.0 at */
+	/* -0.0) with this stands in for a<b, which GCC does lane by */
+	/* lane on SSE2 for vectors wider than its registers.        */
+
+	return -(lane_mask_t)((lane_bits_t)x>>63);
+}
+
+LANE_INLINE int lane_any_negative(lane_mask_t m)
+{
+	/* Whether any lane of m is negative, with no 64-bit compare */
+	/* of lanes, which SSE2 lacks                                */
+
+	long long any=0;
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+		any|=m[i];
+
+	return any<0;
+}
+
+LANE_INLINE lane_t lane_splat(double x)
+{
+	/* x in every lane */
+
+	return (lane_t){0.0}+x;
+}
+
+LANE_INLINE lane_t lane_abs(lane_t x)
+{
+	return (lane_t)((lane_mask_t)x&0x7fffffffffffffffLL);
+}
+
+LANE_INLINE lane_t lane_rint(lane_t x)
+{
+	/* x rounded to the nearest integer, for |x| < 2^51 */
+
+	const double toint=6755399441055744.0;  /* 1.5*2^52 */
+
+	return (x+toint)-toint;
+}
+
+LANE_INLINE lane_t lane_sqrt(lane_t x)
+{
+	lane_t r;
+	int i;
+
+	for (i=0; i<SGP4_LANES; i++)
+		r[i]=sqrt(x[i]);
+
+	return r;
+}
+
+LANE_INLINE lane_t lane_fmod2p(lane_t x)
+{
+	/* FMod2p(), bit for bit */
+
+	lane_int_t i;
+	lane_t r;
+
+	i=__builtin_convertvector(x/twopi, lane_int_t);
+	r=x-__builtin_convertvector(i, lane_t)*twopi;
+
+	return lane_select(lane_negative(r+0.0), r+twopi, r);
+}
+
+LANE_INLINE void lane_sincos(lane_t x, lane_t *sinx, lane_t *cosx)
+{
+	/* sin(x) and cos(x).  x is reduced to r+tail within pi/4  */
+	/* of n*pi/2 with pi/2 in three parts, the first two of 33 */
+	/* bits, whose products with n are exact for |n| < 2^20;  */
+	/* beyond |x| = 1e5 lanes go through libm.                */
+
+	const double invpio2=6.36619772367581382433e-01,
+		pio2_1=1.57079632673412561417e+00, pio2_2=6.07710050630396597660e-11,
+		pio2_2t=2.02226624879595063154e-21,
+		S1=-1.66666666666666324348e-01, S2=8.33333333332248946124e-03,
+		S3=-1.98412698298579493134e-04, S4=2.75573137070700676789e-06,
+		S5=-2.50507602534068634195e-08, S6=1.58969099521155010221e-10,
+		C1=4.16666666666666019037e-02, C2=-1.38888888888741095749e-03,
+		C3=2.48015872894767294178e-05, C4=-2.75573143513906633035e-07,
+		C5=2.08757232129817482790e-09, C6=-1.13596475577881948265e-11;
+
+	const double toint=6755399441055744.0;  /* as in lane_rint() */
+
+	lane_t kn, n, r1, w, r, tail, z, zz, v, p, hz, sn, cs;
+	lane_mask_t k, odd, beyond;
+	int i;
+
+	/* n is lane_rint(x*invpio2), and the low bits of kn are n's */
+	kn=x*invpio2+toint;
+	n=kn-toint;
+	k=(lane_mask_t)kn;
+
+	/* Cody and Waite: r1 is exact, and r+tail is r1-n*pio2_2 */
+	/* exactly, less n times what's left of pi/2              */
+	r1=x-n*pio2_1;
+	w=n*pio2_2;
+	r=r1-w;
+	tail=((r1-r)-w)-n*pio2_2t;
+
+	/* fdlibm's __sin(r,tail) and __cos(r,tail) */
+	z=r*r;
+	zz=z*z;
+	p=S2+z*(S3+z*S4)+z*zz*(S5+z*S6);
+	v=z*r;
+	sn=r-((z*(0.5*tail-v*p)-tail)-v*S1);
+
+	p=z*(C1+z*(C2+z*C3))+zz*zz*(C4+z*(C5+z*C6));
+	hz=0.5*z;
+	w=1.0-hz;
+	cs=w+(((1.0-w)-hz)+(z*p-r*tail));
+
+	/* Quadrant n mod 4, the low two bits of k: sin, cos, -sin */
+	/* or -cos of r, swapped and negated by bit operations      */
+	odd=-(k&1);
+	*sinx=lane_select(odd, cs, sn);
+	*cosx=lane_select(odd, sn, cs);
+	*sinx=(lane_t)((lane_mask_t)*sinx^(-(k&2)&LANE_SIGN));
+	*cosx=(lane_t)((lane_mask_t)*cosx^(-((k+1)&2)&LANE_SIGN));
+
+	/* Negative in lanes beyond 1e5, or infinite or NaN, whose */
+	/* bit patterns are the greater as integers                */
+	beyond=(lane_mask_t)lane_splat(1e5)-(lane_mask_t)lane_abs(x);
+
+	if (lane_any_negative(beyond))
+		for (i=0; i<SGP4_LANES; i++)
+			if (beyond[i]<0)
+			{
+				(*sinx)[i]=sin(x[i]);
+				(*cosx)[i]=cos(x[i]);
+			}
+}
+
+LANE_INLINE lane_t lane_atan2(lane_t y, lane_t x)
+{
+	/* atan2(y,x), from -pi to pi.  atan(t) of t=|y/x| or |x/y|, */
+	/* whichever is at most 1, about atan(0), atan(1/2) or       */
+	/* atan(1), then reflected into the quadrant of (x,y).       */
+
+	const double atanhi0=4.63647609000806093515e-01, atanlo0=2.26987774529616870924e-17,
+		atanhi1=7.85398163397448278999e-01, atanlo1=3.06161699786838301793e-17,
+		pio2_hi=1.57079632679489655800e+00, pio2_lo=6.12323399573676603587e-17,
+		pi_hi=3.1415926535897931160e+00, pi_lo=1.2246467991473531772e-16,
+		aT0=3.33333333333329318027e-01, aT1=-1.99999999998764832476e-01,
+		aT2=1.42857142725034663711e-01, aT3=-1.11111104054623557880e-01,
+		aT4=9.09088713343650656196e-02, aT5=-7.69187620504482999495e-02,
+		aT6=6.66107313738753120669e-02, aT7=-5.83357013379057348645e-02,
+		aT8=4.97687799461593236017e-02, aT9=-3.65315727442169155270e-02,
+		aT10=1.62858201153657823623e-02;
+
+	const long long huge=0x7fefffffffffffffLL;  /* DBL_MAX */
+
+	lane_t ay, ax, t, hi, lo, z, w, s1, s2, r;
+	lane_mask_t swap, mid, high, odd;
+	int i;
+
+	ay=lane_abs(y);
+	ax=lane_abs(x);
+	swap=lane_negative(ax-ay);
+	t=lane_select(swap, ax, ay)/lane_select(swap, ay, ax);
+
+	/* About atan(1/2) from 7/16, about atan(1) from 11/16 */
+	high=~lane_negative(t-0.6875);
+	mid=~lane_negative(t-0.4375)&~high;
+	hi=lane_select(mid, lane_splat(atanhi0), lane_select(high, lane_splat(atanhi1), lane_splat(0.0)));
+	lo=lane_select(mid, lane_splat(atanlo0), lane_select(high, lane_splat(atanlo1), lane_splat(0.0)));
+	t=lane_select(mid, (2.0*t-1.0)/(2.0+t), lane_select(high, (t-1.0)/(t+1.0), t));
+
+	z=t*t;
+	w=z*z;
+	s1=z*(aT0+w*(aT2+w*(aT4+w*(aT6+w*(aT8+w*aT10)))));
+	s2=w*(aT1+w*(aT3+w*(aT5+w*(aT7+w*aT9))));
+	r=hi-((t*(s1+s2)-lo)-t);
+
+	r=lane_select(swap, (pio2_hi-r)+pio2_lo, r);
+	r=lane_select(lane_negative(x+0.0), pi_hi-(r-pi_lo), r);
+	r=(lane_t)((lane_mask_t)r^((lane_mask_t)y&LANE_SIGN));
+
+	/* Negative where both are zero, or either is infinite or */
+	/* NaN, by their bit patterns as integers                 */
+	odd=(((lane_mask_t)ax|(lane_mask_t)ay)-1)|(huge-(lane_mask_t)ax)|(huge-(lane_mask_t)ay);
+
+	if (lane_any_negative(odd))
+		for (i=0; i<SGP4_LANES; i++)
+			if (odd[i]<0)
+				r[i]=atan2(y[i],x[i]);
+
+	return r;
+}
+
+/* Single precision, over lanes of floats (lane32_t), twice as many as
+   lane_t has doubles in the same width, for the float32 kernels.
+   lane32_sincos() takes Cephes' sinf() and cosf() polynomials, of
+   degree 7 and 8, after a reduction by pi/2 in four parts, and
+   lane32_atan2() is lane_atan2() with fdlibm's atanf() polynomial.
+   Both are within two units in the last place of a float
+   (test_lanemath.c holds them to it).  Lanes beyond 1024 radians,
+   infinite or NaN, and atan2(0,0), go through libm. */
+
+#define SGP4_LANES32  (2*SGP4_LANES)
+
+typedef float lane32_t __attribute__ ((vector_size (SGP4_LANES32*sizeof(float))));
+typedef int lane32_mask_t __attribute__ ((vector_size (SGP4_LANES32*sizeof(float))));
+typedef unsigned lane32_bits_t __attribute__ ((vector_size (SGP4_LANES32*sizeof(float))));
+
+#define LANE32_SIGN  ((int)0x80000000U)
+
+LANE_INLINE lane32_t lane32_select(lane32_mask_t mask, lane32_t a, lane32_t b)
+{
+	return (lane32_t)(((lane32_mask_t)a&mask)|((lane32_mask_t)b&~mask));
+}
+
+LANE_INLINE int lane32_any(lane32_mask_t mask)
+{
+	int i;
+
+	for (i=0; i<SGP4_LANES32; i++)
+		if (mask[i])
+			return 1;
+
+	return 0;
+}
+
+LANE_INLINE lane32_mask_t lane32_negative(lane32_t x)
+{
+	/* As lane_negative() */
+
+	return -(lane32_mask_t)((lane32_bits_t)x>>31);
+}
+
+LANE_INLINE int lane32_any_negative(lane32_mask_t m)
+{
+	int any=0, i;
+
+	for (i=0; i<SGP4_LANES32; i++)
+		any|=m[i];
+
+	return any<0;
+}
+
+LANE_INLINE lane32_t lane32_splat(float x)
+{
+	return (lane32_t){0.0f}+x;
+}
+
+LANE_INLINE lane32_t lane32_abs(lane32_t x)
+{
+	return (lane32_t)((lane32_mask_t)x&0x7fffffff);
+}
+
+LANE_INLINE lane32_t lane32_sqrt(lane32_t x)
+{
+	lane32_t r;
+	int i;
+
+	for (i=0; i<SGP4_LANES32; i++)
+		r[i]=sqrtf(x[i]);
+
+	return r;
+}
+
+LANE_INLINE lane32_t lane32_fmod2p(lane32_t x)
+{
+	/* x-2 pi floor(x/2 pi), for |x| within range of an int */
+
+	lane32_t q, t;
+
+	q=x/(float)twopi;
+	t=__builtin_convertvector(__builtin_convertvector(q, lane32_mask_t), lane32_t);
+	t=lane32_select(lane32_negative(q-t), t-1, t);
+
+	return x-(float)twopi*t;
+}
+
+LANE_INLINE void lane32_sincos(lane32_t x, lane32_t *sinx, lane32_t *cosx)
+{
+	/* sinf(x) and cosf(x).  pi/2 is split into three parts of */
+	/* 11 bits, whose products with n are exact, and a fourth; */
+	/* beyond |x| = 1024 lanes go through libm.                */
+
+	const float invpio2=6.36619772e-01f, pio2_1=1.5703125f,
+		pio2_2=4.8375129699707031e-04f, pio2_3=7.5495336204767227e-08f,
+		pio2_4=2.5633440682570896e-12f,
+		S1=-1.6666654611e-1f, S2=8.3321608736e-3f, S3=-1.9515295891e-4f,
+		C1=4.166664568298827e-2f, C2=-1.388731625493765e-3f, C3=2.443315711809948e-5f;
+
+	const float toint=12582912.0f;  /* 1.5*2^23 */
+
+	lane32_t kn, n, r, z, sn, cs;
+	lane32_mask_t k, odd, beyond;
+	int i;
+
+	/* As in lane_sincos(), n's low bits are kn's */
+	kn=x*invpio2+toint;
+	n=kn-toint;
+	k=(lane32_mask_t)kn;
+
+	r=(((x-n*pio2_1)-n*pio2_2)-n*pio2_3)-n*pio2_4;
+	z=r*r;
+	sn=r+r*z*(S1+z*(S2+z*S3));
+	cs=(1.0f-0.5f*z)+z*z*(C1+z*(C2+z*C3));
+
+	odd=-(k&1);
+	*sinx=lane32_select(odd, cs, sn);
+	*cosx=lane32_select(odd, sn, cs);
+	*sinx=(lane32_t)((lane32_mask_t)*sinx^(-(k&2)&LANE32_SIGN));
+	*cosx=(lane32_t)((lane32_mask_t)*cosx^(-((k+1)&2)&LANE32_SIGN));
+
+	beyond=(lane32_mask_t)lane32_splat(1024.0f)-(lane32_mask_t)lane32_abs(x);
+
+	if (lane32_any_negative(beyond))
+		for (i=0; i<SGP4_LANES32; i++)
+			if (beyond[i]<0)
+			{
+				(*sinx)[i]=sinf(x[i]);
+				(*cosx)[i]=cosf(x[i]);
+			}
+}
+
+LANE_INLINE lane32_t lane32_atan2(lane32_t y, lane32_t x)
+{
+	/* atan2f(y,x), from -pi to pi, as lane_atan2() works out */
+	/* atan2(), with fdlibm's atanf() polynomial              */
+
+	const float atanhi0=4.6364760399e-01f, atanlo0=5.0121582440e-09f,
+		atanhi1=7.8539812565e-01f, atanlo1=3.7748947079e-08f,
+		pio2_hi=1.57079637e+00f, pio2_lo=-4.37113883e-08f,
+		pi_hi=3.14159274e+00f, pi_lo=-8.74227766e-08f,
+		aT0=3.3333328366e-01f, aT1=-1.9999158382e-01f, aT2=1.4253635705e-01f,
+		aT3=-1.0648017377e-01f, aT4=6.1687607318e-02f;
+
+	const int huge=0x7f7fffff;  /* FLT_MAX */
+
+	lane32_t ay, ax, t, hi, lo, z, w, s1, s2, r;
+	lane32_mask_t swap, mid, high, odd;
+	int i;
+
+	ay=lane32_abs(y);
+	ax=lane32_abs(x);
+	swap=lane32_negative(ax-ay);
+	t=lane32_select(swap, ax, ay)/lane32_select(swap, ay, ax);
+
+	high=~lane32_negative(t-0.6875f);
+	mid=~lane32_negative(t-0.4375f)&~high;
+	hi=lane32_select(mid, lane32_splat(atanhi0), lane32_select(high, lane32_splat(atanhi1), lane32_splat(0.0f)));
+	lo=lane32_select(mid, lane32_splat(atanlo0), lane32_select(high, lane32_splat(atanlo1), lane32_splat(0.0f)));
+	t=lane32_select(mid, (2.0f*t-1.0f)/(2.0f+t), lane32_select(high, (t-1.0f)/(t+1.0f), t));
+
+	z=t*t;
+	w=z*z;
+	s1=z*(aT0+w*(aT2+w*aT4));
+	s2=w*(aT1+w*aT3);
+	r=hi-((t*(s1+s2)-lo)-t);
+
+	r=lane32_select(swap, (pio2_hi-r)+pio2_lo, r);
+	r=lane32_select(lane32_negative(x+0.0f), pi_hi-(r-pi_lo), r);
+	r=(lane32_t)((lane32_mask_t)r^((lane32_mask_t)y&LANE32_SIGN));
+
+	odd=(((lane32_mask_t)ax|(lane32_mask_t)ay)-1)|(huge-(lane32_mask_t)ax)|(huge-(lane32_mask_t)ay);
+
+	if (lane32_any_negative(odd))
+		for (i=0; i<SGP4_LANES32; i++)
+			if (odd[i]<0)
+				r[i]=atan2f(y[i],x[i]);
+
+	return r;
+}
+
+#endif
@@ -111,68 +111,32 @@
 #define VISIBLE_FLAG           0x002000
 #define SAT_ECLIPSED_FLAG      0x004000
 
-/* Global structures that are a relic of the fact that this isn't supposed
- * to be a library. Should probably phase these out... somehow...
- */
-sat_struct sat;
-qth_struct qth;
-sat_db_struct sat_db;
-
-/* Global variables for sharing data among functions... */
-
-double	tsince, jul_epoch, jul_utc, eclipse_depth=0,
-	sat_azi, sat_ele, sat_range, sat_range_rate,
-	sat_lat, sat_lon, sat_alt, sat_vel, phase,
-	sun_azi, sun_ele, daynum, fm, fk, age, aostime,
-	lostime, ax, ay, az, rx, ry, rz, squint, alat, alon,
-	sun_ra, sun_dec, sun_lat, sun_lon, sun_range, sun_range_rate,
-	moon_az, moon_el, moon_dx, moon_ra, moon_dec, moon_gha, moon_dv;
-
-char	qthfile[50], tlefile[50], dbfile[50], temp[80], output[25],
-	serial_port[15], resave=0, reload_tle=0, netport[7],
-	once_per_second=0, ephem[5], sat_sun_status, findsun,
-	calc_squint, database=0, xterm, io_lat='N', io_lon='W';
-
-int	indx, antfd, iaz, iel, ma256, isplat, isplong, socket_flag=0,
-	Flags=0;
-
-long	rv, irk;
+/* Translation table for computing TLE checksums.  Everything else that
+   used to be shared among functions through globals now lives in a
+   context_t owned by the caller. */
 
 unsigned char val[256];
 
-/** Type definitions **/
-
-/* Two-line-element satellite orbital data
-   structure used directly by the SGP4/SDP4 code. */
-
-/* Global structure used by SGP4/SDP4 code. */
-
-geodetic_t obs_geodetic;
-
-/* Two-line Orbital Elements for the satellite used by SGP4/SDP4 code. */
-
-tle_t tle;
-
 /* Functions for testing and setting/clearing flags used in SGP4/SDP4 code */
 
-int isFlagSet(int flag)
+int isFlagSet(context_t *ctx, int flag)
 {
-	return (Flags&flag);
+	return (ctx->flags&flag);
 }
 
-int isFlagClear(int flag)
+int isFlagClear(context_t *ctx, int flag)
 {
-	return (~Flags&flag);
+	return (~ctx->flags&flag);
 }
 
-void SetFlag(int flag)
+void SetFlag(context_t *ctx, int flag)
 {
-	Flags|=flag;
+	ctx->flags|=flag;
 }
 
-void ClearFlag(int flag)
+void ClearFlag(context_t *ctx, int flag)
 {
-	Flags&=~flag;
+	ctx->flags&=~flag;
 }
 
 /* Remaining SGP4/SDP4 code follows... */
@@ -500,7 +464,7 @@ void Date_Time(double julian_date, struct tm *cdate)
 	time_t jtime;
 
 	jtime=(julian_date-2440587.5)*86400.0;
-	*cdate=*gmtime(&jtime);
+	gmtime_r(&jtime,cdate);
 }
 
 double Delta_ET(double year)
@@ -621,7 +585,7 @@ int Sat_Eclipsed(vector_t *pos, vector_t *sol, double *depth)
 		return 0;
 }
 
-void select_ephemeris(tle_t *tle)
+void select_ephemeris(context_t *ctx)
 {
 	/* Selects the apropriate ephemeris type to be used */
 	/* for predictions according to the data in the TLE */
@@ -629,6 +593,7 @@ void select_ephemeris(tle_t *tle)
 	/* they are apropriate for the sgp4/sdp4 routines   */
 
 	double ao, xnodp, dd1, dd2, delo, temp, a1, del1, r1;
+	tle_t *tle=&ctx->tle;
 
 	/* Preprocess tle set */
 	tle->xnodeo*=deg2rad;
@@ -656,24 +621,82 @@ void select_ephemeris(tle_t *tle)
 	/* Select a deep-space/near-earth ephemeris */
 
 	if (twopi/xnodp/xmnpda>=0.15625)
-		SetFlag(DEEP_SPACE_EPHEM_FLAG);
+		SetFlag(ctx, DEEP_SPACE_EPHEM_FLAG);
 	else
-		ClearFlag(DEEP_SPACE_EPHEM_FLAG);
+		ClearFlag(ctx, DEEP_SPACE_EPHEM_FLAG);
+}
+
+static int KeplerSteps(double error, double e)
+{
+	/* Newton iterations Kepler's equation takes, started error */
+	/* radians from its solution, before a correction is within */
+	/* e6a: each squares the error, times up to e/(2(1-e)).     */
+
+	int n=0;
+
+	while (error>e6a && n<10)
+	{
+		error*=error*e/(2*(1-e));
+		n++;
+	}
+
+	return n;
+}
+
+static double KeplerStart(context_t *ctx, double tsince, double capu, double xnodp, double e)
+{
+	/* Where SGP4() and SDP4() start the Newton iteration for    */
+	/* Kepler's equation: capu, or with INCREMENTAL_FLAG set and */
+	/* the last solution near enough in time, the eccentric      */
+	/* anomaly that solution predicts to first order, as long as */
+	/* that saves an iteration.  capu is up to e radians out,    */
+	/* the prediction up to e dm^2/(2(1-e)^3) for a step of dm   */
+	/* in mean anomaly, so it seldom does for near-circular      */
+	/* orbits but at the shortest steps.                         */
+
+	kepler_t *k=&ctx->kepler;
+	double dm;
+
+	if (isFlagClear(ctx, INCREMENTAL_FLAG) || fabs((tsince-k->tsince)*xnodp)>=KEPLER_WARM_START)
+		return capu;
+
+	dm=capu-k->capu;
+
+	if (dm>pi)
+		dm-=twopi;
+	else if (dm<-pi)
+		dm+=twopi;
+
+	if (KeplerSteps(0.5*e*dm*dm/((1-e)*(1-e)*(1-e)), e)>=KeplerSteps(e, e))
+		return capu;
+
+	return capu+k->offset+k->slope*dm;
+}
+
+static void KeplerKeep(context_t *ctx, double tsince, double capu, double epw, double ecose)
+{
+	/* Keeps the solution of Kepler's equation for KeplerStart() */
+
+	kepler_t *k=&ctx->kepler;
+
+	if (isFlagClear(ctx, INCREMENTAL_FLAG))
+		return;
+
+	k->tsince=tsince;
+	k->capu=capu;
+	k->offset=epw-capu;
+	k->slope=ecose/(1-ecose);
 }
 
-void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
+void SGP4(context_t *ctx, double tsince, vector_t *pos, vector_t *vel)
 {
 	/* This function is used to calculate the position and velocity */
 	/* of near-earth (period < 225 minutes) satellites. tsince is   */
-	/* time since epoch in minutes, tle is a pointer to a tle_t     */
-	/* structure with Keplerian orbital elements and pos and vel    */
+	/* time since epoch in minutes, ctx holds the tle_t structure   */
+	/* with Keplerian orbital elements and pos and vel              */
 	/* are vector_t structures returning ECI satellite position and */ 
 	/* velocity. Use Convert_Sat_State() to convert to km and km/s. */
 
-	static double aodp, aycof, c1, c4, c5, cosio, d2, d3, d4, delmo,
-	omgcof, eta, omgdot, sinio, xnodp, sinmo, t2cof, t3cof, t4cof,
-	t5cof, x1mth2, x3thm1, x7thm1, xmcof, xmdot, xnodcf, xnodot, xlcof;
-
 	double cosuk, sinuk, rfdotk, vx, vy, vz, ux, uy, uz, xmy, xmx, cosnok,
 	sinnok, cosik, sinik, rdotk, xinck, xnodek, uk, rk, cos2u, sin2u,
 	u, sinu, cosu, betal, rfdot, rdot, r, pl, elsq, esine, ecose, epw,
@@ -686,28 +709,31 @@ void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 
 	int i;
 
+	tle_t *tle=&ctx->tle;
+	sgp4_t *sgp4=&ctx->sgp4;
+
 	/* Initialization */
 
-	if (isFlagClear(SGP4_INITIALIZED_FLAG))
+	if (isFlagClear(ctx, SGP4_INITIALIZED_FLAG))
 	{
-		SetFlag(SGP4_INITIALIZED_FLAG);
+		SetFlag(ctx, SGP4_INITIALIZED_FLAG);
 
 		/* Recover original mean motion (xnodp) and   */
 		/* semimajor axis (aodp) from input elements. */
 
 		a1=pow(xke/tle->xno,tothrd);
-		cosio=cos(tle->xincl);
-		theta2=cosio*cosio;
-		x3thm1=3*theta2-1.0;
+		sgp4->cosio=cos(tle->xincl);
+		theta2=sgp4->cosio*sgp4->cosio;
+		sgp4->x3thm1=3*theta2-1.0;
 		eosq=tle->eo*tle->eo;
 		betao2=1.0-eosq;
 		betao=sqrt(betao2);
-		del1=1.5*ck2*x3thm1/(a1*a1*betao*betao2);
+		del1=1.5*ck2*sgp4->x3thm1/(a1*a1*betao*betao2);
 		ao=a1*(1.0-del1*(0.5*tothrd+del1*(1.0+134.0/81.0*del1)));
-		delo=1.5*ck2*x3thm1/(ao*ao*betao*betao2);
-		xnodp=tle->xno/(1.0+delo);
-		aodp=ao/(1.0-delo);
-        sat.aodp = aodp*xkmper; // Get semi major axis in km
+		delo=1.5*ck2*sgp4->x3thm1/(ao*ao*betao*betao2);
+		sgp4->xnodp=tle->xno/(1.0+delo);
+		sgp4->aodp=ao/(1.0-delo);
+        ctx->sat.aodp = sgp4->aodp*xkmper; // Get semi major axis in km
 
 		/* For perigee less than 220 kilometers, the "simple"     */
 		/* flag is set and the equations are truncated to linear  */
@@ -715,20 +741,20 @@ void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 		/* anomaly.  Also, the c3 term, the delta omega term, and */
 		/* the delta m term are dropped.                          */
 
-		if ((aodp*(1-tle->eo)/ae)<(220/xkmper+ae))
-		    SetFlag(SIMPLE_FLAG);
+		if ((sgp4->aodp*(1-tle->eo)/ae)<(220/xkmper+ae))
+		    SetFlag(ctx, SIMPLE_FLAG);
 
 		else
-		    ClearFlag(SIMPLE_FLAG);
+		    ClearFlag(ctx, SIMPLE_FLAG);
 
 		/* For perigees below 156 km, the      */
 		/* values of s and qoms2t are altered. */
 
 		s4=s;
 		qoms24=qoms2t;
-		perigee=(aodp*(1-tle->eo)-ae)*xkmper;
-        sat.perigee = perigee;
-        sat.apogee = (aodp*(1+tle->eo)-ae)*xkmper;
+		perigee=(sgp4->aodp*(1-tle->eo)-ae)*xkmper;
+        ctx->sat.perigee = perigee;
+        ctx->sat.apogee = (sgp4->aodp*(1+tle->eo)-ae)*xkmper;
 
 		if (perigee<156.0)
 		{
@@ -741,99 +767,99 @@ void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 			s4=s4/xkmper+ae;
 		}
 
-		pinvsq=1/(aodp*aodp*betao2*betao2);
-		tsi=1/(aodp-s4);
-		eta=aodp*tle->eo*tsi;
-		etasq=eta*eta;
-		eeta=tle->eo*eta;
+		pinvsq=1/(sgp4->aodp*sgp4->aodp*betao2*betao2);
+		tsi=1/(sgp4->aodp-s4);
+		sgp4->eta=sgp4->aodp*tle->eo*tsi;
+		etasq=sgp4->eta*sgp4->eta;
+		eeta=tle->eo*sgp4->eta;
 		psisq=fabs(1-etasq);
 		coef=qoms24*pow(tsi,4);
 		coef1=coef/pow(psisq,3.5);
-		c2=coef1*xnodp*(aodp*(1+1.5*etasq+eeta*(4+etasq))+0.75*ck2*tsi/psisq*x3thm1*(8+3*etasq*(8+etasq)));
-		c1=tle->bstar*c2;
-		sinio=sin(tle->xincl);
+		c2=coef1*sgp4->xnodp*(sgp4->aodp*(1+1.5*etasq+eeta*(4+etasq))+0.75*ck2*tsi/psisq*sgp4->x3thm1*(8+3*etasq*(8+etasq)));
+		sgp4->c1=tle->bstar*c2;
+		sgp4->sinio=sin(tle->xincl);
 		a3ovk2=-xj3/ck2*pow(ae,3);
-		c3=coef*tsi*a3ovk2*xnodp*ae*sinio/tle->eo;
-		x1mth2=1-theta2;
+		c3=coef*tsi*a3ovk2*sgp4->xnodp*ae*sgp4->sinio/tle->eo;
+		sgp4->x1mth2=1-theta2;
 
-		c4=2*xnodp*coef1*aodp*betao2*(eta*(2+0.5*etasq)+tle->eo*(0.5+2*etasq)-2*ck2*tsi/(aodp*psisq)*(-3*x3thm1*(1-2*eeta+etasq*(1.5-0.5*eeta))+0.75*x1mth2*(2*etasq-eeta*(1+etasq))*cos(2*tle->omegao)));
-		c5=2*coef1*aodp*betao2*(1+2.75*(etasq+eeta)+eeta*etasq);
+		sgp4->c4=2*sgp4->xnodp*coef1*sgp4->aodp*betao2*(sgp4->eta*(2+0.5*etasq)+tle->eo*(0.5+2*etasq)-2*ck2*tsi/(sgp4->aodp*psisq)*(-3*sgp4->x3thm1*(1-2*eeta+etasq*(1.5-0.5*eeta))+0.75*sgp4->x1mth2*(2*etasq-eeta*(1+etasq))*cos(2*tle->omegao)));
+		sgp4->c5=2*coef1*sgp4->aodp*betao2*(1+2.75*(etasq+eeta)+eeta*etasq);
 
 		theta4=theta2*theta2;
-		temp1=3*ck2*pinvsq*xnodp;
+		temp1=3*ck2*pinvsq*sgp4->xnodp;
 		temp2=temp1*ck2*pinvsq;
-		temp3=1.25*ck4*pinvsq*pinvsq*xnodp;
-		xmdot=xnodp+0.5*temp1*betao*x3thm1+0.0625*temp2*betao*(13-78*theta2+137*theta4);
+		temp3=1.25*ck4*pinvsq*pinvsq*sgp4->xnodp;
+		sgp4->xmdot=sgp4->xnodp+0.5*temp1*betao*sgp4->x3thm1+0.0625*temp2*betao*(13-78*theta2+137*theta4);
 		x1m5th=1-5*theta2;
-		omgdot=-0.5*temp1*x1m5th+0.0625*temp2*(7-114*theta2+395*theta4)+temp3*(3-36*theta2+49*theta4);
-		xhdot1=-temp1*cosio;
-		xnodot=xhdot1+(0.5*temp2*(4-19*theta2)+2*temp3*(3-7*theta2))*cosio;
-		omgcof=tle->bstar*c3*cos(tle->omegao);
-		xmcof=-tothrd*coef*tle->bstar*ae/eeta;
-		xnodcf=3.5*betao2*xhdot1*c1;
-		t2cof=1.5*c1;
-		xlcof=0.125*a3ovk2*sinio*(3+5*cosio)/(1+cosio);
-		aycof=0.25*a3ovk2*sinio;
-		delmo=pow(1+eta*cos(tle->xmo),3);
-		sinmo=sin(tle->xmo);
-		x7thm1=7*theta2-1;
-
-		if (isFlagClear(SIMPLE_FLAG))
+		sgp4->omgdot=-0.5*temp1*x1m5th+0.0625*temp2*(7-114*theta2+395*theta4)+temp3*(3-36*theta2+49*theta4);
+		xhdot1=-temp1*sgp4->cosio;
+		sgp4->xnodot=xhdot1+(0.5*temp2*(4-19*theta2)+2*temp3*(3-7*theta2))*sgp4->cosio;
+		sgp4->omgcof=tle->bstar*c3*cos(tle->omegao);
+		sgp4->xmcof=-tothrd*coef*tle->bstar*ae/eeta;
+		sgp4->xnodcf=3.5*betao2*xhdot1*sgp4->c1;
+		sgp4->t2cof=1.5*sgp4->c1;
+		sgp4->xlcof=0.125*a3ovk2*sgp4->sinio*(3+5*sgp4->cosio)/(1+sgp4->cosio);
+		sgp4->aycof=0.25*a3ovk2*sgp4->sinio;
+		sgp4->delmo=pow(1+sgp4->eta*cos(tle->xmo),3);
+		sgp4->sinmo=sin(tle->xmo);
+		sgp4->x7thm1=7*theta2-1;
+
+		if (isFlagClear(ctx, SIMPLE_FLAG))
 		{
-			c1sq=c1*c1;
-			d2=4*aodp*tsi*c1sq;
-			temp=d2*tsi*c1/3;
-			d3=(17*aodp+s4)*temp;
-			d4=0.5*temp*aodp*tsi*(221*aodp+31*s4)*c1;
-			t3cof=d2+2*c1sq;
-			t4cof=0.25*(3*d3+c1*(12*d2+10*c1sq));
-			t5cof=0.2*(3*d4+12*c1*d3+6*d2*d2+15*c1sq*(2*d2+c1sq));
+			c1sq=sgp4->c1*sgp4->c1;
+			sgp4->d2=4*sgp4->aodp*tsi*c1sq;
+			temp=sgp4->d2*tsi*sgp4->c1/3;
+			sgp4->d3=(17*sgp4->aodp+s4)*temp;
+			sgp4->d4=0.5*temp*sgp4->aodp*tsi*(221*sgp4->aodp+31*s4)*sgp4->c1;
+			sgp4->t3cof=sgp4->d2+2*c1sq;
+			sgp4->t4cof=0.25*(3*sgp4->d3+sgp4->c1*(12*sgp4->d2+10*c1sq));
+			sgp4->t5cof=0.2*(3*sgp4->d4+12*sgp4->c1*sgp4->d3+6*sgp4->d2*sgp4->d2+15*c1sq*(2*sgp4->d2+c1sq));
 		}
 	}
 
 	/* Update for secular gravity and atmospheric drag. */
-	xmdf=tle->xmo+xmdot*tsince;
-	omgadf=tle->omegao+omgdot*tsince;
-	xnoddf=tle->xnodeo+xnodot*tsince;
+	xmdf=tle->xmo+sgp4->xmdot*tsince;
+	omgadf=tle->omegao+sgp4->omgdot*tsince;
+	xnoddf=tle->xnodeo+sgp4->xnodot*tsince;
 	omega=omgadf;
 	xmp=xmdf;
 	tsq=tsince*tsince;
-	xnode=xnoddf+xnodcf*tsq;
-	tempa=1-c1*tsince;
-	tempe=tle->bstar*c4*tsince;
-	templ=t2cof*tsq;
+	xnode=xnoddf+sgp4->xnodcf*tsq;
+	tempa=1-sgp4->c1*tsince;
+	tempe=tle->bstar*sgp4->c4*tsince;
+	templ=sgp4->t2cof*tsq;
     
-	if (isFlagClear(SIMPLE_FLAG))
+	if (isFlagClear(ctx, SIMPLE_FLAG))
 	{
-		delomg=omgcof*tsince;
-		delm=xmcof*(pow(1+eta*cos(xmdf),3)-delmo);
+		delomg=sgp4->omgcof*tsince;
+		delm=sgp4->xmcof*(pow(1+sgp4->eta*cos(xmdf),3)-sgp4->delmo);
 		temp=delomg+delm;
 		xmp=xmdf+temp;
 		omega=omgadf-temp;
 		tcube=tsq*tsince;
 		tfour=tsince*tcube;
-		tempa=tempa-d2*tsq-d3*tcube-d4*tfour;
-		tempe=tempe+tle->bstar*c5*(sin(xmp)-sinmo);
-		templ=templ+t3cof*tcube+tfour*(t4cof+tsince*t5cof);
+		tempa=tempa-sgp4->d2*tsq-sgp4->d3*tcube-sgp4->d4*tfour;
+		tempe=tempe+tle->bstar*sgp4->c5*(sin(xmp)-sgp4->sinmo);
+		templ=templ+sgp4->t3cof*tcube+tfour*(sgp4->t4cof+tsince*sgp4->t5cof);
 	}
 
-	a=aodp*pow(tempa,2);
+	a=sgp4->aodp*pow(tempa,2);
 	e=tle->eo-tempe;
-	xl=xmp+omega+xnode+xnodp*templ;
+	xl=xmp+omega+xnode+sgp4->xnodp*templ;
 	beta=sqrt(1-e*e);
 	xn=xke/pow(a,1.5);
 
 	/* Long period periodics */
 	axn=e*cos(omega);
 	temp=1/(a*beta*beta);
-	xll=temp*xlcof*axn;
-	aynl=temp*aycof;
+	xll=temp*sgp4->xlcof*axn;
+	aynl=temp*sgp4->aycof;
 	xlt=xl+xll;
 	ayn=e*sin(omega)+aynl;
 
 	/* Solve Kepler's Equation */
 	capu=FMod2p(xlt-xnode);
-	temp2=capu;
+	temp2=KeplerStart(ctx,tsince,capu,sgp4->xnodp,e);
 	i=0;
 
 	do
@@ -855,6 +881,7 @@ void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 
 	/* Short period preliminary quantities */
 	ecose=temp5+temp6;
+	KeplerKeep(ctx,tsince,capu,epw,ecose);
 	esine=temp3-temp4;
 	elsq=axn*axn+ayn*ayn;
 	temp=1-elsq;
@@ -876,12 +903,12 @@ void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 	temp2=temp1*temp;
 
 	/* Update for short periodics */
-	rk=r*(1-1.5*temp2*betal*x3thm1)+0.5*temp1*x1mth2*cos2u;
-	uk=u-0.25*temp2*x7thm1*sin2u;
-	xnodek=xnode+1.5*temp2*cosio*sin2u;
-	xinck=tle->xincl+1.5*temp2*cosio*sinio*cos2u;
-	rdotk=rdot-xn*temp1*x1mth2*sin2u;
-	rfdotk=rfdot+xn*temp1*(x1mth2*cos2u+1.5*x3thm1);
+	rk=r*(1-1.5*temp2*betal*sgp4->x3thm1)+0.5*temp1*sgp4->x1mth2*cos2u;
+	uk=u-0.25*temp2*sgp4->x7thm1*sin2u;
+	xnodek=xnode+1.5*temp2*sgp4->cosio*sin2u;
+	xinck=tle->xincl+1.5*temp2*sgp4->cosio*sgp4->sinio*cos2u;
+	rdotk=rdot-xn*temp1*sgp4->x1mth2*sin2u;
+	rfdotk=rfdot+xn*temp1*(sgp4->x1mth2*cos2u+1.5*sgp4->x3thm1);
 
 	/* Orientation vectors */
 	sinuk=sin(uk);
@@ -916,27 +943,104 @@ void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
     sat.z_vel = vel->z;
     */
 	/* Phase in radians */
-	phase=xlt-xnode-omgadf+twopi;
+	ctx->phase=xlt-xnode-omgadf+twopi;
     
-	if (phase<0.0)
-		phase+=twopi;
+	if (ctx->phase<0.0)
+		ctx->phase+=twopi;
 
-	phase=FMod2p(phase);
+	ctx->phase=FMod2p(ctx->phase);
 }
 
-void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
+static deep_checkpoint_block_t *CheckpointBlock(deep_checkpoints_t *kept, int before, int block, int make)
+{
+	/* The block of checkpoints after or before epoch, allocating */
+	/* it if make is set and no thread has yet.  NULL if there is */
+	/* none, or no memory for one.                                */
+
+	deep_checkpoint_block_t *b, *fresh;
+
+	b=__atomic_load_n(&kept->block[before][block], __ATOMIC_ACQUIRE);
+
+	if (b==NULL && make && (fresh=calloc(1, sizeof(deep_checkpoint_block_t)))!=NULL)
+	{
+		if (__atomic_compare_exchange_n(&kept->block[before][block], &b, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			b=fresh;
+		else
+			free(fresh);
+	}
+
+	return b;
+}
+
+static void ResumeDeep(context_t *ctx, double t)
+{
+	/* Moves the resonance integrator, at epoch, on to the kept   */
+	/* checkpoint furthest out towards t that doesn't go past it. */
+
+	deep_t *dp=&ctx->sdp4.deep;
+	const deep_checkpoint_block_t *b;
+	long n;
+	int slot;
+
+	if (dp->kept==NULL)
+		return;
+
+	/* Checkpoint n (from 1) is at n*DEEP_CHECKPOINT_STEPS steps */
+	n=(long)(fabs(t)/(dp->stepp*DEEP_CHECKPOINT_STEPS));
+
+	if (n>DEEP_CHECKPOINT_BLOCKS*DEEP_CHECKPOINT_BLOCK)
+		n=DEEP_CHECKPOINT_BLOCKS*DEEP_CHECKPOINT_BLOCK;
+
+	for (; n>0; n--)
+	{
+		b=CheckpointBlock(dp->kept, t<0, (n-1)/DEEP_CHECKPOINT_BLOCK, 0);
+		slot=(n-1)%DEEP_CHECKPOINT_BLOCK;
+
+		/* Skip a block not yet reached as a whole */
+		if (b==NULL)
+			n-=slot;
+
+		else if (__atomic_load_n(&b->kept[slot], __ATOMIC_ACQUIRE)==2)
+		{
+			dp->atime=b->checkpoint[slot].atime;
+			dp->xli=b->checkpoint[slot].xli;
+			dp->xni=b->checkpoint[slot].xni;
+			ClearFlag(ctx, EPOCH_RESTART_FLAG);
+			return;
+		}
+	}
+}
+
+static void KeepCheckpoint(deep_t *dp)
+{
+	/* Keeps the state of the resonance integrator, having come */
+	/* straight out from epoch, in its slot unless it has been. */
+	/* Each slot is claimed by one writer and published once.   */
+
+	deep_checkpoint_block_t *b;
+	long n=(long)(fabs(dp->atime)/(dp->stepp*DEEP_CHECKPOINT_STEPS)+0.5);
+	int slot, empty=0;
+
+	if (dp->kept==NULL || n<1 || n>DEEP_CHECKPOINT_BLOCKS*DEEP_CHECKPOINT_BLOCK)
+		return;
+
+	b=CheckpointBlock(dp->kept, dp->atime<0, (n-1)/DEEP_CHECKPOINT_BLOCK, 1);
+	slot=(n-1)%DEEP_CHECKPOINT_BLOCK;
+
+	if (b==NULL || !__atomic_compare_exchange_n(&b->kept[slot], &empty, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	b->checkpoint[slot].atime=dp->atime;
+	b->checkpoint[slot].xli=dp->xli;
+	b->checkpoint[slot].xni=dp->xni;
+	__atomic_store_n(&b->kept[slot], 2, __ATOMIC_RELEASE);
+}
+
+void Deep(context_t *ctx, int ientry, deep_arg_t *deep_arg)
 {
 	/* This function is used by SDP4 to add lunar and solar */
 	/* perturbation effects to deep-space orbit objects.    */
 
-	static double thgr, xnq, xqncl, omegaq, zmol, zmos, savtsn, ee2, e3,
-	xi2, xl2, xl3, xl4, xgh2, xgh3, xgh4, xh2, xh3, sse, ssi, ssg, xi3,
-	se2, si2, sl2, sgh2, sh2, se3, si3, sl3, sgh3, sh3, sl4, sgh4, ssl,
-	ssh, d3210, d3222, d4410, d4422, d5220, d5232, d5421, d5433, del1,
-	del2, del3, fasx2, fasx4, fasx6, xlamo, xfact, xni, atime, stepp,
-	stepn, step2, preep, pl, sghs, xli, d2201, d2211, sghl, sh1, pinc,
-	pe, shs, zsingl, zcosgl, zsinhl, zcoshl, zsinil, zcosil;
-
 	double a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, ainv2, alfdp, aqnv,
 	sgh, sini2, sinis, sinok, sh, si, sil, day, betdp, dalf, bfact, c,
 	cc, cosis, cosok, cosq, ctem, f322, zx, zy, dbet, dls, eoc, eq, f2,
@@ -949,48 +1053,52 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 	z21, z22, z23, z3, z31, z32, z33, ze, zf, zm, zn, zsing, zsinh,
 	zsini, zcosg, zcosh, zcosi, delt=0, ft=0;
 
+	int outward=0;
+	tle_t *tle=&ctx->tle;
+	deep_t *dp=&ctx->sdp4.deep;
+
 	switch (ientry)
 	{
 		case dpinit:  /* Entrance for deep space initialization */
-		thgr=ThetaG(tle->epoch,deep_arg);
+		dp->thgr=ThetaG(tle->epoch,deep_arg);
 		eq=tle->eo;
-		xnq=deep_arg->xnodp;
+		dp->xnq=deep_arg->xnodp;
 		aqnv=1/deep_arg->aodp;
-		xqncl=tle->xincl;
+		dp->xqncl=tle->xincl;
 		xmao=tle->xmo;
 		xpidot=deep_arg->omgdot+deep_arg->xnodot;
 		sinq=sin(tle->xnodeo);
 		cosq=cos(tle->xnodeo);
-		omegaq=tle->omegao;
+		dp->omegaq=tle->omegao;
 
 		/* Initialize lunar solar terms */
 		day=deep_arg->ds50+18261.5;  /* Days since 1900 Jan 0.5 */
 	  
-		if (day!=preep)
+		if (day!=dp->preep)
 		{
-			preep=day;
+			dp->preep=day;
 			xnodce=4.5236020-9.2422029E-4*day;
 			stem=sin(xnodce);
 			ctem=cos(xnodce);
-			zcosil=0.91375164-0.03568096*ctem;
-			zsinil=sqrt(1-zcosil*zcosil);
-			zsinhl=0.089683511*stem/zsinil;
-			zcoshl=sqrt(1-zsinhl*zsinhl);
+			dp->zcosil=0.91375164-0.03568096*ctem;
+			dp->zsinil=sqrt(1-dp->zcosil*dp->zcosil);
+			dp->zsinhl=0.089683511*stem/dp->zsinil;
+			dp->zcoshl=sqrt(1-dp->zsinhl*dp->zsinhl);
 			c=4.7199672+0.22997150*day;
 			gam=5.8351514+0.0019443680*day;
-			zmol=FMod2p(c-gam);
-			zx=0.39785416*stem/zsinil;
-			zy=zcoshl*ctem+0.91744867*zsinhl*stem;
+			dp->zmol=FMod2p(c-gam);
+			zx=0.39785416*stem/dp->zsinil;
+			zy=dp->zcoshl*ctem+0.91744867*dp->zsinhl*stem;
 			zx=AcTan(zx,zy);
 			zx=gam+zx-xnodce;
-			zcosgl=cos(zx);
-			zsingl=sin(zx);
-			zmos=6.2565837+0.017201977*day;
-			zmos=FMod2p(zmos);
+			dp->zcosgl=cos(zx);
+			dp->zsingl=sin(zx);
+			dp->zmos=6.2565837+0.017201977*day;
+			dp->zmos=FMod2p(dp->zmos);
 		    }
 
 		  /* Do solar terms */
-		  savtsn=1E20;
+		  dp->savtsn=1E20;
 		  zcosg=zcosgs;
 		  zsing=zsings;
 		  zcosi=zcosis;
@@ -1000,7 +1108,7 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 		  cc=c1ss;
 		  zn=zns;
 		  ze=zes;
-		  xnoi=1/xnq;
+		  xnoi=1/dp->xnq;
 
 		  /* Loop breaks when Solar terms are done a second */
 		  /* time, after Lunar terms are initialized        */
@@ -1054,74 +1162,74 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 			sgh=s4*zn*(z31+z33-6);
 			sh=-zn*s2*(z21+z23);
 		
-			if (xqncl<5.2359877E-2)
+			if (dp->xqncl<5.2359877E-2)
 				sh=0;
 		    
-			ee2=2*s1*s6;
-			e3=2*s1*s7;
-			xi2=2*s2*z12;
-			xi3=2*s2*(z13-z11);
-			xl2=-2*s3*z2;
-			xl3=-2*s3*(z3-z1);
-			xl4=-2*s3*(-21-9*deep_arg->eosq)*ze;
-			xgh2=2*s4*z32;
-			xgh3=2*s4*(z33-z31);
-			xgh4=-18*s4*ze;
-			xh2=-2*s2*z22;
-			xh3=-2*s2*(z23-z21);
-
-			if (isFlagSet(LUNAR_TERMS_DONE_FLAG))
+			dp->ee2=2*s1*s6;
+			dp->e3=2*s1*s7;
+			dp->xi2=2*s2*z12;
+			dp->xi3=2*s2*(z13-z11);
+			dp->xl2=-2*s3*z2;
+			dp->xl3=-2*s3*(z3-z1);
+			dp->xl4=-2*s3*(-21-9*deep_arg->eosq)*ze;
+			dp->xgh2=2*s4*z32;
+			dp->xgh3=2*s4*(z33-z31);
+			dp->xgh4=-18*s4*ze;
+			dp->xh2=-2*s2*z22;
+			dp->xh3=-2*s2*(z23-z21);
+
+			if (isFlagSet(ctx, LUNAR_TERMS_DONE_FLAG))
 				break;
 
 			/* Do lunar terms */
-			sse=se;
-			ssi=si;
-			ssl=sl;
-			ssh=sh/deep_arg->sinio;
-			ssg=sgh-deep_arg->cosio*ssh;
-			se2=ee2;
-			si2=xi2;
-			sl2=xl2;
-			sgh2=xgh2;
-			sh2=xh2;
-			se3=e3;
-			si3=xi3;
-			sl3=xl3;
-			sgh3=xgh3;
-			sh3=xh3;
-			sl4=xl4;
-			sgh4=xgh4;
-			zcosg=zcosgl;
-			zsing=zsingl;
-			zcosi=zcosil;
-			zsini=zsinil;
-			zcosh=zcoshl*cosq+zsinhl*sinq;
-			zsinh=sinq*zcoshl-cosq*zsinhl;
+			dp->sse=se;
+			dp->ssi=si;
+			dp->ssl=sl;
+			dp->ssh=sh/deep_arg->sinio;
+			dp->ssg=sgh-deep_arg->cosio*dp->ssh;
+			dp->se2=dp->ee2;
+			dp->si2=dp->xi2;
+			dp->sl2=dp->xl2;
+			dp->sgh2=dp->xgh2;
+			dp->sh2=dp->xh2;
+			dp->se3=dp->e3;
+			dp->si3=dp->xi3;
+			dp->sl3=dp->xl3;
+			dp->sgh3=dp->xgh3;
+			dp->sh3=dp->xh3;
+			dp->sl4=dp->xl4;
+			dp->sgh4=dp->xgh4;
+			zcosg=dp->zcosgl;
+			zsing=dp->zsingl;
+			zcosi=dp->zcosil;
+			zsini=dp->zsinil;
+			zcosh=dp->zcoshl*cosq+dp->zsinhl*sinq;
+			zsinh=sinq*dp->zcoshl-cosq*dp->zsinhl;
 			zn=znl;
 			cc=c1l;
 			ze=zel;
-			SetFlag(LUNAR_TERMS_DONE_FLAG);
+			SetFlag(ctx, LUNAR_TERMS_DONE_FLAG);
 		}
 
-		sse=sse+se;
-		ssi=ssi+si;
-		ssl=ssl+sl;
-		ssg=ssg+sgh-deep_arg->cosio/deep_arg->sinio*sh;
-		ssh=ssh+sh/deep_arg->sinio;
+		dp->sse=dp->sse+se;
+		dp->ssi=dp->ssi+si;
+		dp->ssl=dp->ssl+sl;
+		dp->ssg=dp->ssg+sgh-deep_arg->cosio/deep_arg->sinio*sh;
+		dp->ssh=dp->ssh+sh/deep_arg->sinio;
 
 		/* Geopotential resonance initialization for 12 hour orbits */
-		ClearFlag(RESONANCE_FLAG);
-		ClearFlag(SYNCHRONOUS_FLAG);
+		ClearFlag(ctx, RESONANCE_FLAG);
+		ClearFlag(ctx, SYNCHRONOUS_FLAG);
 
-		if (!((xnq<0.0052359877) && (xnq>0.0034906585)))
+		if (!((dp->xnq<0.0052359877) && (dp->xnq>0.0034906585)))
 		{
-			if ((xnq<0.00826) || (xnq>0.00924))
+			if ((dp->xnq<0.00826) || (dp->xnq>0.00924))
 			    return;
 	
 			if (eq<0.5)
 			    return;
 	
-			SetFlag(RESONANCE_FLAG);
+			SetFlag(ctx, RESONANCE_FLAG);
 			eoc=eq*deep_arg->eosq;
 			g201=-0.306-(eq-0.64)*0.440;
 		
@@ -1175,36 +1283,36 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 			f523=deep_arg->sinio*(4.92187512*sini2*(-2-4*deep_arg->cosio+10*deep_arg->theta2)+6.56250012*(1+2*deep_arg->cosio-3*deep_arg->theta2));
 			f542=29.53125*deep_arg->sinio*(2-8*deep_arg->cosio+deep_arg->theta2*(-12+8*deep_arg->cosio+10*deep_arg->theta2));
 			f543=29.53125*deep_arg->sinio*(-2-8*deep_arg->cosio+deep_arg->theta2*(12+8*deep_arg->cosio-10*deep_arg->theta2));
-			xno2=xnq*xnq;
+			xno2=dp->xnq*dp->xnq;
 			ainv2=aqnv*aqnv;
 			temp1=3*xno2*ainv2;
 			temp=temp1*root22;
-			d2201=temp*f220*g201;
-			d2211=temp*f221*g211;
+			dp->d2201=temp*f220*g201;
+			dp->d2211=temp*f221*g211;
 			temp1=temp1*aqnv;
 			temp=temp1*root32;
-			d3210=temp*f321*g310;
-			d3222=temp*f322*g322;
+			dp->d3210=temp*f321*g310;
+			dp->d3222=temp*f322*g322;
 			temp1=temp1*aqnv;
 			temp=2*temp1*root44;
-			d4410=temp*f441*g410;
-			d4422=temp*f442*g422;
+			dp->d4410=temp*f441*g410;
+			dp->d4422=temp*f442*g422;
 			temp1=temp1*aqnv;
 			temp=temp1*root52;
-			d5220=temp*f522*g520;
-			d5232=temp*f523*g532;
+			dp->d5220=temp*f522*g520;
+			dp->d5232=temp*f523*g532;
 			temp=2*temp1*root54;
-			d5421=temp*f542*g521;
-			d5433=temp*f543*g533;
-			xlamo=xmao+tle->xnodeo+tle->xnodeo-thgr-thgr;
+			dp->d5421=temp*f542*g521;
+			dp->d5433=temp*f543*g533;
+			dp->xlamo=xmao+tle->xnodeo+tle->xnodeo-dp->thgr-dp->thgr;
 			bfact=deep_arg->xmdot+deep_arg->xnodot+deep_arg->xnodot-thdt-thdt;
-			bfact=bfact+ssl+ssh+ssh;
+			bfact=bfact+dp->ssl+dp->ssh+dp->ssh;
 		}
 	
 		else
 		{
-			SetFlag(RESONANCE_FLAG);
-			SetFlag(SYNCHRONOUS_FLAG);
+			SetFlag(ctx, RESONANCE_FLAG);
+			SetFlag(ctx, SYNCHRONOUS_FLAG);
 	
 			/* Synchronous resonance terms initialization */
 			g200=1+deep_arg->eosq*(-2.5+0.8125*deep_arg->eosq);
@@ -1214,36 +1322,37 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 			f311=0.9375*deep_arg->sinio*deep_arg->sinio*(1+3*deep_arg->cosio)-0.75*(1+deep_arg->cosio);
 			f330=1+deep_arg->cosio;
 			f330=1.875*f330*f330*f330;
-			del1=3*xnq*xnq*aqnv*aqnv;
-			del2=2*del1*f220*g200*q22;
-			del3=3*del1*f330*g300*q33*aqnv;
-			del1=del1*f311*g310*q31*aqnv;
-			fasx2=0.13130908;
-			fasx4=2.8843198;
-			fasx6=0.37448087;
-			xlamo=xmao+tle->xnodeo+tle->omegao-thgr;
+			dp->del1=3*dp->xnq*dp->xnq*aqnv*aqnv;
+			dp->del2=2*dp->del1*f220*g200*q22;
+			dp->del3=3*dp->del1*f330*g300*q33*aqnv;
+			dp->del1=dp->del1*f311*g310*q31*aqnv;
+			dp->fasx2=0.13130908;
+			dp->fasx4=2.8843198;
+			dp->fasx6=0.37448087;
+			dp->xlamo=xmao+tle->xnodeo+tle->omegao-dp->thgr;
 			bfact=deep_arg->xmdot+xpidot-thdt;
-			bfact=bfact+ssl+ssg+ssh;
+			bfact=bfact+dp->ssl+dp->ssg+dp->ssh;
 		}
 
-		xfact=bfact-xnq;
+		dp->xfact=bfact-dp->xnq;
 
 		/* Initialize integrator */
-		xli=xlamo;
-		xni=xnq;
-		atime=0;
-		stepp=720;
-		stepn=-720;
-		step2=259200;
+		dp->xli=dp->xlamo;
+		dp->xni=dp->xnq;
+		dp->atime=0;
+		dp->stepp=720;
+		dp->stepn=-720;
+		dp->step2=259200;
+		dp->kept=NULL;
 
 		return;
 
 		case dpsec:  /* Entrance for deep space secular effects */
-		deep_arg->xll=deep_arg->xll+ssl*deep_arg->t;
-		deep_arg->omgadf=deep_arg->omgadf+ssg*deep_arg->t;
-		deep_arg->xnode=deep_arg->xnode+ssh*deep_arg->t;
-		deep_arg->em=tle->eo+sse*deep_arg->t;
-		deep_arg->xinc=tle->xincl+ssi*deep_arg->t;
+		deep_arg->xll=deep_arg->xll+dp->ssl*deep_arg->t;
+		deep_arg->omgadf=deep_arg->omgadf+dp->ssg*deep_arg->t;
+		deep_arg->xnode=deep_arg->xnode+dp->ssh*deep_arg->t;
+		deep_arg->em=tle->eo+dp->sse*deep_arg->t;
+		deep_arg->xinc=tle->xincl+dp->ssi*deep_arg->t;
 	  
 		if (deep_arg->xinc<0)
 		{
@@ -1252,93 +1361,115 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 			deep_arg->omgadf=deep_arg->omgadf-pi;
 		}
 	
-		if (isFlagClear(RESONANCE_FLAG))
+		if (isFlagClear(ctx, RESONANCE_FLAG))
 		      return;
 
+		/* Rather than integrate all the way out from epoch, */
+		/* start from the checkpoint nearest t on the way.   */
+		/* Stepping on with INCREMENTAL_FLAG set does that   */
+		/* too rather than integrate back towards epoch, so  */
+		/* the result doesn't depend on the times before.    */
+		if ((dp->atime==0) || ((deep_arg->t>=0) && (dp->atime<0)) || ((deep_arg->t<0) && (dp->atime>=0)) ||
+		    (isFlagSet(ctx, INCREMENTAL_FLAG) && fabs(deep_arg->t)<fabs(dp->atime)))
+		{
+			dp->atime=0;
+			dp->xni=dp->xnq;
+			dp->xli=dp->xlamo;
+			ResumeDeep(ctx, deep_arg->t);
+			outward=1;
+		}
+
 		do
 		{
-			if ((atime==0) || ((deep_arg->t>=0) && (atime<0)) || ((deep_arg->t<0) && (atime>=0)))
+			if ((dp->atime==0) || ((deep_arg->t>=0) && (dp->atime<0)) || ((deep_arg->t<0) && (dp->atime>=0)))
 			{
 				/* Epoch restart */
 
 				if (deep_arg->t>=0)
-					delt=stepp;
+					delt=dp->stepp;
 				else
-					delt=stepn;
+					delt=dp->stepn;
 
-				atime=0;
-				xni=xnq;
-				xli=xlamo;
+				dp->atime=0;
+				dp->xni=dp->xnq;
+				dp->xli=dp->xlamo;
 			}
 
 			else
 			{
-				if (fabs(deep_arg->t)>=fabs(atime))
+				if (fabs(deep_arg->t)>=fabs(dp->atime))
 				{
 					if (deep_arg->t>0)
-						delt=stepp;
+						delt=dp->stepp;
 					else
-						delt=stepn;
+						delt=dp->stepn;
 				}
 			}
 	    
 			do
 			{
-				if (fabs(deep_arg->t-atime)>=stepp)
+				if (fabs(deep_arg->t-dp->atime)>=dp->stepp)
 				{
-					SetFlag(DO_LOOP_FLAG);
-					ClearFlag(EPOCH_RESTART_FLAG);
+					SetFlag(ctx, DO_LOOP_FLAG);
+					ClearFlag(ctx, EPOCH_RESTART_FLAG);
 				}
 		
 				else
 				{
-					ft=deep_arg->t-atime;
-					ClearFlag(DO_LOOP_FLAG);
+					ft=deep_arg->t-dp->atime;
+					ClearFlag(ctx, DO_LOOP_FLAG);
 				}
 
-				if (fabs(deep_arg->t)<fabs(atime))
+				if (fabs(deep_arg->t)<fabs(dp->atime))
 				{
 					if (deep_arg->t>=0)
-						delt=stepn;
+						delt=dp->stepn;
 					else
-						delt=stepp;
+						delt=dp->stepp;
 
-					SetFlag(DO_LOOP_FLAG | EPOCH_RESTART_FLAG);
+					SetFlag(ctx, DO_LOOP_FLAG | EPOCH_RESTART_FLAG);
 				}
 
 				/* Dot terms calculated */
-				if (isFlagSet(SYNCHRONOUS_FLAG))
+				if (isFlagSet(ctx, SYNCHRONOUS_FLAG))
 				{
-					xndot=del1*sin(xli-fasx2)+del2*sin(2*(xli-fasx4))+del3*sin(3*(xli-fasx6));
-					xnddt=del1*cos(xli-fasx2)+2*del2*cos(2*(xli-fasx4))+3*del3*cos(3*(xli-fasx6));
+					xndot=dp->del1*sin(dp->xli-dp->fasx2)+dp->del2*sin(2*(dp->xli-dp->fasx4))+dp->del3*sin(3*(dp->xli-dp->fasx6));
+					xnddt=dp->del1*cos(dp->xli-dp->fasx2)+2*dp->del2*cos(2*(dp->xli-dp->fasx4))+3*dp->del3*cos(3*(dp->xli-dp->fasx6));
 				}
 		
 				else
 				{
-					xomi=omegaq+deep_arg->omgdot*atime;
+					xomi=dp->omegaq+deep_arg->omgdot*dp->atime;
 					x2omi=xomi+xomi;
-					x2li=xli+xli;
-					xndot=d2201*sin(x2omi+xli-g22)+d2211*sin(xli-g22)+d3210*sin(xomi+xli-g32)+d3222*sin(-xomi+xli-g32)+d4410*sin(x2omi+x2li-g44)+d4422*sin(x2li-g44)+d5220*sin(xomi+xli-g52)+d5232*sin(-xomi+xli-g52)+d5421*sin(xomi+x2li-g54)+d5433*sin(-xomi+x2li-g54);
-					xnddt=d2201*cos(x2omi+xli-g22)+d2211*cos(xli-g22)+d3210*cos(xomi+xli-g32)+d3222*cos(-xomi+xli-g32)+d5220*cos(xomi+xli-g52)+d5232*cos(-xomi+xli-g52)+2*(d4410*cos(x2omi+x2li-g44)+d4422*cos(x2li-g44)+d5421*cos(xomi+x2li-g54)+d5433*cos(-xomi+x2li-g54));
+					x2li=dp->xli+dp->xli;
+					xndot=dp->d2201*sin(x2omi+dp->xli-g22)+dp->d2211*sin(dp->xli-g22)+dp->d3210*sin(xomi+dp->xli-g32)+dp->d3222*sin(-xomi+dp->xli-g32)+dp->d4410*sin(x2omi+x2li-g44)+dp->d4422*sin(x2li-g44)+dp->d5220*sin(xomi+dp->xli-g52)+dp->d5232*sin(-xomi+dp->xli-g52)+dp->d5421*sin(xomi+x2li-g54)+dp->d5433*sin(-xomi+x2li-g54);
+					xnddt=dp->d2201*cos(x2omi+dp->xli-g22)+dp->d2211*cos(dp->xli-g22)+dp->d3210*cos(xomi+dp->xli-g32)+dp->d3222*cos(-xomi+dp->xli-g32)+dp->d5220*cos(xomi+dp->xli-g52)+dp->d5232*cos(-xomi+dp->xli-g52)+2*(dp->d4410*cos(x2omi+x2li-g44)+dp->d4422*cos(x2li-g44)+dp->d5421*cos(xomi+x2li-g54)+dp->d5433*cos(-xomi+x2li-g54));
 				}
 
-				xldot=xni+xfact;
+				xldot=dp->xni+dp->xfact;
 				xnddt=xnddt*xldot;
 
-				if (isFlagSet(DO_LOOP_FLAG))
+				if (isFlagSet(ctx, DO_LOOP_FLAG))
 				{
-					xli=xli+xldot*delt+xndot*step2;
-					xni=xni+xndot*delt+xnddt*step2;
-					atime=atime+delt;
+					dp->xli=dp->xli+xldot*delt+xndot*dp->step2;
+					dp->xni=dp->xni+xndot*delt+xnddt*dp->step2;
+					dp->atime=dp->atime+delt;
+
+					/* Stepping back towards epoch leaves */
+					/* the path checkpoints are kept on.  */
+					if (isFlagSet(ctx, EPOCH_RESTART_FLAG))
+						outward=0;
+					else if (outward && (long)(fabs(dp->atime)/dp->stepp+0.5)%DEEP_CHECKPOINT_STEPS==0)
+						KeepCheckpoint(dp);
 				}
-			} while (isFlagSet(DO_LOOP_FLAG) && isFlagClear(EPOCH_RESTART_FLAG));
-		} while (isFlagSet(DO_LOOP_FLAG) && isFlagSet(EPOCH_RESTART_FLAG));
+			} while (isFlagSet(ctx, DO_LOOP_FLAG) && isFlagClear(ctx, EPOCH_RESTART_FLAG));
+		} while (isFlagSet(ctx, DO_LOOP_FLAG) && isFlagSet(ctx, EPOCH_RESTART_FLAG));
 
-		deep_arg->xn=xni+xndot*ft+xnddt*ft*ft*0.5;
-		xl=xli+xldot*ft+xndot*ft*ft*0.5;
-		temp=-deep_arg->xnode+thgr+deep_arg->t*thdt;
+		deep_arg->xn=dp->xni+xndot*ft+xnddt*ft*ft*0.5;
+		xl=dp->xli+xldot*ft+xndot*ft*ft*0.5;
+		temp=-deep_arg->xnode+dp->thgr+deep_arg->t*thdt;
 
-		if (isFlagClear(SYNCHRONOUS_FLAG))
+		if (isFlagClear(ctx, SYNCHRONOUS_FLAG))
 			deep_arg->xll=xl+temp+temp;
    		else
 			deep_arg->xll=xl-deep_arg->omgadf+temp;
@@ -1349,47 +1480,47 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 		sinis=sin(deep_arg->xinc);
 		cosis=cos(deep_arg->xinc);
 
-		if (fabs(savtsn-deep_arg->t)>=30)
+		if (fabs(dp->savtsn-deep_arg->t)>=(isFlagSet(ctx, INCREMENTAL_FLAG) ? DEEP_PERIODICS_REUSE : 30))
 		{
-			savtsn=deep_arg->t;
-			zm=zmos+zns*deep_arg->t;
+			dp->savtsn=deep_arg->t;
+			zm=dp->zmos+zns*deep_arg->t;
 			zf=zm+2*zes*sin(zm);
 			sinzf=sin(zf);
 			f2=0.5*sinzf*sinzf-0.25;
 			f3=-0.5*sinzf*cos(zf);
-			ses=se2*f2+se3*f3;
-			sis=si2*f2+si3*f3;
-			sls=sl2*f2+sl3*f3+sl4*sinzf;
-			sghs=sgh2*f2+sgh3*f3+sgh4*sinzf;
-			shs=sh2*f2+sh3*f3;
-			zm=zmol+znl*deep_arg->t;
+			ses=dp->se2*f2+dp->se3*f3;
+			sis=dp->si2*f2+dp->si3*f3;
+			sls=dp->sl2*f2+dp->sl3*f3+dp->sl4*sinzf;
+			dp->sghs=dp->sgh2*f2+dp->sgh3*f3+dp->sgh4*sinzf;
+			dp->shs=dp->sh2*f2+dp->sh3*f3;
+			zm=dp->zmol+znl*deep_arg->t;
 			zf=zm+2*zel*sin(zm);
 			sinzf=sin(zf);
 			f2=0.5*sinzf*sinzf-0.25;
 			f3=-0.5*sinzf*cos(zf);
-			sel=ee2*f2+e3*f3;
-			sil=xi2*f2+xi3*f3;
-			sll=xl2*f2+xl3*f3+xl4*sinzf;
-			sghl=xgh2*f2+xgh3*f3+xgh4*sinzf;
-			sh1=xh2*f2+xh3*f3;
-			pe=ses+sel;
-			pinc=sis+sil;
-			pl=sls+sll;
+			sel=dp->ee2*f2+dp->e3*f3;
+			sil=dp->xi2*f2+dp->xi3*f3;
+			sll=dp->xl2*f2+dp->xl3*f3+dp->xl4*sinzf;
+			dp->sghl=dp->xgh2*f2+dp->xgh3*f3+dp->xgh4*sinzf;
+			dp->sh1=dp->xh2*f2+dp->xh3*f3;
+			dp->pe=ses+sel;
+			dp->pinc=sis+sil;
+			dp->pl=sls+sll;
 		}
 
-		pgh=sghs+sghl;
-		ph=shs+sh1;
-		deep_arg->xinc=deep_arg->xinc+pinc;
-		deep_arg->em=deep_arg->em+pe;
+		pgh=dp->sghs+dp->sghl;
+		ph=dp->shs+dp->sh1;
+		deep_arg->xinc=deep_arg->xinc+dp->pinc;
+		deep_arg->em=deep_arg->em+dp->pe;
 
-		if (xqncl>=0.2)
+		if (dp->xqncl>=0.2)
 		{
 			/* Apply periodics directly */
 			ph=ph/deep_arg->sinio;
 			pgh=pgh-deep_arg->cosio*ph;
 			deep_arg->omgadf=deep_arg->omgadf+pgh;
 			deep_arg->xnode=deep_arg->xnode+ph;
-			deep_arg->xll=deep_arg->xll+pl;
+			deep_arg->xll=deep_arg->xll+dp->pl;
 		}
 	
 		else
@@ -1399,13 +1530,13 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 			cosok=cos(deep_arg->xnode);
 			alfdp=sinis*sinok;
 			betdp=sinis*cosok;
-			dalf=ph*cosok+pinc*cosis*sinok;
-			dbet=-ph*sinok+pinc*cosis*cosok;
+			dalf=ph*cosok+dp->pinc*cosis*sinok;
+			dbet=-ph*sinok+dp->pinc*cosis*cosok;
 			alfdp=alfdp+dalf;
 			betdp=betdp+dbet;
 			deep_arg->xnode=FMod2p(deep_arg->xnode);
 			xls=deep_arg->xll+deep_arg->omgadf+cosis*deep_arg->xnode;
-			dls=pl+pgh-pinc*deep_arg->xnode*sinis;
+			dls=dp->pl+pgh-dp->pinc*deep_arg->xnode*sinis;
 			xls=xls+dls;
 			xnoh=deep_arg->xnode;
 			deep_arg->xnode=AcTan(alfdp,betdp);
@@ -1421,27 +1552,74 @@ void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg)
 				  deep_arg->xnode-=twopi;
 			}
 
-			deep_arg->xll=deep_arg->xll+pl;
+			deep_arg->xll=deep_arg->xll+dp->pl;
 			deep_arg->omgadf=xls-deep_arg->xll-cos(deep_arg->xinc)*deep_arg->xnode;
 		}
 		return;
 	}
 }
 
-void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
+void ResetDeep(context_t *ctx)
+{
+	/* Deep() caches the lunar-solar periodics and the state of the */
+	/* resonance integrator between calls.  This discards them, so  */
+	/* the next call to SDP4() gives exactly the same result as the */
+	/* first call made after initialization, without redoing it.   */
+
+	deep_t *dp=&ctx->sdp4.deep;
+
+	dp->savtsn=1E20;
+	dp->xli=dp->xlamo;
+	dp->xni=dp->xnq;
+	dp->atime=0;
+}
+
+int KeepDeepCheckpoints(context_t *ctx)
+{
+	/* Gives ctx, which PreCalc() has initialized, a table of   */
+	/* the checkpoints of its resonance integrator, shared by    */
+	/* the copies of ctx and freed by FreeDeepCheckpoints() once */
+	/* none is left.  Satellites not in resonance need none.     */
+	/* Returns -1 if memory runs out.                            */
+
+	if (isFlagClear(ctx, DEEP_SPACE_EPHEM_FLAG) || isFlagClear(ctx, RESONANCE_FLAG))
+		return 0;
+
+	ctx->sdp4.deep.kept=calloc(1, sizeof(deep_checkpoints_t));
+
+	return ctx->sdp4.deep.kept==NULL ? -1 : 0;
+}
+
+void FreeDeepCheckpoints(deep_checkpoints_t *kept)
+{
+	/* Frees a table of checkpoints with its blocks, and the */
+	/* retired tables chained to it.                         */
+
+	deep_checkpoints_t *next;
+	int i;
+
+	for (; kept!=NULL; kept=next)
+	{
+		next=kept->next;
+
+		for (i=0; i<2*DEEP_CHECKPOINT_BLOCKS; i++)
+			free(kept->block[i/DEEP_CHECKPOINT_BLOCKS][i%DEEP_CHECKPOINT_BLOCKS]);
+
+		free(kept);
+	}
+}
+
+void SDP4(context_t *ctx, double tsince, vector_t *pos, vector_t *vel)
 {
 	/* This function is used to calculate the position and velocity */
 	/* of deep-space (period > 225 minutes) satellites. tsince is   */
-	/* time since epoch in minutes, tle is a pointer to a tle_t     */
-	/* structure with Keplerian orbital elements and pos and vel    */
+	/* time since epoch in minutes, ctx holds the tle_t structure   */
+	/* with Keplerian orbital elements and pos and vel              */
 	/* are vector_t structures returning ECI satellite position and */
 	/* velocity. Use Convert_Sat_State() to convert to km and km/s. */
 
 	int i;
 
-	static double x3thm1, c1, x1mth2, c4, xnodcf, t2cof, xlcof,
-	aycof, x7thm1;
-
 	double a, axn, ayn, aynl, beta, betal, capu, cos2u, cosepw, cosik,
 	cosnok, cosu, cosuk, ecose, elsq, epw, esine, pl, theta4, rdot,
 	rdotk, rfdot, rfdotk, rk, sin2u, sinepw, sinik, sinnok, sinu,
@@ -1449,38 +1627,43 @@ void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 	xlt, xmam, xmdf, xmx, xmy, xnoddf, xnodek, xll, a1, a3ovk2, ao, c2,
 	coef, coef1, x1m5th, xhdot1, del1, r, delo, eeta, eta, etasq,
 	perigee, psisq, tsi, qoms24, s4, pinvsq, temp, tempa, temp1,
-	temp2, temp3, temp4, temp5, temp6, bx, by, bz, cx, cy, cz;
+	temp2, temp3, temp4, temp5, temp6;
 
-	static deep_arg_t deep_arg;
+	tle_t *tle=&ctx->tle;
+	sdp4_t *sdp4=&ctx->sdp4;
+	deep_arg_t *deep_arg=&sdp4->deep_arg;
 
 	/* Initialization */
 
-	if (isFlagClear(SDP4_INITIALIZED_FLAG))
+	if (isFlagClear(ctx, SDP4_INITIALIZED_FLAG))
 	{
-		SetFlag(SDP4_INITIALIZED_FLAG);
+		SetFlag(ctx, SDP4_INITIALIZED_FLAG);
 
 		/* Recover original mean motion (xnodp) and   */
 		/* semimajor axis (aodp) from input elements. */
 	  
 		a1=pow(xke/tle->xno,tothrd);
-		deep_arg.cosio=cos(tle->xincl);
-		deep_arg.theta2=deep_arg.cosio*deep_arg.cosio;
-		x3thm1=3*deep_arg.theta2-1;
-		deep_arg.eosq=tle->eo*tle->eo;
-		deep_arg.betao2=1-deep_arg.eosq;
-		deep_arg.betao=sqrt(deep_arg.betao2);
-		del1=1.5*ck2*x3thm1/(a1*a1*deep_arg.betao*deep_arg.betao2);
+		deep_arg->cosio=cos(tle->xincl);
+		deep_arg->theta2=deep_arg->cosio*deep_arg->cosio;
+		sdp4->x3thm1=3*deep_arg->theta2-1;
+		deep_arg->eosq=tle->eo*tle->eo;
+		deep_arg->betao2=1-deep_arg->eosq;
+		deep_arg->betao=sqrt(deep_arg->betao2);
+		del1=1.5*ck2*sdp4->x3thm1/(a1*a1*deep_arg->betao*deep_arg->betao2);
 		ao=a1*(1-del1*(0.5*tothrd+del1*(1+134/81*del1)));
-		delo=1.5*ck2*x3thm1/(ao*ao*deep_arg.betao*deep_arg.betao2);
-		deep_arg.xnodp=tle->xno/(1+delo);
-		deep_arg.aodp=ao/(1-delo);
+		delo=1.5*ck2*sdp4->x3thm1/(ao*ao*deep_arg->betao*deep_arg->betao2);
+		deep_arg->xnodp=tle->xno/(1+delo);
+		deep_arg->aodp=ao/(1-delo);
+		ctx->sat.aodp=deep_arg->aodp*xkmper; // Get semi major axis in km
 
 		/* For perigee below 156 km, the values */
 		/* of s and qoms2t are altered.         */
 	  
 		s4=s;
 		qoms24=qoms2t;
-		perigee=(deep_arg.aodp*(1-tle->eo)-ae)*xkmper;
+		perigee=(deep_arg->aodp*(1-tle->eo)-ae)*xkmper;
+		ctx->sat.perigee=perigee;
+		ctx->sat.apogee=(deep_arg->aodp*(1+tle->eo)-ae)*xkmper;
 	  
 		if (perigee<156.0)
 		{
@@ -1493,85 +1676,85 @@ void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 			s4=s4/xkmper+ae;
 		}
 
-		pinvsq=1/(deep_arg.aodp*deep_arg.aodp*deep_arg.betao2*deep_arg.betao2);
-		deep_arg.sing=sin(tle->omegao);
-		deep_arg.cosg=cos(tle->omegao);
-		tsi=1/(deep_arg.aodp-s4);
-		eta=deep_arg.aodp*tle->eo*tsi;
+		pinvsq=1/(deep_arg->aodp*deep_arg->aodp*deep_arg->betao2*deep_arg->betao2);
+		deep_arg->sing=sin(tle->omegao);
+		deep_arg->cosg=cos(tle->omegao);
+		tsi=1/(deep_arg->aodp-s4);
+		eta=deep_arg->aodp*tle->eo*tsi;
 		etasq=eta*eta;
 		eeta=tle->eo*eta;
 		psisq=fabs(1-etasq);
 		coef=qoms24*pow(tsi,4);
 		coef1=coef/pow(psisq,3.5);
-		c2=coef1*deep_arg.xnodp*(deep_arg.aodp*(1+1.5*etasq+eeta*(4+etasq))+0.75*ck2*tsi/psisq*x3thm1*(8+3*etasq*(8+etasq)));
-		c1=tle->bstar*c2;
-		deep_arg.sinio=sin(tle->xincl);
+		c2=coef1*deep_arg->xnodp*(deep_arg->aodp*(1+1.5*etasq+eeta*(4+etasq))+0.75*ck2*tsi/psisq*sdp4->x3thm1*(8+3*etasq*(8+etasq)));
+		sdp4->c1=tle->bstar*c2;
+		deep_arg->sinio=sin(tle->xincl);
 		a3ovk2=-xj3/ck2*pow(ae,3);
-		x1mth2=1-deep_arg.theta2;
-		c4=2*deep_arg.xnodp*coef1*deep_arg.aodp*deep_arg.betao2*(eta*(2+0.5*etasq)+tle->eo*(0.5+2*etasq)-2*ck2*tsi/(deep_arg.aodp*psisq)*(-3*x3thm1*(1-2*eeta+etasq*(1.5-0.5*eeta))+0.75*x1mth2*(2*etasq-eeta*(1+etasq))*cos(2*tle->omegao)));
-		theta4=deep_arg.theta2*deep_arg.theta2;
-		temp1=3*ck2*pinvsq*deep_arg.xnodp;
+		sdp4->x1mth2=1-deep_arg->theta2;
+		sdp4->c4=2*deep_arg->xnodp*coef1*deep_arg->aodp*deep_arg->betao2*(eta*(2+0.5*etasq)+tle->eo*(0.5+2*etasq)-2*ck2*tsi/(deep_arg->aodp*psisq)*(-3*sdp4->x3thm1*(1-2*eeta+etasq*(1.5-0.5*eeta))+0.75*sdp4->x1mth2*(2*etasq-eeta*(1+etasq))*cos(2*tle->omegao)));
+		theta4=deep_arg->theta2*deep_arg->theta2;
+		temp1=3*ck2*pinvsq*deep_arg->xnodp;
 		temp2=temp1*ck2*pinvsq;
-		temp3=1.25*ck4*pinvsq*pinvsq*deep_arg.xnodp;
-		deep_arg.xmdot=deep_arg.xnodp+0.5*temp1*deep_arg.betao*x3thm1+0.0625*temp2*deep_arg.betao*(13-78*deep_arg.theta2+137*theta4);
-		x1m5th=1-5*deep_arg.theta2;
-		deep_arg.omgdot=-0.5*temp1*x1m5th+0.0625*temp2*(7-114*deep_arg.theta2+395*theta4)+temp3*(3-36*deep_arg.theta2+49*theta4);
-		xhdot1=-temp1*deep_arg.cosio;
-		deep_arg.xnodot=xhdot1+(0.5*temp2*(4-19*deep_arg.theta2)+2*temp3*(3-7*deep_arg.theta2))*deep_arg.cosio;
-		xnodcf=3.5*deep_arg.betao2*xhdot1*c1;
-		t2cof=1.5*c1;
-		xlcof=0.125*a3ovk2*deep_arg.sinio*(3+5*deep_arg.cosio)/(1+deep_arg.cosio);
-		aycof=0.25*a3ovk2*deep_arg.sinio;
-		x7thm1=7*deep_arg.theta2-1;
+		temp3=1.25*ck4*pinvsq*pinvsq*deep_arg->xnodp;
+		deep_arg->xmdot=deep_arg->xnodp+0.5*temp1*deep_arg->betao*sdp4->x3thm1+0.0625*temp2*deep_arg->betao*(13-78*deep_arg->theta2+137*theta4);
+		x1m5th=1-5*deep_arg->theta2;
+		deep_arg->omgdot=-0.5*temp1*x1m5th+0.0625*temp2*(7-114*deep_arg->theta2+395*theta4)+temp3*(3-36*deep_arg->theta2+49*theta4);
+		xhdot1=-temp1*deep_arg->cosio;
+		deep_arg->xnodot=xhdot1+(0.5*temp2*(4-19*deep_arg->theta2)+2*temp3*(3-7*deep_arg->theta2))*deep_arg->cosio;
+		sdp4->xnodcf=3.5*deep_arg->betao2*xhdot1*sdp4->c1;
+		sdp4->t2cof=1.5*sdp4->c1;
+		sdp4->xlcof=0.125*a3ovk2*deep_arg->sinio*(3+5*deep_arg->cosio)/(1+deep_arg->cosio);
+		sdp4->aycof=0.25*a3ovk2*deep_arg->sinio;
+		sdp4->x7thm1=7*deep_arg->theta2-1;
 
 		/* initialize Deep() */
 
-		Deep(dpinit,tle,&deep_arg);
+		Deep(ctx,dpinit,deep_arg);
 	}
 
 	/* Update for secular gravity and atmospheric drag */
-	xmdf=tle->xmo+deep_arg.xmdot*tsince;
-	deep_arg.omgadf=tle->omegao+deep_arg.omgdot*tsince;
-	xnoddf=tle->xnodeo+deep_arg.xnodot*tsince;
+	xmdf=tle->xmo+deep_arg->xmdot*tsince;
+	deep_arg->omgadf=tle->omegao+deep_arg->omgdot*tsince;
+	xnoddf=tle->xnodeo+deep_arg->xnodot*tsince;
 	tsq=tsince*tsince;
-	deep_arg.xnode=xnoddf+xnodcf*tsq;
-	tempa=1-c1*tsince;
-	tempe=tle->bstar*c4*tsince;
-	templ=t2cof*tsq;
-	deep_arg.xn=deep_arg.xnodp;
+	deep_arg->xnode=xnoddf+sdp4->xnodcf*tsq;
+	tempa=1-sdp4->c1*tsince;
+	tempe=tle->bstar*sdp4->c4*tsince;
+	templ=sdp4->t2cof*tsq;
+	deep_arg->xn=deep_arg->xnodp;
 
 	/* Update for deep-space secular effects */
-	deep_arg.xll=xmdf;
-	deep_arg.t=tsince;
+	deep_arg->xll=xmdf;
+	deep_arg->t=tsince;
 
-	Deep(dpsec, tle, &deep_arg);
+	Deep(ctx,dpsec,deep_arg);
 
-	xmdf=deep_arg.xll;
-	a=pow(xke/deep_arg.xn,tothrd)*tempa*tempa;
-	deep_arg.em=deep_arg.em-tempe;
-	xmam=xmdf+deep_arg.xnodp*templ;
+	xmdf=deep_arg->xll;
+	a=pow(xke/deep_arg->xn,tothrd)*tempa*tempa;
+	deep_arg->em=deep_arg->em-tempe;
+	xmam=xmdf+deep_arg->xnodp*templ;
 
 	/* Update for deep-space periodic effects */
-	deep_arg.xll=xmam;
+	deep_arg->xll=xmam;
 
-	Deep(dpper,tle,&deep_arg);
+	Deep(ctx,dpper,deep_arg);
 
-	xmam=deep_arg.xll;
-	xl=xmam+deep_arg.omgadf+deep_arg.xnode;
-	beta=sqrt(1-deep_arg.em*deep_arg.em);
-	deep_arg.xn=xke/pow(a,1.5);
+	xmam=deep_arg->xll;
+	xl=xmam+deep_arg->omgadf+deep_arg->xnode;
+	beta=sqrt(1-deep_arg->em*deep_arg->em);
+	deep_arg->xn=xke/pow(a,1.5);
 
 	/* Long period periodics */
-	axn=deep_arg.em*cos(deep_arg.omgadf);
+	axn=deep_arg->em*cos(deep_arg->omgadf);
 	temp=1/(a*beta*beta);
-	xll=temp*xlcof*axn;
-	aynl=temp*aycof;
+	xll=temp*sdp4->xlcof*axn;
+	aynl=temp*sdp4->aycof;
 	xlt=xl+xll;
-	ayn=deep_arg.em*sin(deep_arg.omgadf)+aynl;
+	ayn=deep_arg->em*sin(deep_arg->omgadf)+aynl;
 
 	/* Solve Kepler's Equation */
-	capu=FMod2p(xlt-deep_arg.xnode);
-	temp2=capu;
+	capu=FMod2p(xlt-deep_arg->xnode);
+	temp2=KeplerStart(ctx,tsince,capu,deep_arg->xnodp,deep_arg->em);
 	i=0;
 
 	do
@@ -1593,6 +1776,7 @@ void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 
 	/* Short period preliminary quantities */
 	ecose=temp5+temp6;
+	KeplerKeep(ctx,tsince,capu,epw,ecose);
 	esine=temp3-temp4;
 	elsq=axn*axn+ayn*ayn;
 	temp=1-elsq;
@@ -1614,12 +1798,12 @@ void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 	temp2=temp1*temp;
 
 	/* Update for short periodics */
-	rk=r*(1-1.5*temp2*betal*x3thm1)+0.5*temp1*x1mth2*cos2u;
-	uk=u-0.25*temp2*x7thm1*sin2u;
-	xnodek=deep_arg.xnode+1.5*temp2*deep_arg.cosio*sin2u;
-	xinck=deep_arg.xinc+1.5*temp2*deep_arg.cosio*deep_arg.sinio*cos2u;
-	rdotk=rdot-deep_arg.xn*temp1*x1mth2*sin2u;
-	rfdotk=rfdot+deep_arg.xn*temp1*(x1mth2*cos2u+1.5*x3thm1);
+	rk=r*(1-1.5*temp2*betal*sdp4->x3thm1)+0.5*temp1*sdp4->x1mth2*cos2u;
+	uk=u-0.25*temp2*sdp4->x7thm1*sin2u;
+	xnodek=deep_arg->xnode+1.5*temp2*deep_arg->cosio*sin2u;
+	xinck=deep_arg->xinc+1.5*temp2*deep_arg->cosio*deep_arg->sinio*cos2u;
+	rdotk=rdot-deep_arg->xn*temp1*sdp4->x1mth2*sin2u;
+	rfdotk=rfdot+deep_arg->xn*temp1*(sdp4->x1mth2*cos2u+1.5*sdp4->x3thm1);
 
 	/* Orientation vectors */
 	sinuk=sin(uk);
@@ -1645,28 +1829,13 @@ void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel)
 	vel->y=rdotk*uy+rfdotk*vy;
 	vel->z=rdotk*uz+rfdotk*vz;
 
-	/* Calculations for squint angle begin here... */
-
-	if (calc_squint)
-	{
-		bx=cos(alat)*cos(alon+deep_arg.omgadf);
-		by=cos(alat)*sin(alon+deep_arg.omgadf);
-		bz=sin(alat);
-		cx=bx;
-		cy=by*cos(xinck)-bz*sin(xinck);
-		cz=by*sin(xinck)+bz*cos(xinck);
-		ax=cx*cos(xnodek)-cy*sin(xnodek);
-		ay=cx*sin(xnodek)+cy*cos(xnodek);
-		az=cz;
-	}
-	
 	/* Phase in radians */
-	phase=xlt-deep_arg.xnode-deep_arg.omgadf+twopi;
+	ctx->phase=xlt-deep_arg->xnode-deep_arg->omgadf+twopi;
     
-	if (phase<0.0)
-		phase+=twopi;
+	if (ctx->phase<0.0)
+		ctx->phase+=twopi;
 
-	phase=FMod2p(phase);
+	ctx->phase=FMod2p(ctx->phase);
 }
 
 void Calculate_User_PosVel(double time, geodetic_t *geodetic, vector_t *obs_pos, vector_t *obs_vel)
@@ -1755,12 +1924,6 @@ void Calculate_Obs(double time, vector_t *pos, vector_t *vel, geodetic_t *geodet
 	range.y=pos->y-obs_pos.y;
 	range.z=pos->z-obs_pos.z;
 
-	/* Save these values globally for calculating squint angles later... */
-
-	rx=range.x;
-	ry=range.y;
-	rz=range.z;
-
 	rgvel.x=vel->x-obs_vel.x;
 	rgvel.y=vel->y-obs_vel.y;
 	rgvel.z=vel->z-obs_vel.z;
@@ -1803,16 +1966,117 @@ void Calculate_Obs(double time, vector_t *pos, vector_t *vel, geodetic_t *geodet
 	obs_set->y=el;
 
 	/**** End bypass ****/
+}
 
-	if (obs_set->y>=0.0)
-		SetFlag(VISIBLE_FLAG);
-	else
-	{
-		obs_set->y=el;  /* Reset to true elevation */
-		ClearFlag(VISIBLE_FLAG);
-	}
+void Prepare_Station(station_t *station, double lat, double lon, long alt)
+{
+	/* Sets up a ground station at lat (N), lon (W) in degrees and  */
+	/* alt in meters, the way ReadQTH() does, and works out the     */
+	/* parts of Calculate_User_PosVel() that don't depend on time.  */
+
+	double c, sq;
+
+	station->geodetic.lat=lat*deg2rad;
+	station->geodetic.lon=-lon*deg2rad;
+	station->geodetic.alt=((double)alt)/1000.0;
+	station->geodetic.theta=0.0;
+
+	station->sin_lat=sin(station->geodetic.lat);
+	station->cos_lat=cos(station->geodetic.lat);
+	c=1/sqrt(1+f*(f-2)*Sqr(station->sin_lat));
+	sq=Sqr(1-f)*c;
+	station->achcp=(xkmper*c+station->geodetic.alt)*station->cos_lat;
+	station->z=(xkmper*sq+station->geodetic.alt)*station->sin_lat;
+}
+
+void Calculate_Station_ECI(double thetag, const station_t *station, station_eci_t *eci)
+{
+	/* Works out the ECI position and velocity of a station set  */
+	/* up by Prepare_Station(), as Calculate_User_PosVel() does, */
+	/* given thetag=ThetaG_JD(time).                             */
+
+	double theta;
+
+	theta=FMod2p(thetag+station->geodetic.lon); /* LMST */
+	eci->sin_theta=sin(theta);
+	eci->cos_theta=cos(theta);
+
+	eci->pos.x=station->achcp*eci->cos_theta; /* kilometers */
+	eci->pos.y=station->achcp*eci->sin_theta;
+	eci->pos.z=station->z;
+	eci->vel.x=-mfactor*eci->pos.y; /* kilometers/second */
+	eci->vel.y=mfactor*eci->pos.x;
+	eci->vel.z=0;
+}
+
+double Calculate_Station_Sin_Elevation(vector_t *pos, const station_t *station, const station_eci_t *eci)
+{
+	/* Just the elevation part of Calculate_Station_Obs(), stopping */
+	/* short of ArcSin(): the elevation is ArcSin() of the result.  */
+
+	double top_z;
+
+	vector_t range;
+
+	range.x=pos->x-eci->pos.x;
+	range.y=pos->y-eci->pos.y;
+	range.z=pos->z-eci->pos.z;
+
+	Magnitude(&range);
+
+	top_z=station->cos_lat*eci->cos_theta*range.x+station->cos_lat*eci->sin_theta*range.y+station->sin_lat*range.z;
+
+	return top_z/range.w;
 }
 
+void Calculate_Station_Obs(double thetag, vector_t *pos, vector_t *vel, const station_t *station, vector_t *obs_set)
+{
+	/* Calculate_Obs() for a station set up by Prepare_Station(), */
+	/* with thetag=ThetaG_JD(time) passed in so that it's worked  */
+	/* out once for all of the stations observing pos and vel.    */
+	/* The results are the same as those of Calculate_Obs(), and  */
+	/* station is left untouched so it can be shared by threads.  */
+
+	double sin_theta, cos_theta, el, azim, top_s, top_e, top_z;
+
+	vector_t range, rgvel;
+
+	station_eci_t eci;
+
+	Calculate_Station_ECI(thetag, station, &eci);
+	sin_theta=eci.sin_theta;
+	cos_theta=eci.cos_theta;
+
+	range.x=pos->x-eci.pos.x;
+	range.y=pos->y-eci.pos.y;
+	range.z=pos->z-eci.pos.z;
+
+	rgvel.x=vel->x-eci.vel.x;
+	rgvel.y=vel->y-eci.vel.y;
+	rgvel.z=vel->z-eci.vel.z;
+
+	Magnitude(&range);
+
+	top_s=station->sin_lat*cos_theta*range.x+station->sin_lat*sin_theta*range.y-station->cos_lat*range.z;
+	top_e=-sin_theta*range.x+cos_theta*range.y;
+	top_z=station->cos_lat*cos_theta*range.x+station->cos_lat*sin_theta*range.y+station->sin_lat*range.z;
+	azim=atan(-top_e/top_s); /* Azimuth */
+
+	if (top_s>0.0) 
+		azim=azim+pi;
+
+	if (azim<0.0)
+		azim=azim+twopi;
+
+	el=ArcSin(top_z/range.w);
+	obs_set->x=azim;	/* Azimuth (radians)   */
+	obs_set->y=el;		/* Elevation (radians) */
+	obs_set->z=range.w;	/* Range (kilometers)  */
+
+	/* Range Rate (kilometers/second) */
+
+	obs_set->w=Dot(&range,&rgvel)/range.w;
+}
 void Calculate_RADec(double time, vector_t *pos, vector_t *vel, geodetic_t *geodetic, vector_t *obs_set)
 {
 	/* Reference:  Methods of Orbit Determination by  */
@@ -1878,11 +2142,12 @@ double x;
 	return x;
 }
 
-char *SubString(char *string, char start, char end)
+char *SubString(const char *string, char start, char end, char *temp)
 {
 	/* This function returns a substring based on the starting
-	   and ending positions provided.  It is used heavily in
-	   the AutoUpdate function when parsing 2-line element data. */
+	   and ending positions provided, stored in the caller's
+	   buffer "temp".  It is used heavily in the AutoUpdate
+	   function when parsing 2-line element data. */
 
 	unsigned x, y;
 
@@ -1917,14 +2182,16 @@ void CopyString(char *source, char *destination, char start, char end)
 		}
 }
 
-char *Abbreviate(string,n)
+char *Abbreviate(string,n,temp)
 char *string;
 int n;
+char *temp;
 {
 	/* This function returns an abbreviated substring of the original,
 	   including a '~' character if a non-blank character is chopped
 	   out of the generated substring.  n is the length of the desired
-	   substring.  It is used for abbreviating satellite names. */
+	   substring.  It is used for abbreviating satellite names.
+	   The result is stored in the caller's 80 character buffer "temp". */
 
 	strncpy(temp,string,79);
 
@@ -1939,7 +2206,130 @@ int n;
 	return temp;
 }
 
-char KepCheck(char *line1, char *line2)
+/* Fixed column TLE decoding.  Fields are read straight out of the
+   lines, without copying them out with SubString(), and numbers are
+   worked out without atof() or the locale it depends on. */
+
+typedef unsigned char tle_chunk_t __attribute__ ((vector_size (16)));
+
+static const double tle_pow10[]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+	1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+	1e18, 1e19, 1e20, 1e21, 1e22};
+
+static int TLEChecksum(const char *line)
+{
+	/* Returns the checksum of the first 68 columns of a TLE line:
+	   the sum of its digits, each minus sign counting as 1, mod 10.
+	   Columns are summed 16 at a time, as vectors of bytes, which
+	   can't overflow in the 4 passes it takes. */
+
+	tle_chunk_t c, d, sum={0};
+	int x, total=0;
+
+	for (x=0; x<64; x+=16)
+	{
+		memcpy(&c, line+x, sizeof(c));
+		d=c-(unsigned char)'0';
+		sum+=(d&(tle_chunk_t)(d<10))+((tle_chunk_t)(c==(unsigned char)'-')&1);
+	}
+
+	for (x=0; x<16; x++)
+		total+=sum[x];
+
+	for (x=64; x<68; x++)
+	{
+		if (line[x]>='0' && line[x]<='9')
+			total+=line[x]-'0';
+		else if (line[x]=='-')
+			total++;
+	}
+
+	return total%10;
+}
+
+static double TLEDecimal(const char *line, int start, int end)
+{
+	/* Returns what atof() makes of columns start to end once blanks
+	   are taken out, as SubString() used to.  With at most 15
+	   digits, they make an exact integer and dividing it by an exact
+	   power of ten rounds once, just as atof() does, so the results
+	   are identical.  Anything else is left to atof() itself. */
+
+	double mantissa=0.0, value;
+	int x, digits=0, decimals=-1, negative=0, sign=0;
+	char temp[80];
+
+	for (x=start; x<=end && line[x]!=0; x++)
+	{
+		if (line[x]==' ')
+			continue;
+
+		if (digits==0 && decimals<0 && !sign && (line[x]=='+' || line[x]=='-'))
+		{
+			negative=(line[x]=='-');
+			sign=1;
+		}
+		else if (line[x]=='.' && decimals<0)
+			decimals=0;
+		else if (line[x]>='0' && line[x]<='9')
+		{
+			mantissa=10.0*mantissa+(line[x]-'0');
+			digits++;
+
+			if (decimals>=0)
+				decimals++;
+		}
+		else
+			break;
+	}
+
+	if ((x<=end && line[x]!=0) || digits>15)
+		return atof(SubString(line,start,end,temp));
+
+	value=decimals>0 ? mantissa/tle_pow10[decimals] : mantissa;
+
+	return negative ? -value : value;
+}
+
+static long TLEInteger(const char *line, int start, int end)
+{
+	/* Returns what atol() makes of columns start to end once
+	   blanks are taken out, as SubString() used to. */
+
+	long value=0;
+	int x, negative=0, digits=0, sign=0;
+
+	for (x=start; x<=end && line[x]!=0; x++)
+	{
+		if (line[x]==' ')
+			continue;
+
+		if (digits==0 && !sign && (line[x]=='+' || line[x]=='-'))
+		{
+			negative=(line[x]=='-');
+			sign=1;
+		}
+		else if (line[x]>='0' && line[x]<='9')
+		{
+			value=10*value+(line[x]-'0');
+			digits++;
+		}
+		else
+			break;
+	}
+
+	return negative ? -value : value;
+}
+
+static double TLEExponent(char digit)
+{
+	/* 10 to the power of an exponent column, which pow() would
+	   give exactly too. */
+
+	return (digit>='0' && digit<='9') ? tle_pow10[digit-'0'] : pow(10.0,(digit-'0'));
+}
+
+char KepCheck(const char *line1, const char *line2)
 {
 	/* This function scans line 1 and line 2 of a NASA 2-Line element
 	   set and returns a 1 if the element set appears to be valid or
@@ -1949,15 +2339,15 @@ char KepCheck(char *line1, char *line2)
 	   as orbital data based on a simple checksum calculation alone. */
 
 	int x;
-	unsigned sum1, sum2;
 
-	/* Compute checksum for each line */
+	/* Both lines must reach the checksum column */
 
-	for (x=0, sum1=0, sum2=0; x<=67; sum1+=val[(int)line1[x]], sum2+=val[(int)line2[x]], x++);
+	if (strnlen(line1,69)<69 || strnlen(line2,69)<69)
+		return 0;
 
 	/* Perform a "torture test" on the data */
 
-	x=(val[(int)line1[68]]^(sum1%10)) | (val[(int)line2[68]]^(sum2%10)) |
+	x=((line1[68]-'0')^TLEChecksum(line1)) | ((line2[68]-'0')^TLEChecksum(line2)) |
 	  (line1[0]^'1')  | (line1[1]^' ')  | (line1[7]^'U')  |
 	  (line1[8]^' ')  | (line1[17]^' ') | (line1[23]^'.') |
 	  (line1[32]^' ') | (line1[34]^'.') | (line1[43]^' ') |
@@ -1976,37 +2366,40 @@ char KepCheck(char *line1, char *line2)
 	return (x ? 0 : 1);
 }
 
-void InternalUpdate(x)
-int x;
+void InternalUpdate(sat_struct *sat)
 {
 	/* Updates data in TLE structure based on
 	   line1 and line2 stored in structure. */
 
-	double tempnum;
+	int x, y;
+
+	for (x=9, y=0; x<=16 && sat->line1[x]!=0; x++)
+		if (sat->line1[x]!=' ')
+			sat->designator[y++]=sat->line1[x];
 
-	strncpy(sat.designator,SubString(sat.line1,9,16),8);
-	sat.designator[9]=0;
-	sat.catnum=atol(SubString(sat.line1,2,6));
-	sat.year=atoi(SubString(sat.line1,18,19));
-	sat.refepoch=atof(SubString(sat.line1,20,31));
-	tempnum=1.0e-5*atof(SubString(sat.line1,44,49));
-	sat.nddot6=tempnum/pow(10.0,(sat.line1[51]-'0'));
-	tempnum=1.0e-5*atof(SubString(sat.line1,53,58));
-	sat.bstar=tempnum/pow(10.0,(sat.line1[60]-'0'));
-	sat.setnum=atol(SubString(sat.line1,64,67));
-	sat.incl=atof(SubString(sat.line2,8,15));
-	sat.raan=atof(SubString(sat.line2,17,24));
-	sat.eccn=1.0e-07*atof(SubString(sat.line2,26,32));
-	sat.argper=atof(SubString(sat.line2,34,41));
-	sat.meanan=atof(SubString(sat.line2,43,50));
-	sat.meanmo=atof(SubString(sat.line2,52,62));
-	sat.drag=atof(SubString(sat.line1,33,42));
-	sat.orbitnum=atof(SubString(sat.line2,63,67));
+	while (y<(int)sizeof(sat->designator))
+		sat->designator[y++]=0;
+
+	sat->catnum=TLEInteger(sat->line1,2,6);
+	sat->year=(int)TLEInteger(sat->line1,18,19);
+	sat->refepoch=TLEDecimal(sat->line1,20,31);
+	sat->nddot6=1.0e-5*TLEDecimal(sat->line1,44,49)/TLEExponent(sat->line1[51]);
+	sat->bstar=1.0e-5*TLEDecimal(sat->line1,53,58)/TLEExponent(sat->line1[60]);
+	sat->setnum=TLEInteger(sat->line1,64,67);
+	sat->incl=TLEDecimal(sat->line2,8,15);
+	sat->raan=TLEDecimal(sat->line2,17,24);
+	sat->eccn=1.0e-07*TLEDecimal(sat->line2,26,32);
+	sat->argper=TLEDecimal(sat->line2,34,41);
+	sat->meanan=TLEDecimal(sat->line2,43,50);
+	sat->meanmo=TLEDecimal(sat->line2,52,62);
+	sat->drag=TLEDecimal(sat->line1,33,42);
+	sat->orbitnum=TLEDecimal(sat->line2,63,67);
 }
 
-char *noradEvalue(double value)
+char *noradEvalue(double value, char *output)
 {
-	/* Converts numeric values to E notation used in NORAD TLEs */
+	/* Converts numeric values to E notation used in NORAD TLEs.
+	   The result is stored in the caller's buffer "output". */
 
 	char string[15];
 
@@ -2025,15 +2418,14 @@ char *noradEvalue(double value)
 	return output;
 }
 
-void Data2TLE(x)
-int x;
+void Data2TLE(sat_struct *sat)
 {
 	/* This function converts orbital data held in the numeric
 	   portion of the sat tle structure to ASCII TLE format,
 	   and places the result in ASCII portion of the structure. */
  
 	int i;
-	char string[15], line1[70], line2[70];
+	char string[15], line1[70], line2[70], output[25];
 	unsigned sum;
 
 	/* Fill lines with blanks */
@@ -2053,40 +2445,40 @@ int x;
 
 	/* Insert orbital data */
 
-	sprintf(string,"%05ld",sat.catnum);
+	sprintf(string,"%05ld",sat->catnum);
 	CopyString(string,line1,2,6);
 	CopyString(string,line2,2,6);
 
-	CopyString(sat.designator,line1,9,16);
+	CopyString(sat->designator,line1,9,16);
 
-	sprintf(string,"%02d",sat.year);
+	sprintf(string,"%02d",sat->year);
 	CopyString(string,line1,18,19);
 
-	sprintf(string,"%12.8f",sat.refepoch);
+	sprintf(string,"%12.8f",sat->refepoch);
 	CopyString(string,line1,20,32);
 
-	sprintf(string,"%.9f",fabs(sat.drag));
+	sprintf(string,"%.9f",fabs(sat->drag));
 
 	CopyString(string,line1,33,42);
 
-	if (sat.drag<0.0)
+	if (sat->drag<0.0)
 		line1[33]='-';
 	else
 		line1[33]=32;
 
-	CopyString(noradEvalue(sat.nddot6),line1,44,51);
-	CopyString(noradEvalue(sat.bstar),line1,53,60);
+	CopyString(noradEvalue(sat->nddot6,output),line1,44,51);
+	CopyString(noradEvalue(sat->bstar,output),line1,53,60);
 
-	sprintf(string,"%4lu",sat.setnum);
+	sprintf(string,"%4lu",sat->setnum);
 	CopyString(string,line1,64,67);
 
-	sprintf(string,"%9.4f",sat.incl);
+	sprintf(string,"%9.4f",sat->incl);
 	CopyString(string,line2,7,15);
 				
-	sprintf(string,"%9.4f",sat.raan);
+	sprintf(string,"%9.4f",sat->raan);
 	CopyString(string,line2,16,24);
 
-	sprintf(string,"%13.12f",sat.eccn);
+	sprintf(string,"%13.12f",sat->eccn);
 	
 	/* Erase eccentricity's decimal point */
 
@@ -2094,16 +2486,16 @@ int x;
 
 	CopyString(string,line2,26,32);
 
-	sprintf(string,"%9.4f",sat.argper);
+	sprintf(string,"%9.4f",sat->argper);
 	CopyString(string,line2,33,41);
 
-	sprintf(string,"%9.5f",sat.meanan);
+	sprintf(string,"%9.5f",sat->meanan);
 	CopyString(string,line2,43,50);
 
-	sprintf(string,"%12.9f",sat.meanmo);
+	sprintf(string,"%12.9f",sat->meanmo);
 	CopyString(string,line2,52,62);
 
-	sprintf(string,"%5lu",sat.orbitnum);
+	sprintf(string,"%5lu",sat->orbitnum);
 	CopyString(string,line2,63,67);
 
 	/* Compute and insert checksum for line 1 and line 2 */
@@ -2119,8 +2511,8 @@ int x;
 	line1[69]=0;
 	line2[69]=0;
 
-	strcpy(sat.line1,line1);
-	strcpy(sat.line2,line2);
+	strcpy(sat->line1,line1);
+	strcpy(sat->line2,line2);
 }
 
 double ReadBearing(char *input)
@@ -2186,60 +2578,60 @@ double ReadBearing(char *input)
 
 	return bearing;
 }
-char ReadTLE(char *line0, char *line1, char *line2)
+char ReadTLE(sat_struct *sat, const char *line0, const char *line1, const char *line2)
 {
     unsigned long la, lb, lc;
     char error_flags,a,b,c,d;
 
-    la = strnlen(line0,sizeof(sat.name));
-    lb = strnlen(line1,sizeof(sat.line1));
-    lc = strnlen(line2,sizeof(sat.line2));
-    a = ((la == 0) || (la >= sizeof(sat.name)));
-    b = ((lb == 0) || (lb >= sizeof(sat.line1)));
-    c = ((lc == 0) || (lc >= sizeof(sat.line2)));
+    la = strnlen(line0,sizeof(sat->name));
+    lb = strnlen(line1,sizeof(sat->line1));
+    lc = strnlen(line2,sizeof(sat->line2));
+    a = ((la == 0) || (la >= sizeof(sat->name)));
+    b = ((lb == 0) || (lb >= sizeof(sat->line1)));
+    c = ((lc == 0) || (lc >= sizeof(sat->line2)));
     d = !KepCheck(line1, line2);
     error_flags = (a << 3) | (b << 2) | (c << 1) | (d << 0);
     if (error_flags == 0)
     {
-        strncpy(sat.name,line0,sizeof(sat.name)-1);
-        strncpy(sat.line1,line1,sizeof(sat.line1)-1);
-        strncpy(sat.line2,line2,sizeof(sat.line2)-1);
-        InternalUpdate(0);
+        strncpy(sat->name,line0,sizeof(sat->name)-1);
+        strncpy(sat->line1,line1,sizeof(sat->line1)-1);
+        strncpy(sat->line2,line2,sizeof(sat->line2)-1);
+        InternalUpdate(sat);
     }
     return error_flags;
                                                                  
 }
 
- char ReadQTH(double lat, double lon, long alt)
+char ReadQTH(context_t *ctx, double lat, double lon, long alt)
 {
     //TODO: add sanity checks
-    qth.stnlat = lat;
-    qth.stnlong = lon;
-    qth.stnalt = alt;
+    ctx->qth.stnlat = lat;
+    ctx->qth.stnlong = lon;
+    ctx->qth.stnalt = alt;
          
-    obs_geodetic.lat=qth.stnlat*deg2rad;
-    obs_geodetic.lon=-qth.stnlong*deg2rad;
-    obs_geodetic.alt=((double)qth.stnalt)/1000.0;
-    obs_geodetic.theta=0.0;
+    ctx->obs_geodetic.lat=ctx->qth.stnlat*deg2rad;
+    ctx->obs_geodetic.lon=-ctx->qth.stnlong*deg2rad;
+    ctx->obs_geodetic.alt=((double)ctx->qth.stnalt)/1000.0;
+    ctx->obs_geodetic.theta=0.0;
     return 0;
 }
 
-char ReadQTHFile()
+char ReadQTHFile(context_t *ctx, const char *qthfile)
 {
     FILE *fd;
     fd=fopen(qthfile,"r");
     if (fd!=NULL)
     {
-        fgets(qth.callsign,16,fd);
-        qth.callsign[strlen(qth.callsign)-1]=0;
-        fscanf(fd,"%lf", &qth.stnlat);
-        fscanf(fd,"%lf", &qth.stnlong);
-        fscanf(fd,"%d", &qth.stnalt);
+        fgets(ctx->qth.callsign,16,fd);
+        ctx->qth.callsign[strlen(ctx->qth.callsign)-1]=0;
+        fscanf(fd,"%lf", &ctx->qth.stnlat);
+        fscanf(fd,"%lf", &ctx->qth.stnlong);
+        fscanf(fd,"%d", &ctx->qth.stnalt);
         fclose(fd);
-        obs_geodetic.lat=qth.stnlat*deg2rad;
-        obs_geodetic.lon=-qth.stnlong*deg2rad;
-        obs_geodetic.alt=((double)qth.stnalt)/1000.0;
-        obs_geodetic.theta=0.0;
+        ctx->obs_geodetic.lat=ctx->qth.stnlat*deg2rad;
+        ctx->obs_geodetic.lon=-ctx->qth.stnlong*deg2rad;
+        ctx->obs_geodetic.alt=((double)ctx->qth.stnalt)/1000.0;
+        ctx->obs_geodetic.theta=0.0;
         return 0;
     }
     return -1;
@@ -2286,7 +2678,7 @@ char CopyFile(char * source, char * destination)
 	return error;
 }
 
-void SaveQTH()
+void SaveQTH(qth_struct *qth, const char *qthfile)
 {
 	/* This function saves QTH data to the QTH data file. */
 
@@ -2294,35 +2686,31 @@ void SaveQTH()
 
 	fd=fopen(qthfile,"w");
 
-	fprintf(fd,"%s\n",qth.callsign);
-	fprintf(fd," %g\n",qth.stnlat);
-	fprintf(fd," %g\n",qth.stnlong);
-	fprintf(fd," %d\n",qth.stnalt);
+	fprintf(fd,"%s\n",qth->callsign);
+	fprintf(fd," %g\n",qth->stnlat);
+	fprintf(fd," %g\n",qth->stnlong);
+	fprintf(fd," %d\n",qth->stnalt);
 
 	fclose(fd);
 }
 
-void SaveTLE()
+void SaveTLE(sat_struct *sat, const char *tlefile)
 {
-	int x;
 	FILE *fd;
 
  	/* Save orbital data to tlefile */
 
 	fd=fopen(tlefile,"w");
 
-	for (x=0; x<24; x++)
-	{
-		/* Convert numeric orbital data to ASCII TLE format */
+	/* Convert numeric orbital data to ASCII TLE format */
 
-		Data2TLE(x);
+	Data2TLE(sat);
 
-		/* Write name, line1, line2 to predict.tle */
+	/* Write name, line1, line2 to predict.tle */
 
-		fprintf(fd,"%s\n", sat.name);  
-		fprintf(fd,"%s\n", sat.line1);
-		fprintf(fd,"%s\n", sat.line2);
-	}
+	fprintf(fd,"%s\n", sat->name);  
+	fprintf(fd,"%s\n", sat->line1);
+	fprintf(fd,"%s\n", sat->line2);
 
 	fclose(fd);
 }
@@ -2369,21 +2757,24 @@ double CurrentDaynum()
 	return ((seconds/86400.0)-3651.0);
 }
 
-char *Daynum2String(daynum)
+char *Daynum2String(daynum,output)
 double daynum;
+char *output;
 {
 	/* This function takes the given epoch as a fractional number of
-	   days since 31Dec79 00:00:00 UTC and returns the corresponding
-	   date as a string of the form "Tue 12Oct99 17:22:37". */
+	   days since 31Dec79 00:00:00 UTC and stores the corresponding
+	   date in the caller's buffer "output" as a string of the form
+	   "Tue 12Oct99 17:22:37". */
 
 	char timestr[26];
+	struct tm tm;
 	time_t t;
 	int x;
 
 	/* Convert daynum to Unix time (seconds since 01-Jan-70) */
 	t=(time_t)(86400.0*(daynum+3651.0));
 
-	sprintf(timestr,"%s",asctime(gmtime(&t)));
+	asctime_r(gmtime_r(&t,&tm),timestr);
 
 	if (timestr[8]==' ')
 		timestr[8]='0';
@@ -2405,7 +2796,8 @@ double daynum;
 	return output;
 }
 
-void FindMoon(daynum)
+void FindMoon(ctx,daynum)
+context_t *ctx;
 double daynum;
 {
 	/* This function determines the position of the moon, including
@@ -2535,7 +2927,7 @@ double daynum;
 
 	b=bt*deg2rad;
 	lm=l*deg2rad;
-	moon_dx=3.0/(pi*p);
+	ctx->moon_dx=3.0/(pi*p);
 
 	/* Semi-diameter calculation */
 	/* sem=10800.0*asin(0.272488*p*deg2rad)/pi; */
@@ -2554,7 +2946,7 @@ double daynum;
 	/* ra = right ascension */
 	/* dec = declination */
 
-	n=qth.stnlat*deg2rad;    /* North latitude of tracking station */
+	n=ctx->qth.stnlat*deg2rad;    /* North latitude of tracking station */
 
 	/* Find siderial time in radians */
 
@@ -2564,14 +2956,14 @@ double daynum;
 	while (teg>360.0)
 		teg-=360.0;
 
-	th=FixAngle((teg-qth.stnlong)*deg2rad);
+	th=FixAngle((teg-ctx->qth.stnlong)*deg2rad);
 	h=th-ra;
 
 	az=atan2(sin(h),cos(h)*sin(n)-tan(dec)*cos(n))+pi;
 	el=asin(sin(n)*sin(dec)+cos(n)*cos(dec)*cos(h));
 
-	moon_az=az/deg2rad;
-	moon_el=el/deg2rad;
+	ctx->moon_az=az/deg2rad;
+	ctx->moon_el=el/deg2rad;
 
 	/* Radial velocity approximation.  This code was derived
 	   from "Amateur Radio Software", by John Morris, GM4ANB,
@@ -2580,23 +2972,24 @@ double daynum;
 	mm=FixAngle(1.319238+daynum*0.228027135);  /* mean moon position */
 	t2=0.10976;
 	t1=mm+t2*sin(mm);
-	dv=0.01255*moon_dx*moon_dx*sin(t1)*(1.0+t2*cos(mm));
+	dv=0.01255*ctx->moon_dx*ctx->moon_dx*sin(t1)*(1.0+t2*cos(mm));
 	dv=dv*4449.0;
 	t1=6378.0;
 	t2=384401.0;
 	t3=t1*t2*(cos(dec)*cos(n)*sin(h));
 	t3=t3/sqrt(t2*t2-t2*t1*sin(el));
-	moon_dv=dv+t3*0.0753125;
+	ctx->moon_dv=dv+t3*0.0753125;
 
-	moon_dec=dec/deg2rad;
-	moon_ra=ra/deg2rad;
-	moon_gha=teg-moon_ra;
+	ctx->moon_dec=dec/deg2rad;
+	ctx->moon_ra=ra/deg2rad;
+	ctx->moon_gha=teg-ctx->moon_ra;
 
-	if (moon_gha<0.0)
-		moon_gha+=360.0;
+	if (ctx->moon_gha<0.0)
+		ctx->moon_gha+=360.0;
 }
 
-void FindSun(daynum)
+void FindSun(ctx,daynum)
+context_t *ctx;
 double daynum;
 {
 	/* This function finds the position of the Sun */
@@ -2616,59 +3009,54 @@ double daynum;
 	/* Solar lat, long, alt vector */
 	geodetic_t solar_latlonalt;
 
+	double jul_utc;
+
 	jul_utc=daynum+2444238.5;
 
 	Calculate_Solar_Position(jul_utc, &solar_vector);
-	Calculate_Obs(jul_utc, &solar_vector, &zero_vector, &obs_geodetic, &solar_set);
-	sun_azi=Degrees(solar_set.x); 
-	sun_ele=Degrees(solar_set.y);
-	sun_range=1.0+((solar_set.z-AU)/AU);
-	sun_range_rate=1000.0*solar_set.w;
+	Calculate_Obs(jul_utc, &solar_vector, &zero_vector, &ctx->obs_geodetic, &solar_set);
+	ctx->sun_azi=Degrees(solar_set.x); 
+	ctx->sun_ele=Degrees(solar_set.y);
+	ctx->sun_range=1.0+((solar_set.z-AU)/AU);
+	ctx->sun_range_rate=1000.0*solar_set.w;
 
 	Calculate_LatLonAlt(jul_utc, &solar_vector, &solar_latlonalt);
 
-	sun_lat=Degrees(solar_latlonalt.lat);
-	sun_lon=360.0-Degrees(solar_latlonalt.lon);
+	ctx->sun_lat=Degrees(solar_latlonalt.lat);
+	ctx->sun_lon=360.0-Degrees(solar_latlonalt.lon);
 
-	Calculate_RADec(jul_utc, &solar_vector, &zero_vector, &obs_geodetic, &solar_rad);
+	Calculate_RADec(jul_utc, &solar_vector, &zero_vector, &ctx->obs_geodetic, &solar_rad);
 
-	sun_ra=Degrees(solar_rad.x);
-	sun_dec=Degrees(solar_rad.y);
+	ctx->sun_ra=Degrees(solar_rad.x);
+	ctx->sun_dec=Degrees(solar_rad.y);
 }
 
-void PreCalc(int x)
+void PreCalc(context_t *ctx)
 {
 	/* This function copies TLE data from PREDICT's sat structure
 	   to the SGP4/SDP4's single dimensioned tle structure, and
 	   prepares the tracking code for the update. */
 
-	strcpy(tle.sat_name,sat.name);
-	strcpy(tle.idesg,sat.designator);
-	tle.catnr=sat.catnum;
-	tle.epoch=(1000.0*(double)sat.year)+sat.refepoch;
-	tle.xndt2o=sat.drag;
-	tle.xndd6o=sat.nddot6;
-	tle.bstar=sat.bstar;
-	tle.xincl=sat.incl;
-	tle.xnodeo=sat.raan;
-	tle.eo=sat.eccn;
-	tle.omegao=sat.argper;
-	tle.xmo=sat.meanan;
-	tle.xno=sat.meanmo;
-	tle.revnum=sat.orbitnum;
-
-	if (sat_db.squintflag)
-	{
-		calc_squint=1;
-		alat=deg2rad*sat_db.alat;
-		alon=deg2rad*sat_db.alon;
-	}
-	else
-		calc_squint=0;
- 
+	vector_t pos, vel;
+
+	strcpy(ctx->tle.sat_name,ctx->sat.name);
+	strcpy(ctx->tle.idesg,ctx->sat.designator);
+	ctx->tle.catnr=ctx->sat.catnum;
+	ctx->tle.epoch=(1000.0*(double)ctx->sat.year)+ctx->sat.refepoch;
+	ctx->tle.xndt2o=ctx->sat.drag;
+	ctx->tle.xndd6o=ctx->sat.nddot6;
+	ctx->tle.bstar=ctx->sat.bstar;
+	ctx->tle.xincl=ctx->sat.incl;
+	ctx->tle.xnodeo=ctx->sat.raan;
+	ctx->tle.eo=ctx->sat.eccn;
+	ctx->tle.omegao=ctx->sat.argper;
+	ctx->tle.xmo=ctx->sat.meanan;
+	ctx->tle.xno=ctx->sat.meanmo;
+	ctx->tle.revnum=ctx->sat.orbitnum;
+
 	/* Clear all flags */
 
-	ClearFlag(ALL_FLAGS);
+	ClearFlag(ctx, ALL_FLAGS);
 
 	/* Select ephemeris type.  This function will set or clear the
 	   DEEP_SPACE_EPHEM_FLAG depending on the TLE parameters of the
@@ -2676,10 +3064,54 @@ void PreCalc(int x)
 	   ephemeris functions SGP4 or SDP4, so this function must
 	   be called each time a new tle set is used. */
 
-	select_ephemeris(&tle);
+	select_ephemeris(ctx);
+
+	/* Run the SGP4/SDP4 initialization now rather than on the
+	   first Calc(), so that afterwards the context only needs
+	   ResetDeep() before it is propagated again.  A copy of it
+	   can then be used from any thread. */
+
+	if (isFlagSet(ctx, DEEP_SPACE_EPHEM_FLAG))
+		SDP4(ctx, 0.0, &pos, &vel);
+	else
+		SGP4(ctx, 0.0, &pos, &vel);
 }
 
-void Calc()
+void Propagate(context_t *ctx, vector_t *pos, vector_t *vel)
+{
+	/* Propagates the satellite to ctx->daynum and returns its  */
+	/* ECI position (km) and velocity (km/s), without observing */
+	/* it from anywhere.  Calc() starts from this.              */
+
+	ctx->jul_utc=ctx->daynum+2444238.5;
+
+	/* Convert satellite's epoch time to Julian  */
+	/* and calculate time since epoch in minutes */
+
+	ctx->jul_epoch=Julian_Date_of_Epoch(ctx->tle.epoch);
+	ctx->tsince=(ctx->jul_utc-ctx->jul_epoch)*xmnpda;
+	ctx->age=ctx->jul_utc-ctx->jul_epoch;
+
+	/* Copy the ephemeris type in use to ephem string. */
+
+		if (isFlagSet(ctx, DEEP_SPACE_EPHEM_FLAG))
+			strcpy(ctx->ephem,"SDP4");
+		else
+			strcpy(ctx->ephem,"SGP4");
+
+	/* Call NORAD routines according to deep-space flag. */
+
+	if (isFlagSet(ctx, DEEP_SPACE_EPHEM_FLAG))
+		SDP4(ctx, ctx->tsince, pos, vel);
+	else
+		SGP4(ctx, ctx->tsince, pos, vel);
+
+	/* Scale position and velocity vectors to km and km/sec */
+
+	Convert_Sat_State(pos, vel);
+}
+
+void Calc(context_t *ctx)
 {
 	/* This is the stuff we need to do repetitively while tracking. */
 
@@ -2702,143 +3134,124 @@ void Calc()
 	/* Satellite's predicted geodetic position */
 	geodetic_t sat_geodetic;
 
-	jul_utc=daynum+2444238.5;
-
-	/* Convert satellite's epoch time to Julian  */
-	/* and calculate time since epoch in minutes */
-
-	jul_epoch=Julian_Date_of_Epoch(tle.epoch);
-	tsince=(jul_utc-jul_epoch)*xmnpda;
-	age=jul_utc-jul_epoch;
-
-	/* Copy the ephemeris type in use to ephem string. */
-
-		if (isFlagSet(DEEP_SPACE_EPHEM_FLAG))
-			strcpy(ephem,"SDP4");
-		else
-			strcpy(ephem,"SGP4");
-
-	/* Call NORAD routines according to deep-space flag. */
-
-	if (isFlagSet(DEEP_SPACE_EPHEM_FLAG))
-		SDP4(tsince, &tle, &pos, &vel);
-	else
-		SGP4(tsince, &tle, &pos, &vel);
-
-	/* Scale position and velocity vectors to km and km/sec */
-
-	Convert_Sat_State(&pos, &vel);
+	Propagate(ctx, &pos, &vel);
 
 	/* Calculate velocity of satellite */
 
 	Magnitude(&vel);
-	sat_vel=vel.w;
+	ctx->sat_vel=vel.w;
     
     
-    sat.x = pos.x;
-    sat.y = pos.y;
-    sat.z = pos.z;
-    sat.x_vel = vel.x;
-    sat.y_vel = vel.y;
-    sat.z_vel = vel.z;
+    ctx->sat.x = pos.x;
+    ctx->sat.y = pos.y;
+    ctx->sat.z = pos.z;
+    ctx->sat.x_vel = vel.x;
+    ctx->sat.y_vel = vel.y;
+    ctx->sat.z_vel = vel.z;
     
 
 	/** All angles in rads. Distance in km. Velocity in km/s **/
 	/* Calculate satellite Azi, Ele, Range and Range-rate */
 
-	Calculate_Obs(jul_utc, &pos, &vel, &obs_geodetic, &obs_set);
+	Calculate_Obs(ctx->jul_utc, &pos, &vel, &ctx->obs_geodetic, &obs_set);
 
-	/* Calculate satellite Lat North, Lon East and Alt. */
+	/* Convert satellite data */
+	ctx->sat_azi=Degrees(obs_set.x);
+	ctx->sat_ele=Degrees(obs_set.y);
+	ctx->sat_range=obs_set.z;
+	ctx->sat_range_rate=obs_set.w;
 
-	Calculate_LatLonAlt(jul_utc, &pos, &sat_geodetic);
+	ctx->rv=(long)floor((ctx->tle.xno*xmnpda/twopi+ctx->age*ctx->tle.bstar*ae)*ctx->age+ctx->tle.xmo/twopi)+ctx->tle.revnum;
 
-	/* Calculate squint angle */
+	ctx->irk=(long)rint(ctx->sat_range);
+	ctx->iaz=(int)rint(ctx->sat_azi);
+	ctx->iel=(int)rint(ctx->sat_ele);
+	ctx->ma256=(int)rint(256.0*(ctx->phase/twopi));
 
-	if (calc_squint)
-		squint=(acos(-(ax*rx+ay*ry+az*rz)/obs_set.z))/deg2rad;
+	/* The rest can be skipped by callers that only need */
+	/* to know where to point, setting the SKIP flags.    */
 
-	/* Calculate solar position and satellite eclipse depth. */
-	/* Also set or clear the satellite eclipsed flag accordingly. */
+	if (isFlagClear(ctx, SKIP_GEODETIC_FLAG))
+	{
+		/* Calculate satellite Lat North, Lon East and Alt. */
 
-	Calculate_Solar_Position(jul_utc, &solar_vector);
-	Calculate_Obs(jul_utc, &solar_vector, &zero_vector, &obs_geodetic, &solar_set);
+		Calculate_LatLonAlt(ctx->jul_utc, &pos, &sat_geodetic);
 
-	if (Sat_Eclipsed(&pos, &solar_vector, &eclipse_depth))
-		SetFlag(SAT_ECLIPSED_FLAG);
-	else
-		ClearFlag(SAT_ECLIPSED_FLAG);
+		ctx->sat_lat=Degrees(sat_geodetic.lat);
+		ctx->sat_lon=Degrees(sat_geodetic.lon);
+		ctx->sat_alt=sat_geodetic.alt;
 
-	if (isFlagSet(SAT_ECLIPSED_FLAG))
-		sat_sun_status=0;  /* Eclipse */
-	else
-		sat_sun_status=1; /* In sunlight */
+		ctx->fk=12756.33*acos(xkmper/(xkmper+ctx->sat_alt));
+		ctx->fm=ctx->fk/1.609344;
 
-	/* Convert satellite and solar data */
-	sat_azi=Degrees(obs_set.x);
-	sat_ele=Degrees(obs_set.y);
-	sat_range=obs_set.z;
-	sat_range_rate=obs_set.w;
-	sat_lat=Degrees(sat_geodetic.lat);
-	sat_lon=Degrees(sat_geodetic.lon);
-	sat_alt=sat_geodetic.alt;
+		ctx->isplat=(int)rint(ctx->sat_lat);
+		ctx->isplong=(int)rint(360.0-ctx->sat_lon);
+	}
 
-	fk=12756.33*acos(xkmper/(xkmper+sat_alt));
-	fm=fk/1.609344;
+	if (isFlagClear(ctx, SKIP_SOLAR_FLAG))
+	{
+		/* Calculate solar position and satellite eclipse depth. */
+		/* Also set or clear the satellite eclipsed flag accordingly. */
 
-	rv=(long)floor((tle.xno*xmnpda/twopi+age*tle.bstar*ae)*age+tle.xmo/twopi)+tle.revnum;
+		Calculate_Solar_Position(ctx->jul_utc, &solar_vector);
+		Calculate_Obs(ctx->jul_utc, &solar_vector, &zero_vector, &ctx->obs_geodetic, &solar_set);
+
+		if (Sat_Eclipsed(&pos, &solar_vector, &ctx->eclipse_depth))
+			SetFlag(ctx, SAT_ECLIPSED_FLAG);
+		else
+			ClearFlag(ctx, SAT_ECLIPSED_FLAG);
 
-	sun_azi=Degrees(solar_set.x); 
-	sun_ele=Degrees(solar_set.y);
+		if (isFlagSet(ctx, SAT_ECLIPSED_FLAG))
+			ctx->sat_sun_status=0;  /* Eclipse */
+		else
+			ctx->sat_sun_status=1; /* In sunlight */
 
-	irk=(long)rint(sat_range);
-	isplat=(int)rint(sat_lat);
-	isplong=(int)rint(360.0-sat_lon);
-	iaz=(int)rint(sat_azi);
-	iel=(int)rint(sat_ele);
-	ma256=(int)rint(256.0*(phase/twopi));
+		ctx->sun_azi=Degrees(solar_set.x); 
+		ctx->sun_ele=Degrees(solar_set.y);
 
-	if (sat_sun_status)
-	{
-		if (sun_ele<=-12.0 && rint(sat_ele)>=0.0)
-			findsun='+';
+		if (ctx->sat_sun_status)
+		{
+			if (ctx->sun_ele<=-12.0 && rint(ctx->sat_ele)>=0.0)
+				ctx->findsun='+';
+			else
+				ctx->findsun='*';
+		}
 		else
-			findsun='*';
+			ctx->findsun=' ';
 	}
-	else
-		findsun=' ';
 }
 
-char AosHappens(x)
-int x;
+char AosHappens(ctx)
+context_t *ctx;
 {
-	/* This function returns a 1 if the satellite pointed to by
-	   "x" can ever rise above the horizon of the ground station. */
+	/* This function returns a 1 if the satellite in "ctx"
+	   can ever rise above the horizon of the ground station. */
 
 	double lin, sma, apogee;
 
-	if (sat.meanmo==0.0)
+	if (ctx->sat.meanmo==0.0)
 		return 0;
 	else
 	{
-		lin=sat.incl;
+		lin=ctx->sat.incl;
 
 		if (lin>=90.0)
 			lin=180.0-lin;
 
-		sma=331.25*exp(log(1440.0/sat.meanmo)*(2.0/3.0));
-		apogee=sma*(1.0+sat.eccn)-xkmper;
+		sma=331.25*exp(log(1440.0/ctx->sat.meanmo)*(2.0/3.0));
+		apogee=sma*(1.0+ctx->sat.eccn)-xkmper;
 
-		if ((acos(xkmper/(apogee+xkmper))+(lin*deg2rad)) > fabs(qth.stnlat*deg2rad))
+		if ((acos(xkmper/(apogee+xkmper))+(lin*deg2rad)) > fabs(ctx->qth.stnlat*deg2rad))
 			return 1;
 		else
 			return 0;
 	}
 }
 
-char Decayed(int x,double time)
+char Decayed(context_t *ctx,double time)
 {
 	/* This function returns a 1 if it appears that the
-	   satellite pointed to by 'x' has decayed at the
+	   satellite in 'ctx' has decayed at the
 	   time of 'time'.  If 'time' is 0.0, then the
 	   current date/time is used. */
 
@@ -2847,107 +3260,299 @@ char Decayed(int x,double time)
 	if (time==0.0)
 		time=CurrentDaynum();
 
-	satepoch=DayNum(1,0,sat.year)+sat.refepoch;
+	satepoch=DayNum(1,0,ctx->sat.year)+ctx->sat.refepoch;
 
-	if (satepoch+((16.666666-sat.meanmo)/(10.0*fabs(sat.drag))) < time)
+	if (satepoch+((16.666666-ctx->sat.meanmo)/(10.0*fabs(ctx->sat.drag))) < time)
 		return 1;
 	else
 		return 0;
 }
 
-char Geostationary(int x)
+char Geostationary(context_t *ctx)
 {
-	/* This function returns a 1 if the satellite pointed
-	   to by "x" appears to be in a geostationary orbit */
+	/* This function returns a 1 if the satellite in
+	   "ctx" appears to be in a geostationary orbit */
 
-	if (fabs(sat.meanmo-1.0027)<0.0002) 
+	if (fabs(ctx->sat.meanmo-1.0027)<0.0002) 
 
 		return 1;
 	else
 		return 0;
 }
 
-double FindAOS()
+double Step_Clear(context_t *ctx)
+{
+	/* Returns a step (days) that gets the satellite in "ctx" closer
+	   to the horizon without jumping over a pass: a coarse one while
+	   it is well below it, otherwise the step Predict mode takes
+	   through a pass. */
+
+	if (ctx->sat_ele<-1.0)
+		return 0.00035*(2.0-ctx->sat_ele*((ctx->sat_alt/8400.0)+0.46));
+	else
+		return cos((ctx->sat_ele-1.0)*deg2rad)*sqrt(ctx->sat_alt)/25000.0;
+}
+
+double Calc_At(context_t *ctx, double daynum, int skip)
 {
-	/* This function finds and returns the time of AOS (aostime). */
+	/* Calculates the satellite in "ctx" at "daynum" afresh, with
+	   the deep-space caches reset as for an observation, counts
+	   it in ctx->evaluations and returns its elevation.  "skip"
+	   holds SKIP flags for stages of Calc() to leave out, on top
+	   of any already set in "ctx". */
 
-	aostime=0.0;
+	int skipped=ctx->flags&SKIP_FLAGS;
 
-	if (AosHappens(indx) && Geostationary(indx)==0 && Decayed(indx,daynum)==0)
+	ctx->daynum=daynum;
+	ResetDeep(ctx);
+	SetFlag(ctx, skip);
+	Calc(ctx);
+	ClearFlag(ctx, skip&~skipped);
+	ctx->evaluations++;
+
+	return ctx->sat_ele;
+}
+
+double FindCrossing(context_t *ctx, double below, double ele_below, double above, double ele_above)
+{
+	/* This function finds the time the satellite in "ctx" crosses
+	   the horizon between "below" and "above", at which its
+	   elevations are "ele_below" (negative) and "ele_above" (zero
+	   or more).  It is the Illinois variant of regula falsi, and
+	   returns the end of the remaining bracket that is at or above
+	   the horizon once it is narrower than ctx->tolerance, leaving
+	   the satellite calculated there by Calc_At(). */
+
+	double tolerance, t, ele;
+	int side=0;
+
+	tolerance=ctx->tolerance>0.0 ? ctx->tolerance : HORIZON_TOLERANCE;
+
+	while (fabs(above-below)>tolerance && ctx->evaluations<MAX_EVALUATIONS)
 	{
-		Calc();
+		t=(below*ele_above-above*ele_below)/(ele_above-ele_below);
+
+		/* Keep at least half the tolerance from either end,
+		   so that the bracket keeps shrinking from both. */
+
+		if (fabs(t-below)<0.5*tolerance)
+			t=below+0.5*tolerance*Sign(above-below);
 
-		/* Get the satellite in range */
+		else if (fabs(above-t)<0.5*tolerance)
+			t=above-0.5*tolerance*Sign(above-below);
 
-		while (sat_ele<-1.0)
+		ele=Calc_At(ctx,t,SKIP_GEODETIC_FLAG|SKIP_SOLAR_FLAG);
+
+		if (ele>=0.0)
 		{
-			daynum-=0.00035*(sat_ele*((sat_alt/8400.0)+0.46)-2.0);
-			Calc();
+			above=t;
+			ele_above=ele;
+
+			if (side==1)
+				ele_below*=0.5;
+			side=1;
 		}
+		else
+		{
+			below=t;
+			ele_below=ele;
+
+			if (side==-1)
+				ele_above*=0.5;
+			side=-1;
+		}
+	}
+
+	/* Only the elevation was needed until now */
+
+	Calc_At(ctx,above,0);
+
+	return above;
+}
+
+double FindAOS(context_t *ctx)
+{
+	/* This function finds and returns the time of AOS (aostime):
+	   that of the pass in progress at ctx->daynum, or else of the
+	   next one.  It is within ctx->tolerance after the satellite
+	   rises, and ctx->evaluations is set to the number of Calc()
+	   calls it took.  Zero is returned if there is no AOS to find. */
+
+	double t, ele;
+
+	ctx->aostime=0.0;
+	ctx->evaluations=0;
+
+	if (AosHappens(ctx) && Geostationary(ctx)==0 && Decayed(ctx,ctx->daynum)==0)
+	{
+		Calc(ctx);
+		ctx->evaluations++;
+
+		t=ctx->daynum;
+		ele=ctx->sat_ele;
 
-		/* Find AOS */
+		/* Bracket the rise, stepping back through a pass in
+		   progress or forward until the satellite is up. */
 
-		while (aostime==0.0)
+		if (ctx->sat_ele>=0.0)
 		{
-			if (fabs(sat_ele)<0.03)
-				aostime=daynum;
-			else
+			while (ctx->sat_ele>=0.0 && ctx->evaluations<MAX_EVALUATIONS)
+			{
+				t=ctx->daynum;
+				ele=ctx->sat_ele;
+				ctx->daynum-=Step_Clear(ctx);
+				Calc(ctx);
+				ctx->evaluations++;
+			}
+
+			if (ctx->sat_ele<0.0)
+				ctx->aostime=FindCrossing(ctx,ctx->daynum,ctx->sat_ele,t,ele);
+		}
+		else
+		{
+			while (ctx->sat_ele<0.0 && ctx->evaluations<MAX_EVALUATIONS)
 			{
-				daynum-=sat_ele*sqrt(sat_alt)/530000.0;
-				Calc();
+				t=ctx->daynum;
+				ele=ctx->sat_ele;
+				ctx->daynum+=Step_Clear(ctx);
+				Calc(ctx);
+				ctx->evaluations++;
 			}
+
+			if (ctx->sat_ele>=0.0)
+				ctx->aostime=FindCrossing(ctx,t,ele,ctx->daynum,ctx->sat_ele);
 		}
 	}
 
-	return aostime;
+	return ctx->aostime;
 }
 
-double FindLOS()
+double FindLOS(context_t *ctx)
 {
-	lostime=0.0;
+	/* This function finds and returns the time of LOS (lostime):
+	   that of the pass in progress at ctx->daynum, or else of the
+	   last one.  It is within ctx->tolerance before the satellite
+	   sets, and ctx->evaluations is set to the number of Calc()
+	   calls it took.  Zero is returned if there is no LOS to find. */
 
-	if (Geostationary(indx)==0 && AosHappens(indx)==1 && Decayed(indx,daynum)==0)
+	double t, ele;
+
+	ctx->lostime=0.0;
+	ctx->evaluations=0;
+
+	if (Geostationary(ctx)==0 && AosHappens(ctx)==1 && Decayed(ctx,ctx->daynum)==0)
 	{
-		Calc();
+		Calc(ctx);
+		ctx->evaluations++;
 
-		do
+		t=ctx->daynum;
+		ele=ctx->sat_ele;
+
+		/* Bracket the set, stepping forward through a pass in
+		   progress or back until the satellite is up. */
+
+		if (ctx->sat_ele>=0.0)
 		{
-			daynum+=sat_ele*sqrt(sat_alt)/502500.0;
-			Calc();
+			while (ctx->sat_ele>=0.0 && ctx->evaluations<MAX_EVALUATIONS)
+			{
+				t=ctx->daynum;
+				ele=ctx->sat_ele;
+				ctx->daynum+=Step_Clear(ctx);
+				Calc(ctx);
+				ctx->evaluations++;
+			}
 
-			if (fabs(sat_ele) < 0.03)
-				lostime=daynum;
+			if (ctx->sat_ele<0.0)
+				ctx->lostime=FindCrossing(ctx,ctx->daynum,ctx->sat_ele,t,ele);
+		}
+		else
+		{
+			while (ctx->sat_ele<0.0 && ctx->evaluations<MAX_EVALUATIONS)
+			{
+				t=ctx->daynum;
+				ele=ctx->sat_ele;
+				ctx->daynum-=Step_Clear(ctx);
+				Calc(ctx);
+				ctx->evaluations++;
+			}
 
-		} while (lostime==0.0);
+			if (ctx->sat_ele>=0.0)
+				ctx->lostime=FindCrossing(ctx,t,ele,ctx->daynum,ctx->sat_ele);
+		}
 	}
 
-	return lostime;
+	return ctx->lostime;
+}
+
+double FindPeak(context_t *ctx, double left, double right)
+{
+	/* This function finds the time of maximum elevation of the
+	   satellite in "ctx" between "left" and "right", over which
+	   the elevation must rise and then fall (or only do one of
+	   the two), by golden-section search.  The time returned is
+	   within ctx->tolerance of the peak, with the satellite left
+	   calculated there, and ctx->evaluations is set to the number
+	   of Calc() calls it took. */
+
+	double tolerance, a, b, ele_a, ele_b;
+
+	tolerance=ctx->tolerance>0.0 ? ctx->tolerance : HORIZON_TOLERANCE;
+	ctx->evaluations=0;
+
+	a=right-GOLDEN_SECTION*(right-left);
+	b=left+GOLDEN_SECTION*(right-left);
+	ele_a=Calc_At(ctx,a,SKIP_GEODETIC_FLAG|SKIP_SOLAR_FLAG);
+	ele_b=Calc_At(ctx,b,SKIP_GEODETIC_FLAG|SKIP_SOLAR_FLAG);
+
+	while (right-left>tolerance && ctx->evaluations<MAX_EVALUATIONS)
+	{
+		if (ele_a<ele_b)
+		{
+			left=a;
+			a=b;
+			ele_a=ele_b;
+			b=left+GOLDEN_SECTION*(right-left);
+			ele_b=Calc_At(ctx,b,SKIP_GEODETIC_FLAG|SKIP_SOLAR_FLAG);
+		}
+		else
+		{
+			right=b;
+			b=a;
+			ele_b=ele_a;
+			a=right-GOLDEN_SECTION*(right-left);
+			ele_a=Calc_At(ctx,a,SKIP_GEODETIC_FLAG|SKIP_SOLAR_FLAG);
+		}
+	}
+
+	Calc_At(ctx,0.5*(left+right),0);
+
+	return ctx->daynum;
 }
 
-double FindLOS2()
+double FindLOS2(context_t *ctx)
 {
 	/* This function steps through the pass to find LOS.
 	   FindLOS() is called to "fine tune" and return the result. */
 
 	do
 	{
-		daynum+=cos((sat_ele-1.0)*deg2rad)*sqrt(sat_alt)/25000.0;
-		Calc();
+		ctx->daynum+=cos((ctx->sat_ele-1.0)*deg2rad)*sqrt(ctx->sat_alt)/25000.0;
+		Calc(ctx);
 
-	} while (sat_ele>=0.0);
+	} while (ctx->sat_ele>=0.0);
 
-	return(FindLOS());
+	return(FindLOS(ctx));
 }
 
-double NextAOS()
+double NextAOS(context_t *ctx)
 {
 	/* This function finds and returns the time of the next
 	   AOS for a satellite that is currently in range. */
 
-	aostime=0.0;
+	ctx->aostime=0.0;
 
-	if (AosHappens(indx) && Geostationary(indx)==0 && Decayed(indx,daynum)==0)
-		daynum=FindLOS2()+0.014;  /* Move to LOS + 20 minutes */
+	if (AosHappens(ctx) && Geostationary(ctx)==0 && Decayed(ctx,ctx->daynum)==0)
+		ctx->daynum=FindLOS2(ctx)+0.014;  /* Move to LOS + 20 minutes */
 
-	return (FindAOS());
+	return (FindAOS(ctx));
 }
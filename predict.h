@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <pthread.h>
 
 #define VERSION "2.2.3"
 
@@ -95,6 +96,12 @@
 #define dpsec    2 /* Deep-space secular code        */
 #define dpper    3 /* Deep-space periodic code       */
 
+/* Horizon crossings found by FindAOS() and FindLOS(), and peaks by FindPeak() */
+
+#define HORIZON_TOLERANCE  1.1574074E-6  /* Default time tolerance, 0.1s in days */
+#define MAX_EVALUATIONS    100000        /* Calc() calls before giving up        */
+#define GOLDEN_SECTION     0.61803398874989485  /* (sqrt(5)-1)/2, for FindPeak() */
+
 /* Flow control flag definitions */
 
 #define ALL_FLAGS              -1
@@ -113,6 +120,11 @@
 #define EPOCH_RESTART_FLAG     0x001000
 #define VISIBLE_FLAG           0x002000
 #define SAT_ECLIPSED_FLAG      0x004000
+#define SKIP_GEODETIC_FLAG     0x008000 /* Calc() leaves lat, lon, alt and footprint */
+#define SKIP_SOLAR_FLAG        0x010000 /* Calc() leaves the sun and eclipse        */
+#define SKIP_DECAYED_FLAG      0x020000 /* MakeObservation() leaves decayed         */
+#define SKIP_FLAGS             (SKIP_GEODETIC_FLAG|SKIP_SOLAR_FLAG|SKIP_DECAYED_FLAG)
+#define INCREMENTAL_FLAG       0x040000 /* SGP4()/SDP4() step on from the last call */
 
 /*
   TODO: This is a refactoring hack to ensure we get consistent before/after
@@ -162,6 +174,7 @@ typedef struct observation {
     double x_vel;
     double y_vel;
     double z_vel;
+    int skipped;  // SKIP_*_FLAG stages that weren't worked out, so whose fields are meaningless
 } observation;
 
 typedef struct sat_struct{
@@ -195,8 +208,6 @@ typedef struct sat_struct{
 
 } sat_struct;
 
-extern sat_struct sat;
-
 typedef struct qth_struct {
        char callsign[17];    // Observation Position Call Sign
        double stnlat;        // Observation Position Latitude
@@ -204,44 +215,7 @@ typedef struct qth_struct {
        int stnalt;           // Observation Position Altitude
 } qth_struct;
 
-extern qth_struct qth;
-
-// TODO: sat_db doesn't seem to be used much.  Verify it functions and annotate.
-typedef struct sat_db_struct {  
-       char name[25];
-       long catnum;
-       char squintflag;
-       double alat;
-       double alon;
-       unsigned char transponders;
-       char transponder_name[10][80];
-       double uplink_start[10];
-       double uplink_end[10];
-       double downlink_start[10];
-       double downlink_end[10];
-       unsigned char dayofweek[10];
-       int phase_start[10];
-       int phase_end[10];
-} sat_db_struct;
-
-extern sat_db_struct sat_db;
-
-/* Global variables for sharing data among functions... */
-
-extern double  tsince, jul_epoch, jul_utc, eclipse_depth,
-    sat_azi, sat_ele, sat_range, sat_range_rate,
-    sat_lat, sat_lon, sat_alt, sat_vel, phase,
-    sun_azi, sun_ele, daynum, fm, fk, age, aostime,
-    lostime, ax, ay, az, rx, ry, rz, squint, alat, alon,
-    sun_ra, sun_dec, sun_lat, sun_lon, sun_range, sun_range_rate,
-    moon_az, moon_el, moon_dx, moon_ra, moon_dec, moon_gha, moon_dv;
-
-extern char    qthfile[50], tlefile[50], dbfile[50], temp[80], output[25],
-    ephem[5], sat_sun_status, findsun, calc_squint;
-
-extern int indx, iaz, iel, ma256, isplat, isplong, Flags;
-
-extern long    rv, irk;
+/* Translation table for computing TLE checksums */
 
 extern unsigned char val[256];
 
@@ -263,12 +237,27 @@ typedef struct  {
            double lat, lon, alt, theta;
         }  geodetic_t;
 
+/* A ground station along with the parts of its ECI position that
+   don't change with time, set up by Prepare_Station(). */
+
+typedef struct  {
+           geodetic_t  geodetic;
+           double  sin_lat, cos_lat, achcp, z;
+        }  station_t;
+
 /* General three-dimensional vector structure used by SGP4/SDP4 code. */
 
 typedef struct  {
            double x, y, z, w;
         }  vector_t;
 
+/* Where a station_t is, in ECI coordinates, at one moment. */
+
+typedef struct  {
+           double  sin_theta, cos_theta;
+           vector_t  pos, vel;
+        }  station_eci_t;
+
 /* Common arguments between deep-space functions used by SGP4/SDP4 code. */
 
 typedef struct  {
@@ -283,20 +272,142 @@ typedef struct  {
            double  ds50;
         }  deep_arg_t;
 
-/* Global structure used by SGP4/SDP4 code. */
+/* Constants computed by the initialization block of SGP4(). */
 
-extern geodetic_t obs_geodetic;
+typedef struct  {
+           double  aodp, aycof, c1, c4, c5, cosio, d2, d3, d4, delmo,
+               omgcof, eta, omgdot, sinio, xnodp, sinmo, t2cof, t3cof,
+               t4cof, t5cof, x1mth2, x3thm1, x7thm1, xmcof, xmdot, xnodcf,
+               xnodot, xlcof;
+        }  sgp4_t;
+
+/* The resonance integrator of the dpsec part of Deep() steps out from
+   epoch half a day at a time.  Every DEEP_CHECKPOINT_STEPS steps out it
+   keeps its state in the slot of a deep_checkpoints_t for that time, so
+   that the next time it would start out from epoch it can start from
+   the kept slot nearest the time wanted instead, and come to exactly
+   the same result.  There are slots for DEEP_CHECKPOINT_BLOCKS blocks of
+   DEEP_CHECKPOINT_BLOCK checkpoints each way, a little over a year,
+   and blocks are allocated as they are first reached.  The table is
+   shared by every copy of a context, from any thread: blocks and slots
+   are written once, with atomic stores, and never move.  A context
+   without one (deep_t.kept NULL) keeps no checkpoints. */
+
+#define DEEP_CHECKPOINT_STEPS  4
+#define DEEP_CHECKPOINT_BLOCK  16
+#define DEEP_CHECKPOINT_BLOCKS 12
+
+typedef struct  {
+           double  atime, xli, xni;
+        }  deep_checkpoint_t;
+
+typedef struct  {
+           deep_checkpoint_t  checkpoint[DEEP_CHECKPOINT_BLOCK];
+           int  kept[DEEP_CHECKPOINT_BLOCK];  /* 0 empty, 1 being kept, 2 kept */
+        }  deep_checkpoint_block_t;
 
-/* Two-line Orbital Elements for the satellite used by SGP4/SDP4 code. */
+typedef struct deep_checkpoints  {
+           deep_checkpoint_block_t  *block[2][DEEP_CHECKPOINT_BLOCKS];  /* after, before epoch */
+           struct deep_checkpoints  *next;  /* for owners to chain retired tables */
+        }  deep_checkpoints_t;
 
-extern tle_t tle;
+/* The dpper part of Deep() keeps the lunar-solar periodics it works out
+   and reuses them until the time asked for is 30 minutes away, as
+   predict did, which on a Molniya orbit is worth up to 100 m.  With
+   INCREMENTAL_FLAG set it reuses them for this many minutes instead:
+   still most of the saving for a sweep a few seconds a step, and well
+   inside what solving Kepler's equation to e6a leaves.  ResetDeep()
+   discards them. */
+
+#define DEEP_PERIODICS_REUSE   2.0
+
+/* Lunar-solar terms computed by the dpinit part of Deep(), along with
+   the state of the resonance integrator used by the dpsec part. */
+
+typedef struct  {
+           double  thgr, xnq, xqncl, omegaq, zmol, zmos, savtsn, ee2, e3,
+               xi2, xl2, xl3, xl4, xgh2, xgh3, xgh4, xh2, xh3, sse, ssi,
+               ssg, xi3, se2, si2, sl2, sgh2, sh2, se3, si3, sl3, sgh3,
+               sh3, sl4, sgh4, ssl, ssh, d3210, d3222, d4410, d4422,
+               d5220, d5232, d5421, d5433, del1, del2, del3, fasx2, fasx4,
+               fasx6, xlamo, xfact, xni, atime, stepp, stepn, step2, preep,
+               pl, sghs, xli, d2201, d2211, sghl, sh1, pinc, pe, shs,
+               zsingl, zcosgl, zsinhl, zcoshl, zsinil, zcosil;
+           deep_checkpoints_t  *kept;
+        }  deep_t;
+
+/* Constants computed by the initialization block of SDP4(). */
+
+typedef struct  {
+           double  x3thm1, c1, x1mth2, c4, xnodcf, t2cof, xlcof, aycof,
+               x7thm1;
+           deep_arg_t  deep_arg;
+           deep_t  deep;
+        }  sdp4_t;
+
+/* The solution of Kepler's equation found by the last call to SGP4()
+   or SDP4(): the mean anomaly capu, the eccentric anomaly less it, and
+   the rate at which that offset changes with capu, e cos(E)/(1-e cos(E)).
+   With INCREMENTAL_FLAG set, the next call starts its Newton iteration
+   from the first order prediction these give rather than from capu, as
+   long as the mean anomaly has moved on less than KEPLER_WARM_START
+   radians since and the prediction saves an iteration, which for near
+   circular orbits it only does at steps of seconds.  It stops at the
+   same e6a convergence test, and the position is worked out from the
+   iterate before the last correction, so it agrees with a cold start to
+   within e6a radians of eccentric anomaly, 1.1e-6 of the semi-major
+   axis: 8 m in low earth orbit, 30 m for half-day orbits such as GPS
+   and Molniya, 47 m at geostationary (test_incremental.py). */
+
+#define KEPLER_WARM_START      0.1
+
+typedef struct  {
+           double  tsince, capu, offset, slope;
+        }  kepler_t;
+
+/* Everything the tracking code needs to follow one satellite from one
+   ground station.  predict kept all of this in globals and function
+   statics; keeping it in a context instead lets any number of
+   satellites be tracked at once, each from its own thread. */
+
+typedef struct context {
+           sat_struct  sat;
+           qth_struct  qth;
+
+           /* SGP4/SDP4 state, set up by PreCalc() */
+           tle_t  tle;
+           geodetic_t  obs_geodetic;
+           int  flags;
+           sgp4_t  sgp4;
+           sdp4_t  sdp4;
+           kepler_t  kepler;
+
+           /* Time of interest and results of Calc() */
+           double  daynum, tsince, jul_epoch, jul_utc, age, eclipse_depth,
+               sat_azi, sat_ele, sat_range, sat_range_rate, sat_lat,
+               sat_lon, sat_alt, sat_vel, phase, sun_azi, sun_ele, fk, fm;
+           long  rv, irk;
+           int  iaz, iel, ma256, isplat, isplong;
+           char  ephem[5], sat_sun_status, findsun;
+
+           /* Results of FindAOS() and FindLOS(), the time tolerance */
+           /* (days, 0 for HORIZON_TOLERANCE) they and FindPeak()    */
+           /* work to and the number of Calc() calls the last took   */
+           double  aostime, lostime, tolerance;
+           long  evaluations;
+
+           /* Results of FindSun() and FindMoon() */
+           double  sun_ra, sun_dec, sun_lat, sun_lon, sun_range,
+               sun_range_rate, moon_az, moon_el, moon_dx, moon_ra, moon_dec,
+               moon_gha, moon_dv;
+        }  context_t;
 
 /* Functions for testing and setting/clearing flags used in SGP4/SDP4 code */
 
-int isFlagSet(int flag);
-int isFlagClear(int flag);
-void SetFlag(int flag);
-void ClearFlag(int flag);
+int isFlagSet(context_t *ctx, int flag);
+int isFlagClear(context_t *ctx, int flag);
+void SetFlag(context_t *ctx, int flag);
+void ClearFlag(context_t *ctx, int flag);
 
 /* Remaining SGP4/SDP4 code follows... */
 int Sign(double arg);
@@ -335,15 +446,23 @@ double ThetaG(double epoch, deep_arg_t *deep_arg);
 double ThetaG_JD(double jd);
 void Calculate_Solar_Position(double time, vector_t *solar_vector);
 int Sat_Eclipsed(vector_t *pos, vector_t *sol, double *depth);
-void select_ephemeris(tle_t *tle);
-void SGP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel);
-void Deep(int ientry, tle_t * tle, deep_arg_t * deep_arg);
-
-void SDP4(double tsince, tle_t * tle, vector_t * pos, vector_t * vel);
+void select_ephemeris(context_t *ctx);
+void SGP4(context_t *ctx, double tsince, vector_t *pos, vector_t *vel);
+void Deep(context_t *ctx, int ientry, deep_arg_t *deep_arg);
+void ResetDeep(context_t *ctx);
+int KeepDeepCheckpoints(context_t *ctx);
+void FreeDeepCheckpoints(deep_checkpoints_t *kept);
+
+void SDP4(context_t *ctx, double tsince, vector_t *pos, vector_t *vel);
 void Calculate_User_PosVel(double time, geodetic_t *geodetic, vector_t *obs_pos, vector_t *obs_vel);
+void Calculate_LatLonAlt(double time, vector_t *pos, geodetic_t *geodetic);
 
 
 void Calculate_Obs(double time, vector_t *pos, vector_t *vel, geodetic_t *geodetic, vector_t *obs_set);
+void Prepare_Station(station_t *station, double lat, double lon, long alt);
+void Calculate_Station_ECI(double thetag, const station_t *station, station_eci_t *eci);
+double Calculate_Station_Sin_Elevation(vector_t *pos, const station_t *station, const station_eci_t *eci);
+void Calculate_Station_Obs(double thetag, vector_t *pos, vector_t *vel, const station_t *station, vector_t *obs_set);
 void Calculate_RADec(double time, vector_t *pos, vector_t *vel, geodetic_t *geodetic, vector_t *obs_set);
 
 
@@ -352,36 +471,144 @@ void Calculate_RADec(double time, vector_t *pos, vector_t *vel, geodetic_t *geod
 double FixAngle(double x);
 double PrimeAngle(double x);
 
-char *SubString(char *string, char start, char end);
+char *SubString(const char *string, char start, char end, char *temp);
 void CopyString(char *source, char *destination, char start, char end);
-char *Abbreviate(char *string, int n);
+char *Abbreviate(char *string, int n, char *temp);
 
-char KepCheck(char *line1, char *line2);
-void InternalUpdate(int x);
-char *noradEvalue(double value);
+char KepCheck(const char *line1, const char *line2);
+void InternalUpdate(sat_struct *sat);
+char *noradEvalue(double value, char *output);
 
-void Data2TLE(int x);
+void Data2TLE(sat_struct *sat);
 double ReadBearing(char *input);
-char ReadTLE(char *line0, char *line1, char *line2);
-char ReadQTH();
-char ReadQTHFile();
+char ReadTLE(sat_struct *sat, const char *line0, const char *line1, const char *line2);
+char ReadQTH(context_t *ctx, double lat, double lon, long alt);
+char ReadQTHFile(context_t *ctx, const char *qthfile);
 char CopyFile(char *source, char *destination);
-void SaveQTH();
-void SaveTLE();
+void SaveQTH(qth_struct *qth, const char *qthfile);
+void SaveTLE(sat_struct *sat, const char *tlefile);
 
 long DayNum(int m, int d, int y);
 double CurrentDaynum();
-char *Daynum2String(double daynum);
-
-void FindMoon(double daynum);
-void FindSun(double daynum);
-void PreCalc(int x);
-
-void Calc();
-char AosHappens(int x);
-char Decayed(int x, double time);
-char Geostationary(int x);
-double FindAOS();
-double FindLOS();
-double FindLOS2();
-double NextAOS();
+char *Daynum2String(double daynum, char *output);
+
+void FindMoon(context_t *ctx, double daynum);
+void FindSun(context_t *ctx, double daynum);
+void PreCalc(context_t *ctx);
+
+void Propagate(context_t *ctx, vector_t *pos, vector_t *vel);
+void Calc(context_t *ctx);
+char AosHappens(context_t *ctx);
+char Decayed(context_t *ctx, double time);
+char Geostationary(context_t *ctx);
+double Step_Clear(context_t *ctx);
+double Calc_At(context_t *ctx, double daynum, int skip);
+double FindCrossing(context_t *ctx, double below, double ele_below, double above, double ele_above);
+double FindPeak(context_t *ctx, double left, double right);
+double FindAOS(context_t *ctx);
+double FindLOS(context_t *ctx);
+double FindLOS2(context_t *ctx);
+double NextAOS(context_t *ctx);
+
+/* Batch propagation of many near-earth satellites at one instant.
+
+   The constants SGP4() computes during initialization are gathered
+   SGP4_LANES satellites at a time into groups of vectors (the i'th
+   satellite lives in lane i%SGP4_LANES of group i/SGP4_LANES), so that
+   one pass through the SGP4 equations propagates a whole group.  The
+   vectors are GCC vector extensions, which compile to SSE2, AVX2 or
+   AVX-512 depending on the target.  A group holds satellites of one
+   orbit class, with SIMPLE_FLAG all set or all clear, and is propagated
+   by the code for that class alone.  Deep-space satellites don't fit
+   this scheme and are propagated one at a time with SDP4(). */
+
+#define SGP4_LANES  4
+
+typedef double lane_t __attribute__ ((vector_size (SGP4_LANES*sizeof(double))));
+typedef long long lane_mask_t __attribute__ ((vector_size (SGP4_LANES*sizeof(double))));
+
+typedef struct  {
+           /* Preprocessed elements, as left in tle_t by select_ephemeris() */
+           lane_t  xmo, xnodeo, omegao, eo, xincl, bstar, jul_epoch;
+
+           /* Constants from the initialization block of SGP4() */
+           lane_t  aodp, aycof, c1, c4, c5, cosio, d2, d3, d4, delmo,
+               omgcof, eta, omgdot, sinio, xnodp, sinmo, t2cof, t3cof,
+               t4cof, t5cof, x1mth2, x3thm1, x7thm1, xmcof, xmdot, xnodcf,
+               xnodot, xlcof;
+
+           /* Whether the satellites of the group, which are all of the */
+           /* same orbit class, have SIMPLE_FLAG set                    */
+           int  simple;
+        }  sgp4_group_t;
+
+typedef struct  {
+           int  count;          /* Satellites in the batch */
+           int  groups;         /* Groups of SGP4_LANES near-earth satellites */
+           int  deep_count;     /* Deep-space satellites */
+           int  *near_index;    /* Batch index of each near-earth lane (groups*SGP4_LANES) */
+           int  *deep_index;    /* Batch index of each deep-space satellite */
+           int  *where;         /* Lane of each satellite, or -1-j for deep[j] */
+           int  *slot;          /* Batch index+1 by hashed NORAD id, 0 if empty */
+           int  slots;          /* Size of slot, a power of 2 */
+           sat_struct  **sat;   /* Elements of each satellite, swapped like group */
+           sgp4_group_t  **group;  /* Swapped for updated copies by SGP4BatchUpdate() */
+           context_t  **deep;   /* Initialized contexts of the deep-space satellites */
+           void  *map;          /* Compiled catalog mapped by SGP4BatchMap(), or NULL */
+           size_t  map_size;
+        }  sgp4_batch_t;
+
+typedef struct  {
+           int  epoch;          /* Flipped by each SGP4Synchronize() */
+           int  readers[2];     /* Readers counted against each parity of epoch */
+           pthread_mutex_t  lock;  /* Held by whoever is updating */
+        }  sgp4_rcu_t;
+
+int SGP4BatchInit(sgp4_batch_t *batch, context_t *ctx, int count);
+void SGP4BatchFree(sgp4_batch_t *batch);
+int SGP4BatchIndex(const sgp4_batch_t *batch, long catnum);
+const sat_struct *SGP4BatchSat(const sgp4_batch_t *batch, int i);
+void SGP4RcuInit(sgp4_rcu_t *rcu);
+int SGP4ReadLock(sgp4_rcu_t *rcu);
+void SGP4ReadUnlock(sgp4_rcu_t *rcu, int index);
+void SGP4Synchronize(sgp4_rcu_t *rcu);
+void SGP4BatchReplace(sgp4_batch_t **batch, sgp4_rcu_t *rcu, sgp4_batch_t *replacement);
+int SGP4BatchUpdate(sgp4_batch_t **batch, sgp4_rcu_t *rcu, context_t *ctx, int count);
+int SGP4BatchSelectKernels(const char *name);
+const char *SGP4BatchKernels(void);
+void SGP4Group(const sgp4_group_t *group, const lane_t *tsince, lane_t pos[3], lane_t vel[3], int exact);
+void SGP4Batch(const sgp4_batch_t *batch, double daynum, double *x, double *y, double *z, double *x_vel, double *y_vel, double *z_vel, int exact);
+void SGP4Batch32(const sgp4_batch_t *batch, double daynum, float *x, float *y, float *z, float *x_vel, float *y_vel, float *z_vel);
+void SGP4BatchGeodetic(const sgp4_batch_t *batch, double daynum, double *lat, double *lon, double *alt);
+void SGP4BatchGeodetic32(const sgp4_batch_t *batch, double daynum, float *lat, float *lon, float *alt);
+int SGP4BatchVisibility(const sgp4_batch_t *batch, const station_t *station, int stations, double start, double step, int steps, double min_elevation, unsigned char *bits, int threads);
+int SGP4BatchLoad(sgp4_batch_t *batch, const char *text, size_t length, int threads, int *failed);
+int SGP4BatchSave(const sgp4_batch_t *batch, int fd);
+int SGP4BatchMap(sgp4_batch_t *batch, int fd);
+
+/* History archives of element sets, sorted by NORAD id and then epoch,
+   from which the element set to use at a time is found by binary
+   search. */
+
+typedef struct  {
+           long  catnum;
+           double  epoch;       /* Epoch of the element set, as a day number */
+           char  name[25];
+           char  line1[70];
+           char  line2[70];
+        }  tle_entry_t;
+
+typedef struct  {
+           int  count;
+           tle_entry_t  *entry; /* Sorted by catnum, then epoch */
+           void  *map;          /* File mapped by TLEArchiveMap(), or NULL */
+           size_t  map_size;
+        }  tle_archive_t;
+
+char TLEEntry(tle_entry_t *entry, const char *name, const char *line1, const char *line2);
+void TLEArchiveInit(tle_archive_t *archive, tle_entry_t *entry, int count);
+int TLEArchiveLoad(tle_archive_t *archive, const char *text, size_t length, int *failed);
+void TLEArchiveFree(tle_archive_t *archive);
+int TLEArchiveFind(const tle_archive_t *archive, long catnum, double daynum, int before);
+int TLEArchiveSave(const tle_archive_t *archive, int fd);
+int TLEArchiveMap(tle_archive_t *archive, int fd);
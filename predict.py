@@ -10,13 +10,26 @@ import os
 import time
 import math
 from copy import copy
-from cpredict import quick_find, quick_predict
+from cpredict import quick_find, quick_predict, simd_kernels, Satellite, Catalog, Stations, Archive, Observation
+
+try:
+    from collections.abc import Mapping
+except ImportError:
+    from collections import Mapping
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
 
 try:
     basestring
 except:
     basestring = str
 
+# Observation reads like a dictionary, so isinstance() checks for a Mapping accept it too.
+Mapping.register(Observation)
+
 def host_qth(path="~/.predict/predict.qth"):
     path = os.path.abspath(os.path.expanduser(path))
     try:
@@ -54,36 +67,60 @@ def observe(tle, qth, at=None):
         at = time.time()
     return quick_find(tle, at, qth)
 
+# Observe at every epoch in times in one native call.  Returns a dictionary mapping each numeric
+# observation field to an array with one element per epoch (numpy arrays when numpy is available).
+def observe_many(tle, qth, times):
+    tle = massage_tle(tle)
+    qth = massage_qth(qth)
+    if numpy is not None:
+        times = numpy.ascontiguousarray(times, dtype=numpy.float64)
+    fields = Satellite(tle).observe_many(times, qth)
+    if numpy is not None:
+        fields = dict((k, numpy.frombuffer(v, dtype=v.typecode)) for k, v in fields.items())
+    return fields
+
+# Observe at every epoch in times in one native call, keeping every observation whole.  Returns a
+# numpy structured array with a field per observation key, over the native rows without copying
+# them, or the cpredict.Observations sequence itself when numpy isn't available.
+def observe_records(tle, qth, times):
+    tle = massage_tle(tle)
+    qth = massage_qth(qth)
+    if numpy is not None:
+        times = numpy.ascontiguousarray(times, dtype=numpy.float64)
+    records = Satellite(tle).observe_records(times, qth)
+    if numpy is not None:
+        records = numpy.asarray(records)
+    return records
+
 def transits(tle, qth, ending_after=None, ending_before=None):
     tle = massage_tle(tle)
     qth = massage_qth(qth)
     if ending_after is None:
         ending_after = time.time()
-    ts = ending_after
-    while True:
-        transit = quick_predict(tle, ts, qth)
-        t = Transit(tle, qth, start=transit[0]['epoch'], end=transit[-1]['epoch'])
-        if (ending_before != None and t.end > ending_before):
-            break
-        if (t.end > ending_after):
-            yield t
-        # Need to advance time cursor so predict doesn't yield same pass
-        ts = t.end + 60     #seconds seems to be sufficient
+    satellite = Satellite(tle)
+    # Passes are found one at a time, so calculation failures surface only when iterated to
+    for start, end, peak in satellite.transits(qth, ending_after, ending_before):
+        yield Transit(tle, qth, start=start, end=end, satellite=satellite, peak=peak)
 
 # Transit is a convenience class representing a pass of a satellite over a groundstation.
 class Transit():
-    def __init__(self, tle, qth, start, end):
+    def __init__(self, tle, qth, start, end, satellite=None, peak=None):
         self.tle = massage_tle(tle)
         self.qth = massage_qth(qth)
+        # Parsed and initialized TLE, shared by every observation of this transit
+        self.satellite = satellite if satellite is not None else Satellite(self.tle)
         self.start = start
         self.end = end
+        # Time of maximum elevation (within 0.1s) if already known, as from Satellite.transits
+        self.peak_time = peak
 
-        self.azimuth_start = observe(self.tle, self.qth, self.start)['azimuth']
-        self.azimuth_end = observe(self.tle, self.qth, self.end)['azimuth']
+        self.azimuth_start = self.satellite.observe(self.start, self.qth)['azimuth']
+        self.azimuth_end = self.satellite.observe(self.end, self.qth)['azimuth']
         self.heading = self.find_heading()
 
         # Orbital velocity from PyPredict is in km/h
-        self.peak_angular_rate = math.degrees(self.peak()['orbital_velocity'] / (self.peak()['slant_range']*3600))
+        peak = self.peak()
+        self.peak_angular_rate = math.degrees(peak['orbital_velocity'] / (peak['slant_range']*3600))
 
     def find_heading(self):
         # First, convert compass to polar
@@ -111,33 +148,13 @@ class Transit():
     # return observation within epsilon seconds of maximum elevation
     # NOTE: Assumes elevation is strictly monotonic or concave over the [start,end] interval
     def peak(self, epsilon=0.1):
-        ts =  (self.end + self.start)/2
-        step = (self.end - self.start)
-        while (step > epsilon):
-            step /= 4
-            # Ascend the gradient at this step size
-            direction = None
-            while True:
-                mid   = observe(self.tle, self.qth, ts)['elevation']
-                left  = observe(self.tle, self.qth, ts - step)['elevation']
-                right = observe(self.tle, self.qth, ts + step)['elevation']
-                # Break if we're at a peak
-                if (left <= mid >= right):
-                    break
-                # Ascend up slope
-                slope = -1 if (left > right) else 1
-                # Break if we stepped over a peak (switched directions)
-                if direction is None:
-                    direction = slope
-                if direction != slope:
-                    break
-                # Break if stepping would take us outside of transit
-                next_ts = ts + (direction * step)
-                if (next_ts < self.start) or (next_ts > self.end):
-                    break
-                # Step towards the peak
-                ts = next_ts
-        return self.at(ts)
+        if self.peak_time is None:
+            self.peak_time = self.satellite.peak(self.qth, self.start, self.end, epsilon)
+        elif epsilon < 0.1:
+            # The known peak is within 0.1s, so only that much either side needs searching
+            self.peak_time = self.satellite.peak(self.qth, max(self.start, self.peak_time - 0.1),
+                                                 min(self.end, self.peak_time + 0.1), epsilon)
+        return self.at(self.peak_time)
 
     # Return portion of transit above a certain elevation
     def above(self, elevation):
@@ -188,4 +205,4 @@ class Transit():
     def at(self, t):
         if t < self.start or t > self.end:
             raise RuntimeError("time %f outside transit [%f, %f]" % (t, self.start, self.end))
-        return observe(self.tle, self.qth, t)
+        return self.satellite.observe(t, self.qth)
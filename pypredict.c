@@ -9,6 +9,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <limits.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "predict.h"
 
@@ -21,31 +25,43 @@ struct qth;
 //       is convoluted and it's never come up in our usage.  FYI, the 'Edit Transponder Database'
 //       menu option is still marked "coming soon" :).  We'll add it back if there's demand.
 //
-int MakeObservation(double obs_time, struct observation * obs) {
+// NOTE: PreCalc(ctx) must have been called once for the context's TLE.  The deep-space caches
+//       are reset so the result doesn't depend on which observations were made before it.
+//
+// NOTE: With INCREMENTAL_FLAG set in ctx they're kept instead: the resonance integrator steps
+//       on from where it was unless obs_time is nearer epoch, and the lunar-solar periodics are
+//       reused for up to DEEP_PERIODICS_REUSE minutes.  See observe_many.
+//
+// NOTE: Stages with SKIP_*_FLAG set in ctx are left out, and noted in obs->skipped.
+//
+int MakeObservation(context_t *ctx, double obs_time, struct observation * obs) {
     char geostationary=0, aoshappens=0, decayed=0, visibility=0, sunlit;
     double doppler100=0.0, delay;
 
-    PreCalc(0);
-    indx=0;
-
-    if (sat_db.transponders>0)
+    if (isFlagClear(ctx, INCREMENTAL_FLAG))
     {
-        PyErr_SetString(PyExc_RuntimeError, "pypredict does not support transponder definition.");
-        return -1;
+        ResetDeep(ctx);
     }
 
-    daynum=obs_time;
-    aoshappens=AosHappens(indx);
-    geostationary=Geostationary(indx);
-    decayed=Decayed(indx,0.0);
+    ctx->daynum=obs_time;
+    aoshappens=AosHappens(ctx);
+    geostationary=Geostationary(ctx);
+
+    // Decayed is measured against the wall clock, which costs a system call.
+    if (isFlagClear(ctx, SKIP_DECAYED_FLAG))
+    {
+        decayed=Decayed(ctx,0.0);
+    }
 
-    //Calcs
-    Calc();
-    fk=12756.33*acos(xkmper/(xkmper+sat_alt));
+    //Calcs (including the footprint, with the geodetic stage)
+    Calc(ctx);
 
-    if (sat_sun_status)
+    if (isFlagSet(ctx, SKIP_SOLAR_FLAG))
     {
-        if (sun_ele<=-12.0 && sat_ele>=0.0) {
+        visibility=0;
+    } else if (ctx->sat_sun_status)
+    {
+        if (ctx->sun_ele<=-12.0 && ctx->sat_ele>=0.0) {
             visibility='V';
         } else {
             visibility='D';
@@ -54,13 +70,14 @@ int MakeObservation(double obs_time, struct observation * obs) {
         visibility='N';
     }
     // gathering power seems much more useful than naked-eye visibility
-    sunlit = sat_sun_status;
+    sunlit = ctx->sat_sun_status;
 
-    doppler100=-100.0e06*((sat_range_rate*1000.0)/299792458.0);
-    delay=1000.0*((1000.0*sat_range)/299792458.0);
+    doppler100=-100.0e06*((ctx->sat_range_rate*1000.0)/299792458.0);
+    delay=1000.0*((1000.0*ctx->sat_range)/299792458.0);
 
     //TODO: Seems like FindSun(daynum) should go in here
-    FindMoon(daynum);
+    // NOTE: predict's FindMoon used to be called here, but none of its results are part of an
+    //       observation and it was ~90% of the cost of making one.
 
     //printw(5+tshift,1,"Satellite     Direction     Velocity     Footprint    Altitude     Slant Range");
     //printw(6+tshift,1,"---------     ---------     --------     ---------    --------     -----------");
@@ -69,42 +86,43 @@ int MakeObservation(double obs_time, struct observation * obs) {
     //printw(16+bshift,1,"Eclipse Depth   Orbital Phase   Orbital Model   Squint Angle      AutoTracking");
     //printw(17+bshift,1,"-------------   -------------   -------------   ------------      ------------");
 
-    obs->norad_id = sat.catnum;
-    strncpy(&(obs->name), &(sat.name), sizeof(obs->name));
-    obs->epoch = (daynum+3651.0)*(86400.0); //See daynum=((start/86400.0)-3651.0);
-    obs->latitude = sat_lat;
-    obs->longitude = sat_lon;
-    obs->azimuth = sat_azi;
-    obs->elevation = sat_ele;
-    obs->orbital_velocity = 3600.0*sat_vel;
-    obs->footprint = fk;
-    obs->altitude = sat_alt;
-    obs->slant_range = sat_range;
-    obs->eclipse_depth = eclipse_depth/deg2rad;
-    obs->orbital_phase = 256.0*(phase/twopi);
-    strncpy(&(obs->orbital_model), &(ephem), sizeof(obs->orbital_model));
+    obs->norad_id = ctx->sat.catnum;
+    strncpy(obs->name, ctx->sat.name, sizeof(obs->name));
+    obs->epoch = (ctx->daynum+3651.0)*(86400.0); //See daynum=((start/86400.0)-3651.0);
+    obs->latitude = ctx->sat_lat;
+    obs->longitude = ctx->sat_lon;
+    obs->azimuth = ctx->sat_azi;
+    obs->elevation = ctx->sat_ele;
+    obs->orbital_velocity = 3600.0*ctx->sat_vel;
+    obs->footprint = ctx->fk;
+    obs->altitude = ctx->sat_alt;
+    obs->slant_range = ctx->sat_range;
+    obs->eclipse_depth = ctx->eclipse_depth/deg2rad;
+    obs->orbital_phase = 256.0*(ctx->phase/twopi);
+    strncpy(obs->orbital_model, ctx->ephem, sizeof(obs->orbital_model));
     obs->visibility = visibility;
     obs->sunlit = sunlit;
-    obs->orbit = rv;
+    obs->orbit = ctx->rv;
     obs->geostationary = geostationary;
     obs->has_aos = aoshappens;
     obs->decayed = decayed;
     obs->doppler = doppler100;
-    obs->inclination = sat.incl;
-    obs->raan = sat.raan;
-    obs->argument_perigee = sat.argper;
-    obs->perigee = sat.perigee;
-    obs->apogee = sat.apogee;
-    obs->eccentricity = sat.eccn;
-    obs->semi_major_axis = sat.aodp;
-    obs->mean_anomaly = sat.meanan;
-    obs->bstar = sat.bstar;
-    obs->x = sat.x;
-    obs->y = sat.y;
-    obs->z = sat.z;
-    obs->x_vel = sat.x_vel;
-    obs->y_vel = sat.y_vel;
-    obs->z_vel = sat.z_vel;
+    obs->inclination = ctx->sat.incl;
+    obs->raan = ctx->sat.raan;
+    obs->argument_perigee = ctx->sat.argper;
+    obs->perigee = ctx->sat.perigee;
+    obs->apogee = ctx->sat.apogee;
+    obs->eccentricity = ctx->sat.eccn;
+    obs->semi_major_axis = ctx->sat.aodp;
+    obs->mean_anomaly = ctx->sat.meanan;
+    obs->bstar = ctx->sat.bstar;
+    obs->x = ctx->sat.x;
+    obs->y = ctx->sat.y;
+    obs->z = ctx->sat.z;
+    obs->x_vel = ctx->sat.x_vel;
+    obs->y_vel = ctx->sat.y_vel;
+    obs->z_vel = ctx->sat.z_vel;
+    obs->skipped = ctx->flags & SKIP_FLAGS;
     return 0;
 }
 
@@ -147,310 +165,3561 @@ void PrintObservation(struct observation * obs) {
     printf("Z Velocity         %f\n", obs->z_vel);
 }
 
-PyObject * PythonifyObservation(observation * obs) {
-    //TODO: Add reference count?
+// The numeric fields of an observation that observe_many returns, one array per field.  Keys
+// are those of an Observation and typecode is the array module typecode each is stored as.
+// name, orbital_model and visibility are left out: they are strings and don't vectorize.
+typedef struct {
+    const char *key;
+    char typecode;
+    size_t offset;
+    int stage;      // SKIP_*_FLAG that leaves this field out, or 0 if it is always worked out
+} observation_field;
+
+static const observation_field observation_fields[] = {
+    {"norad_id"        , 'l', offsetof(observation, norad_id),              0},
+    {"epoch"           , 'd', offsetof(observation, epoch),                 0},
+    {"latitude"        , 'd', offsetof(observation, latitude),              SKIP_GEODETIC_FLAG},
+    {"longitude"       , 'd', offsetof(observation, longitude),             SKIP_GEODETIC_FLAG},
+    {"azimuth"         , 'd', offsetof(observation, azimuth),               0},
+    {"elevation"       , 'd', offsetof(observation, elevation),             0},
+    {"orbital_velocity", 'd', offsetof(observation, orbital_velocity),      0},
+    {"footprint"       , 'd', offsetof(observation, footprint),             SKIP_GEODETIC_FLAG},
+    {"altitude"        , 'd', offsetof(observation, altitude),              SKIP_GEODETIC_FLAG},
+    {"slant_range"     , 'd', offsetof(observation, slant_range),           0},
+    {"eclipse_depth"   , 'd', offsetof(observation, eclipse_depth),         SKIP_SOLAR_FLAG},
+    {"orbital_phase"   , 'd', offsetof(observation, orbital_phase),         0},
+    {"sunlit"          , 'b', offsetof(observation, sunlit),                SKIP_SOLAR_FLAG},
+    {"orbit"           , 'l', offsetof(observation, orbit),                 0},
+    {"geostationary"   , 'b', offsetof(observation, geostationary),         0},
+    {"has_aos"         , 'b', offsetof(observation, has_aos),               0},
+    {"decayed"         , 'b', offsetof(observation, decayed),               SKIP_DECAYED_FLAG},
+    {"doppler"         , 'd', offsetof(observation, doppler),               0},
+    {"inclination"     , 'd', offsetof(observation, inclination),           0},
+    {"raan"            , 'd', offsetof(observation, raan),                  0},
+    {"arg_perigee"     , 'd', offsetof(observation, argument_perigee),      0},
+    {"perigee"         , 'd', offsetof(observation, perigee),               0},
+    {"apogee"          , 'd', offsetof(observation, apogee),                0},
+    {"eccentricity"    , 'd', offsetof(observation, eccentricity),          0},
+    {"semi_major_axis" , 'd', offsetof(observation, semi_major_axis),       0},
+    {"mean_anomaly"    , 'd', offsetof(observation, mean_anomaly),          0},
+    {"bstar"           , 'd', offsetof(observation, bstar),                 0},
+    {"x"               , 'd', offsetof(observation, x),                     0},
+    {"y"               , 'd', offsetof(observation, y),                     0},
+    {"z"               , 'd', offsetof(observation, z),                     0},
+    {"x_vel"           , 'd', offsetof(observation, x_vel),                 0},
+    {"y_vel"           , 'd', offsetof(observation, y_vel),                 0},
+    {"z_vel"           , 'd', offsetof(observation, z_vel),                 0},
+    {NULL, 0, 0, 0}
+};
+
+#define NUM_OBSERVATION_FIELDS (sizeof(observation_fields)/sizeof(observation_fields[0]) - 1)
+
+// The rest of the fields of an Observation, boxed as str: 's' for strings, 'c' for a single char.
+static const observation_field observation_text_fields[] = {
+    {"name"            , 's', offsetof(observation, name),                  0},
+    {"orbital_model"   , 's', offsetof(observation, orbital_model),         0},
+    {"visibility"      , 'c', offsetof(observation, visibility),            SKIP_SOLAR_FLAG},
+    {NULL, 0, 0, 0}
+};
+
+#define NUM_OBSERVATION_KEYS (NUM_OBSERVATION_FIELDS + sizeof(observation_text_fields)/sizeof(observation_text_fields[0]) - 1)
+
+// Field i of an Observation: the numeric fields, then the text ones.
+static const observation_field * ObservationField(Py_ssize_t i) {
+    if (i < (Py_ssize_t)NUM_OBSERVATION_FIELDS)
+    {
+        return &observation_fields[i];
+    }
+    return &observation_text_fields[i - NUM_OBSERVATION_FIELDS];
+}
+
+// Boxes field i of obs the way the observation dictionaries always have.
+static PyObject * BoxObservationField(const observation *obs, Py_ssize_t i) {
+    const observation_field *field = ObservationField(i);
+    const char *base = (const char *)obs + field->offset;
+
+    switch (field->typecode)
+    {
+        case 'd': return PyFloat_FromDouble(*(const double *)base);
+        case 'l': return Py_BuildValue("l", *(const long *)base);
+        case 'b': return Py_BuildValue("i", (int)*base);
+        case 's': return Py_BuildValue("s", base);
 #if PY_MAJOR_VERSION >= 3
-    return Py_BuildValue("{s:l,s:s,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:s,s:C,s:i,s:l,s:i,s:i,s:i,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+        case 'c': return Py_BuildValue("C", (int)*base);
 #else
-    return Py_BuildValue("{s:l,s:s,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:s,s:c,s:i,s:l,s:i,s:i,s:i,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+        case 'c': return Py_BuildValue("c", *base);
 #endif
-        "norad_id", obs->norad_id,
-        "name", obs->name,
-        "epoch", obs->epoch,
-        "latitude", obs->latitude,
-        "longitude", obs->longitude,
-        "azimuth", obs->azimuth,
-        "elevation", obs->elevation,
-        "orbital_velocity", obs->orbital_velocity,
-        "footprint", obs->footprint,
-        "altitude", obs->altitude,
-        "slant_range", obs->slant_range,
-        "eclipse_depth", obs->eclipse_depth,
-        "orbital_phase", obs->orbital_phase,
-        "orbital_model", obs->orbital_model,
-        "visibility", obs->visibility,
-        "sunlit", obs->sunlit,
-        "orbit", obs->orbit,
-        "geostationary", obs->geostationary,
-        "has_aos", obs->has_aos,
-        "decayed", obs->decayed,
-        "doppler", obs->doppler,
-        "inclination", obs->inclination,
-        "raan", obs->raan,
-        "arg_perigee", obs->argument_perigee,
-        "perigee", obs->perigee,
-        "apogee", obs->apogee,
-        "eccentricity", obs->eccentricity,
-        "semi_major_axis", obs->semi_major_axis,
-        "mean_anomaly", obs->mean_anomaly,
-        "bstar", obs->bstar,
-        "x", obs->x,
-        "y", obs->y,
-        "z", obs->z,
-        "x_vel", obs->x_vel,
-        "y_vel", obs->y_vel,
-        "z_vel", obs->z_vel
-    );
-}
-char load(PyObject *args) {
-    //TODO: Not threadsafe, detect and raise warning?
-    int x;
-    char *env=NULL;
+    }
 
-    /* Set up translation table for computing TLE checksums */
-    for (x=0; x<=255; val[x]=0, x++);
-    for (x='0'; x<='9'; val[x]=x-'0', x++);
+    PyErr_SetString(PyExc_SystemError, "bad observation field");
+    return NULL;
+}
 
-    val['-']=1;
+// Keys of an Observation, mapped to their field index, and in field order.  Built when the
+// module is initialized.
+static PyObject *ObservationKeys = NULL;
+static PyObject *ObservationKeyList = NULL;
 
-    double epoch;
-    const char *tle0, *tle1, *tle2;
+int LoadObservationKeys() {
+    Py_ssize_t i, pos = 0;
+    PyObject *index, *key;
 
-    if (!PyArg_ParseTuple(args, "(sss)|d(ddi)",
-        &tle0, &tle1, &tle2, &epoch, &qth.stnlat, &qth.stnlong, &qth.stnalt))
+    ObservationKeys = PyDict_New();
+    ObservationKeyList = PyTuple_New(NUM_OBSERVATION_KEYS);
+    if (ObservationKeys == NULL || ObservationKeyList == NULL)
     {
-        // PyArg_ParseTuple will set appropriate exception string
         return -1;
-    };
+    }
 
-    if (ReadTLE(tle0,tle1,tle2) != 0)
+    for (i=0; i<(Py_ssize_t)NUM_OBSERVATION_KEYS; i++)
     {
-        PyErr_SetString(PyExc_RuntimeError, "Unable to process TLE");
-        return -1;
+        index = PyLong_FromSsize_t(i);
+        if (index == NULL || PyDict_SetItemString(ObservationKeys, ObservationField(i)->key, index) != 0)
+        {
+            Py_XDECREF(index);
+            return -1;
+        }
+        Py_DECREF(index);
     }
 
-    // If time isn't set, use current time.
-    if (PyObject_Length(args) < 2)
+    // Reuse the dictionary's own key objects, so iterating an Observation hands them back out.
+    while (PyDict_Next(ObservationKeys, &pos, &key, &index))
     {
-        daynum=CurrentDaynum();
+        Py_INCREF(key);
+        PyTuple_SET_ITEM(ObservationKeyList, PyLong_AsSsize_t(index), key);
     }
-    else
+
+    return 0;
+}
+
+// Works out what observing only the fields named in the sequence fields (or every field, if it
+// is NULL or None) involves.  *skip is set to the SKIP_*_FLAG stages none of them need.  Unless
+// selected is NULL, the fields must be numeric, and their indices into observation_fields are
+// stored in it (room for NUM_OBSERVATION_FIELDS) and their number in *count.
+//
+// NOTE: Returns -1 with an exception set if a name isn't a field it can be.
+int LoadFields(PyObject *fields, int *skip, int *selected, int *count) {
+    Py_ssize_t i, n;
+    PyObject *seq, *index;
+    int needed = 0;
+
+    if (fields == NULL || fields == Py_None)
+    {
+        *skip = 0;
+        for (i=0; selected != NULL && i<(Py_ssize_t)NUM_OBSERVATION_FIELDS; i++)
+        {
+            selected[i] = i;
+        }
+        if (count != NULL)
+        {
+            *count = NUM_OBSERVATION_FIELDS;
+        }
+        return 0;
+    }
+
+    seq = PySequence_Fast(fields, "fields must be a sequence of field names");
+    if (seq == NULL)
     {
-        daynum=((epoch/86400.0)-3651.0);
+        return -1;
     }
 
-    // If we haven't already set groundstation location, use predict's default.
-    if (PyObject_Length(args) < 3)
+    n = PySequence_Fast_GET_SIZE(seq);
+    if (selected != NULL && n > (Py_ssize_t)NUM_OBSERVATION_FIELDS)
     {
-        FILE *fd;
-        env=getenv("HOME");
-        sprintf(qthfile,"%s/.predict/predict.qth",env);
-        fd=fopen(qthfile,"r");
-        if (fd!=NULL)
-        {
-            fgets(qth.callsign,16,fd);
-            qth.callsign[strlen(qth.callsign)-1]=0;
-            fscanf(fd,"%lf", &qth.stnlat);
-            fscanf(fd,"%lf", &qth.stnlong);
-            fscanf(fd,"%d", &qth.stnalt);
-            fclose(fd);
-        } else {
-            PyErr_SetString(PyExc_RuntimeError, "QTH file could not be loaded.");
+        PyErr_SetString(PyExc_ValueError, "too many fields");
+        Py_DECREF(seq);
+        return -1;
+    }
+
+    for (i=0; i<n; i++)
+    {
+        index = PyDict_GetItem(ObservationKeys, PySequence_Fast_GET_ITEM(seq, i));
+        if (index == NULL || (selected != NULL && PyLong_AsSsize_t(index) >= (Py_ssize_t)NUM_OBSERVATION_FIELDS))
+        {
+            PyErr_Format(PyExc_ValueError, "%R is not a%s observation field",
+                PySequence_Fast_GET_ITEM(seq, i), selected != NULL ? " numeric" : "n");
+            Py_DECREF(seq);
             return -1;
         }
+
+        needed |= ObservationField(PyLong_AsSsize_t(index))->stage;
+        if (selected != NULL)
+        {
+            selected[i] = PyLong_AsSsize_t(index);
+        }
     }
-    obs_geodetic.lat=qth.stnlat*deg2rad;
-    obs_geodetic.lon=-qth.stnlong*deg2rad;
-    obs_geodetic.alt=((double)qth.stnalt)/1000.0;
-    obs_geodetic.theta=0.0;
 
+    Py_DECREF(seq);
+    *skip = SKIP_FLAGS & ~needed;
+    if (count != NULL)
+    {
+        *count = n;
+    }
     return 0;
 }
 
-static PyObject* quick_find(PyObject* self, PyObject *args)
-{
-    struct observation obs = { 0 };
+// Whether field i of obs was worked out.
+#define HAS_FIELD(obs, i) (!(ObservationField(i)->stage & (obs)->skipped))
+
+// Every field of obs that was worked out, boxed into a new dictionary: what quick_find and
+// quick_predict return, as they always have.
+PyObject * DictifyObservation(const observation *obs) {
+    Py_ssize_t i;
+    PyObject *dict, *value;
 
-    if (load(args) != 0 || MakeObservation(daynum, &obs) != 0)
+    dict = PyDict_New();
+    if (dict == NULL)
     {
-        // load or MakeObservation will set appropriate exceptions if either fails.
         return NULL;
     }
 
-    return PythonifyObservation(&obs);
+    for (i=0; i<(Py_ssize_t)NUM_OBSERVATION_KEYS; i++)
+    {
+        if (!HAS_FIELD(obs, i))
+        {
+            continue;
+        }
+
+        value = BoxObservationField(obs, i);
+        if (value == NULL || PyDict_SetItem(dict, PyTuple_GET_ITEM(ObservationKeyList, i), value) != 0)
+        {
+            Py_XDECREF(value);
+            Py_DECREF(dict);
+            return NULL;
+        }
+        Py_DECREF(value);
+    }
+
+    return dict;
 }
 
-static char quick_find_docs[] =
-    "quick_find((tle_line0, tle_line1, tle_line2), time, (gs_lat, gs_lon, gs_alt))\n";
+// An observation as python sees it: the C struct itself, with each field boxed only when it
+// is read, either as an attribute or by key as from the dictionaries observations used to be.
+// Once a key is assigned or deleted, fields holds every field as a dictionary, and is the
+// observation from then on.  Only then can an observation be part of a cycle, so only then is it
+// tracked by the garbage collector, the way dictionaries are only once they hold containers.
+typedef struct {
+    PyObject_HEAD
+    observation obs;
+    PyObject *fields;
+} Observation;
 
-static PyObject* quick_predict(PyObject* self, PyObject *args)
-{
-    double now;
-    int lastel=0;
-    char errbuff[100];
-    observation obs = { 0 };
+static PyTypeObject ObservationType;
 
-    PyObject* transit = PyList_New(0);
+// Observations are made and dropped by the thousand while sampling passes, so a few freed
+// ones are kept to be reused instead of going back to the allocator.
+#define OBSERVATION_FREELIST 256
+static Observation *observation_freelist[OBSERVATION_FREELIST];
+static int observation_free = 0;
 
-    if (transit == NULL)
+PyObject * PythonifyObservation(observation * obs) {
+    Observation *self;
+
+    if (observation_free > 0)
     {
-        goto cleanup_and_raise_exception;
+        self = observation_freelist[--observation_free];
+        PyObject_Init((PyObject *)self, &ObservationType);
+    }
+    else
+    {
+        self = PyObject_GC_New(Observation, &ObservationType);
+        if (self == NULL)
+        {
+            return NULL;
+        }
     }
 
-    now=CurrentDaynum();
+    self->obs = *obs;
+    self->fields = NULL;
+    return (PyObject *)self;
+}
+
+static void Observation_dealloc(Observation *self)
+{
+    PyObject_GC_UnTrack(self);
+    Py_CLEAR(self->fields);
 
-    if (load(args) != 0)
+    if (observation_free < OBSERVATION_FREELIST)
     {
-        // load will set the appropriate exception string if it fails.
-        goto cleanup_and_raise_exception;
+        observation_freelist[observation_free++] = self;
     }
-
-    //TODO: Seems like this should be based on the freshness of the TLE, not wall clock.
-    if ((daynum<now-365.0) || (daynum>now+365.0))
+    else
     {
-        sprintf(errbuff, "time %s too far from present\n", Daynum2String(daynum));
-        PyErr_SetString(PyExc_RuntimeError, errbuff);
-        goto cleanup_and_raise_exception;
+        PyObject_GC_Del(self);
     }
+}
 
-    PreCalc(0);
-    Calc();
-
-    if (MakeObservation(daynum, &obs) != 0)
+// Frees the observations kept for reuse, when the module goes.
+static void ClearObservationFreelist(void)
+{
+    while (observation_free > 0)
     {
-        // MakeObservation will set appropriate exception string
-        goto cleanup_and_raise_exception;
+        PyObject_GC_Del(observation_freelist[--observation_free]);
     }
+}
+
+static int Observation_traverse(Observation *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->fields);
+    return 0;
+}
+
+static int Observation_clear(Observation *self)
+{
+    Py_CLEAR(self->fields);
+    return 0;
+}
+
+// Field index of key in self, or -1 with no exception set if it isn't one, or was skipped.
+static Py_ssize_t ObservationIndex(Observation *self, PyObject *key) {
+    PyObject *index = PyDict_GetItem(ObservationKeys, key);
+    Py_ssize_t i;
 
-    if (!AosHappens(0))
+    if (index == NULL)
     {
-        sprintf(errbuff, "%lu does not rise above horizon. No AOS.\n", sat.catnum);
-        PyErr_SetString(PyExc_RuntimeError, errbuff);
-        goto cleanup_and_raise_exception;
+        return -1;
     }
 
-    if (Geostationary(0)!=0)
+    i = PyLong_AsSsize_t(index);
+    return (ObservationField(i)->stage & self->obs.skipped) ? -1 : i;
+}
+
+static PyObject* Observation_subscript(Observation *self, PyObject *key)
+{
+    Py_ssize_t i;
+
+    if (self->fields != NULL)
     {
-        sprintf(errbuff, "%lu is geostationary.  Does not transit.\n", sat.catnum);
-        PyErr_SetString(PyExc_RuntimeError, errbuff);
-        goto cleanup_and_raise_exception;
+        return PyObject_GetItem(self->fields, key);
     }
 
-    if (Decayed(indx,daynum)!=0)
+    i = ObservationIndex(self, key);
+    if (i < 0)
     {
-        sprintf(errbuff, "%lu has decayed. Cannot calculate transit.\n", sat.catnum);
-        PyErr_SetString(PyExc_RuntimeError, errbuff);
-        goto cleanup_and_raise_exception;
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
     }
 
-    /* Make Predictions */
-    daynum=FindAOS();
+    return BoxObservationField(&self->obs, i);
+}
 
-    /* Construct the pass */
-    PyObject * py_obs;
+static PyObject* Observation_getattro(Observation *self, PyObject *name)
+{
+    Py_ssize_t i;
+    PyObject *value;
 
-    while (iel>=0)
+    if (self->fields != NULL)
     {
-        if (MakeObservation(daynum, &obs) != 0)
+        value = PyDict_GetItem(self->fields, name);
+        if (value == NULL)
         {
-            //MakeObservation will set appropriate exception string
-            goto cleanup_and_raise_exception;
+            return PyObject_GenericGetAttr((PyObject *)self, name);
         }
+        Py_INCREF(value);
+        return value;
+    }
 
-        py_obs = PythonifyObservation(&obs);
+    i = ObservationIndex(self, name);
+    if (i < 0)
+    {
+        return PyObject_GenericGetAttr((PyObject *)self, name);
+    }
 
-        if (py_obs == NULL) {
-            sprintf(errbuff, "Failed to PythonifyObservation. Cannot calculate transit.\n");
-            PyErr_SetString(PyExc_RuntimeError, errbuff);
-            goto cleanup_and_raise_exception;
-        }
+    return BoxObservationField(&self->obs, i);
+}
 
-        if (PyList_Append(transit, py_obs) != 0)
+// Assigns (or deletes, if value is NULL) key, as in a dictionary.  The first one boxes every
+// field into self->fields, which holds the observation from then on.
+static int Observation_ass_subscript(Observation *self, PyObject *key, PyObject *value)
+{
+    if (self->fields == NULL)
+    {
+        self->fields = DictifyObservation(&self->obs);
+        if (self->fields == NULL)
         {
-            goto cleanup_and_raise_exception;
+            return -1;
         }
+        PyObject_GC_Track(self);
+    }
+
+    if (value == NULL)
+    {
+        return PyObject_DelItem(self->fields, key);
+    }
 
-        lastel=iel;
-        daynum+=cos((sat_ele-1.0)*deg2rad)*sqrt(sat_alt)/25000.0;
-        Calc();
+    return PyObject_SetItem(self->fields, key, value);
+}
+
+static Py_ssize_t Observation_length(Observation *self)
+{
+    Py_ssize_t i, n = 0;
+
+    if (self->fields != NULL)
+    {
+        return PyDict_Size(self->fields);
     }
 
-    if (lastel!=0)
+    for (i=0; i<(Py_ssize_t)NUM_OBSERVATION_KEYS; i++)
     {
-        daynum=FindLOS();
+        n += HAS_FIELD(&self->obs, i);
+    }
 
-        //TODO: FindLOS can fail.  Detect and log warning that transit end is approximate.
-        if (daynum > 0) {
-            Calc();
+    return n;
+}
 
-            if (MakeObservation(daynum, &obs) != 0)
-            {
-                goto cleanup_and_raise_exception;
-            }
+static int Observation_contains(Observation *self, PyObject *key)
+{
+    if (self->fields != NULL)
+    {
+        return PyDict_Contains(self->fields, key);
+    }
 
-            py_obs = PythonifyObservation(&obs);
+    return ObservationIndex(self, key) >= 0;
+}
 
-            if (py_obs == NULL) {
-                sprintf(errbuff, "Failed to PythonifyObservation. Cannot calculate transit.\n");
-                goto cleanup_and_raise_exception;
-            }
+static PyObject* Observation_keys(Observation *self)
+{
+    Py_ssize_t i;
+    PyObject *list;
 
-            if (PyList_Append(transit, py_obs) != 0)
-            {
-                goto cleanup_and_raise_exception;
-            }
-        }
+    if (self->fields != NULL)
+    {
+        return PyDict_Keys(self->fields);
     }
 
-    return transit;
+    if (!self->obs.skipped)
+    {
+        return PySequence_List(ObservationKeyList);
+    }
 
-cleanup_and_raise_exception:
-    Py_XDECREF(transit);
-    return NULL;
+    list = PyList_New(0);
+    for (i=0; list != NULL && i<(Py_ssize_t)NUM_OBSERVATION_KEYS; i++)
+    {
+        if (HAS_FIELD(&self->obs, i) && PyList_Append(list, PyTuple_GET_ITEM(ObservationKeyList, i)) != 0)
+        {
+            Py_CLEAR(list);
+        }
+    }
+
+    return list;
 }
 
-static char quick_predict_docs[] =
-    "quick_predict((tle_line0, tle_line1, tle_line2), time, (gs_lat, gs_lon, gs_alt))\n";
+static PyObject* Observation_iter(Observation *self)
+{
+    PyObject *keys, *iter;
 
-static PyMethodDef pypredict_funcs[] = {
-    {"quick_find"   , (PyCFunction)quick_find   , METH_VARARGS, quick_find_docs},
-    {"quick_predict", (PyCFunction)quick_predict, METH_VARARGS, quick_predict_docs},
-    {NULL, NULL, 0, NULL}
-};
+    if (self->fields != NULL)
+    {
+        return PyObject_GetIter(self->fields);
+    }
 
-#if PY_MAJOR_VERSION >= 3
-    static int cpredict_traverse(PyObject *m, visitproc visit, void *arg) {
-        return 0;
+    if (!self->obs.skipped)
+    {
+        return PyObject_GetIter(ObservationKeyList);
     }
 
-    static int cpredict_clear(PyObject *m) {
-        return 0;
+    keys = Observation_keys(self);
+    if (keys == NULL)
+    {
+        return NULL;
     }
 
-    static struct PyModuleDef moduledef = {
-        PyModuleDef_HEAD_INIT,
-        "cpredict",
-        "Python port of the predict open source satellite tracking library",
-        0,
-        pypredict_funcs,
-        NULL,
-        cpredict_traverse,
-        cpredict_clear,
-        NULL
-    };
+    iter = PyObject_GetIter(keys);
+    Py_DECREF(keys);
+    return iter;
+}
 
-    PyMODINIT_FUNC
-    PyInit_cpredict(void)
+// Every field boxed into a new dictionary.
+static PyObject* Observation_dict(Observation *self)
+{
+    if (self->fields != NULL)
     {
-        PyObject *module = PyModule_Create(&moduledef);
+        return PyDict_Copy(self->fields);
+    }
 
-        if (module == NULL) {
-            fprintf(stderr, "ERROR: Unable to initialize python module 'cpredict'\n");
+    return DictifyObservation(&self->obs);
+}
+
+static PyObject* Observation_values(Observation *self)
+{
+    Py_ssize_t i, n = 0;
+    PyObject *list, *value;
+
+    if (self->fields != NULL)
+    {
+        return PyDict_Values(self->fields);
+    }
+
+    list = PyList_New(Observation_length(self));
+    if (list == NULL)
+    {
+        return NULL;
+    }
+
+    for (i=0; i<(Py_ssize_t)NUM_OBSERVATION_KEYS; i++)
+    {
+        if (!HAS_FIELD(&self->obs, i))
+        {
+            continue;
+        }
+
+        value = BoxObservationField(&self->obs, i);
+        if (value == NULL)
+        {
+            Py_DECREF(list);
             return NULL;
         }
+        PyList_SET_ITEM(list, n++, value);
+    }
 
-        return module;
+    return list;
+}
+
+static PyObject* Observation_items(Observation *self)
+{
+    Py_ssize_t i, n = 0;
+    PyObject *list, *item;
+
+    if (self->fields != NULL)
+    {
+        return PyDict_Items(self->fields);
     }
-#else
-    void initcpredict(void)
+
+    list = PyList_New(Observation_length(self));
+    if (list == NULL)
     {
-        PyObject *m;
-        m = Py_InitModule3("cpredict", pypredict_funcs,
-                        "Python port of the predict open source satellite tracking library");
+        return NULL;
+    }
+
+    for (i=0; i<(Py_ssize_t)NUM_OBSERVATION_KEYS; i++)
+    {
+        if (!HAS_FIELD(&self->obs, i))
+        {
+            continue;
+        }
+
+        item = Py_BuildValue("(ON)", PyTuple_GET_ITEM(ObservationKeyList, i), BoxObservationField(&self->obs, i));
+        if (item == NULL)
+        {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, n++, item);
+    }
+
+    return list;
+}
+
+static PyObject* Observation_get(Observation *self, PyObject *args)
+{
+    PyObject *key, *fallback = Py_None, *value;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "O|O", &key, &fallback))
+    {
+        return NULL;
+    }
+
+    if (self->fields != NULL)
+    {
+        value = PyDict_GetItem(self->fields, key);
+        value = value != NULL ? value : fallback;
+        Py_INCREF(value);
+        return value;
+    }
+
+    i = ObservationIndex(self, key);
+    if (i < 0)
+    {
+        Py_INCREF(fallback);
+        return fallback;
+    }
+
+    return BoxObservationField(&self->obs, i);
+}
+
+static PyObject* Observation_repr(Observation *self)
+{
+    PyObject *dict, *repr;
+
+    dict = Observation_dict(self);
+    if (dict == NULL)
+    {
+        return NULL;
+    }
+
+    repr = PyObject_Repr(dict);
+    Py_DECREF(dict);
+    return repr;
+}
+
+// Observations compare equal to each other, and to dictionaries, field by field.
+static PyObject* Observation_richcompare(PyObject *self, PyObject *other, int op)
+{
+    PyObject *mine, *theirs, *result;
+
+    if ((op != Py_EQ && op != Py_NE) || !(PyObject_TypeCheck(other, &ObservationType) || PyDict_Check(other)))
+    {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+
+    mine = Observation_dict((Observation *)self);
+    if (mine == NULL)
+    {
+        return NULL;
+    }
+
+    if (PyDict_Check(other))
+    {
+        theirs = other;
+        Py_INCREF(theirs);
+    }
+    else
+    {
+        theirs = Observation_dict((Observation *)other);
+        if (theirs == NULL)
+        {
+            Py_DECREF(mine);
+            return NULL;
+        }
+    }
+
+    result = PyObject_RichCompare(mine, theirs, op);
+    Py_DECREF(mine);
+    Py_DECREF(theirs);
+    return result;
+}
+
+// Pickles, and copy.copy()s, as the dictionary of its fields, which is what observations were
+// before and is independent of the layout of struct observation.
+static PyObject* Observation_reduce(Observation *self)
+{
+    return Py_BuildValue("(O(N))", (PyObject *)&PyDict_Type, Observation_dict(self));
+}
+
+static PyMethodDef Observation_methods[] = {
+    {"keys"  , (PyCFunction)Observation_keys  , METH_NOARGS , "keys()\nReturns the field names.\n"},
+    {"values", (PyCFunction)Observation_values, METH_NOARGS , "values()\nReturns the field values.\n"},
+    {"items" , (PyCFunction)Observation_items , METH_NOARGS , "items()\nReturns (name, value) of every field.\n"},
+    {"get"   , (PyCFunction)Observation_get   , METH_VARARGS, "get(key[, default])\nReturns the field named key, or default.\n"},
+    {"copy"  , (PyCFunction)Observation_dict  , METH_NOARGS , "copy()\nReturns the fields as a dictionary.\n"},
+    {"__reduce__", (PyCFunction)Observation_reduce, METH_NOARGS, "Pickles as the dictionary of the fields.\n"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMappingMethods Observation_as_mapping = {
+    (lenfunc)Observation_length,                /* mp_length */
+    (binaryfunc)Observation_subscript,          /* mp_subscript */
+    (objobjargproc)Observation_ass_subscript,   /* mp_ass_subscript */
+};
+
+static PySequenceMethods Observation_as_sequence = {
+    0,                                          /* sq_length */
+    0,                                          /* sq_concat */
+    0,                                          /* sq_repeat */
+    0,                                          /* sq_item */
+    0,                                          /* sq_slice */
+    0,                                          /* sq_ass_item */
+    0,                                          /* sq_ass_slice */
+    (objobjproc)Observation_contains,           /* sq_contains */
+};
+
+static PyTypeObject ObservationType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Observation",                     /* tp_name */
+    sizeof(Observation),                        /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Observation_dealloc,            /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    (reprfunc)Observation_repr,                 /* tp_repr */
+    0,                                          /* tp_as_number */
+    &Observation_as_sequence,                   /* tp_as_sequence */
+    &Observation_as_mapping,                    /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    (getattrofunc)Observation_getattro,         /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,    /* tp_flags */
+    "An observation of a satellite, read by attribute or by key like a dictionary.\n", /* tp_doc */
+    (traverseproc)Observation_traverse,         /* tp_traverse */
+    (inquiry)Observation_clear,                 /* tp_clear */
+    Observation_richcompare,                    /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    (getiterfunc)Observation_iter,              /* tp_iter */
+    0,                                          /* tp_iternext */
+    Observation_methods,                        /* tp_methods */
+};
+
+// PEP 3118 format of one struct observation, each field named by its key.  Built when the
+// module is initialized, from the field tables, padded to the struct's own layout.
+static char ObservationFormat[1024];
+
+int LoadObservationFormat() {
+    size_t i, j, offset = 0, size, length = 0;
+    const observation_field *fields[NUM_OBSERVATION_KEYS], *field;
+    char code[8];
+
+    for (i=0; i<NUM_OBSERVATION_KEYS; i++)
+    {
+        // Insertion sort by offset: the tables are in key order, not member order.
+        for (j=i; j>0 && fields[j-1]->offset > ObservationField(i)->offset; j--)
+        {
+            fields[j] = fields[j-1];
+        }
+        fields[j] = ObservationField(i);
+    }
+
+    // '=' for standard sizes and no implicit alignment, so the padding below is all there is.
+    length += snprintf(ObservationFormat + length, sizeof(ObservationFormat) - length, "T{=");
+    for (i=0; i<=NUM_OBSERVATION_KEYS; i++)
+    {
+        field = i < NUM_OBSERVATION_KEYS ? fields[i] : NULL;
+        size = field != NULL ? field->offset : sizeof(observation);
+        if (size > offset)
+        {
+            length += snprintf(ObservationFormat + length, sizeof(ObservationFormat) - length, "%dx", (int)(size - offset));
+        }
+        if (field == NULL)
+        {
+            break;
+        }
+
+        switch (field->typecode)
+        {
+            case 'd': size = sizeof(double); strcpy(code, "d"); break;
+            case 'l': size = sizeof(long); strcpy(code, sizeof(long) == 8 ? "q" : "i"); break;
+            case 'b': size = sizeof(char); strcpy(code, "b"); break;
+            case 'c': size = sizeof(char); strcpy(code, "c"); break;
+            case 's':
+                size = field->offset == offsetof(observation, name) ?
+                    sizeof(((observation *)0)->name) : sizeof(((observation *)0)->orbital_model);
+                snprintf(code, sizeof(code), "%ds", (int)size);
+                break;
+            default:  return -1;
+        }
+        length += snprintf(ObservationFormat + length, sizeof(ObservationFormat) - length, "%s:%s:", code, field->key);
+        offset = field->offset + size;
+    }
+    length += snprintf(ObservationFormat + length, sizeof(ObservationFormat) - length, "}");
+
+    return length < sizeof(ObservationFormat) ? 0 : -1;
+}
+
+// A batch of observations laid out as an array of struct observation, which it exports through
+// the buffer protocol with ObservationFormat, so numpy.asarray() (or pandas, or arrow) wraps the
+// rows as a structured array without copying them.  Indexing it gives an Observation.
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t count;
+    observation *rows;
+} Observations;
+
+static Py_ssize_t observation_stride = sizeof(observation);
+
+static void Observations_dealloc(Observations *self)
+{
+    free(self->rows);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t Observations_length(Observations *self)
+{
+    return self->count;
+}
+
+static PyObject* Observations_item(Observations *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= self->count)
+    {
+        PyErr_SetString(PyExc_IndexError, "observation index out of range");
+        return NULL;
+    }
+    return PythonifyObservation(&self->rows[i]);
+}
+
+static int Observations_getbuffer(Observations *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "Observations are read only");
+        view->obj = NULL;
+        return -1;
+    }
+
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->buf = self->rows;
+    view->len = self->count * sizeof(observation);
+    view->readonly = 1;
+    view->itemsize = sizeof(observation);
+    view->format = (flags & PyBUF_FORMAT) ? ObservationFormat : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &self->count : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &observation_stride : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PySequenceMethods Observations_as_sequence = {
+    (lenfunc)Observations_length,               /* sq_length */
+    0,                                          /* sq_concat */
+    0,                                          /* sq_repeat */
+    (ssizeargfunc)Observations_item,            /* sq_item */
+};
+
+static PyBufferProcs Observations_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0,                                          /* bf_getreadbuffer */
+    0,                                          /* bf_getwritebuffer */
+    0,                                          /* bf_getsegcount */
+    0,                                          /* bf_getcharbuffer */
+#endif
+    (getbufferproc)Observations_getbuffer,      /* bf_getbuffer */
+    0,                                          /* bf_releasebuffer */
+};
+
+#if PY_MAJOR_VERSION < 3
+#define OBSERVATIONS_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER)
+#else
+#define OBSERVATIONS_TPFLAGS Py_TPFLAGS_DEFAULT
+#endif
+
+static PyTypeObject ObservationsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Observations",                    /* tp_name */
+    sizeof(Observations),                       /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Observations_dealloc,           /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &Observations_as_sequence,                  /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    &Observations_as_buffer,                    /* tp_as_buffer */
+    OBSERVATIONS_TPFLAGS,                       /* tp_flags */
+    "Observations of a satellite stored as C structs, exporting a structured buffer.\n", /* tp_doc */
+};
+
+void load_checksums() {
+    int x;
+
+    /* Set up translation table for computing TLE checksums */
+    for (x=0; x<=255; val[x]=0, x++);
+    for (x='0'; x<='9'; val[x]=x-'0', x++);
+
+    val['-']=1;
+}
+
+char load_tle(context_t *ctx, const char *tle0, const char *tle1, const char *tle2) {
+    // NOTE: val[] is filled in once, when the module is initialized.
+    if (ReadTLE(&ctx->sat,tle0,tle1,tle2) != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to process TLE");
+        return -1;
+    }
+
+    // Select the ephemeris and run the SGP4/SDP4 initialization.
+    PreCalc(ctx);
+    return 0;
+}
+
+char load_qth(context_t *ctx, int has_qth, double stnlat, double stnlong, int stnalt) {
+    char *env=NULL;
+    char qthfile[PATH_MAX];
+
+    // If we haven't already set groundstation location, use predict's default.
+    if (!has_qth)
+    {
+        env=getenv("HOME");
+        snprintf(qthfile,sizeof(qthfile),"%s/.predict/predict.qth",env);
+        if (ReadQTHFile(ctx,qthfile) != 0)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "QTH file could not be loaded.");
+            return -1;
+        }
+    }
+    else
+    {
+        ReadQTH(ctx,stnlat,stnlong,stnalt);
+    }
+
+    return 0;
+}
+
+char load_time(context_t *ctx, int has_time, double epoch) {
+    // If time isn't set, use current time.
+    if (!has_time)
+    {
+        ctx->daynum=CurrentDaynum();
+    }
+    else
+    {
+        ctx->daynum=((epoch/86400.0)-3651.0);
+    }
+
+    return 0;
+}
+
+char load(context_t *ctx, PyObject *args) {
+    double epoch, stnlat, stnlong;
+    int stnalt;
+    const char *tle0, *tle1, *tle2;
+
+    if (!PyArg_ParseTuple(args, "(sss)|d(ddi)",
+        &tle0, &tle1, &tle2, &epoch, &stnlat, &stnlong, &stnalt))
+    {
+        // PyArg_ParseTuple will set appropriate exception string
+        return -1;
+    };
+
+    if (load_tle(ctx, tle0, tle1, tle2) != 0 ||
+        load_time(ctx, PyObject_Length(args) >= 2, epoch) != 0 ||
+        load_qth(ctx, PyObject_Length(args) >= 3, stnlat, stnlong, stnalt) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Observations collected along a pass, grown as the pass is stepped through.
+typedef struct {
+    observation *obs;
+    int count;
+    int size;
+} pass_t;
+
+int AppendObservation(pass_t *pass, observation *obs) {
+    observation *grown;
+
+    if (pass->count == pass->size)
+    {
+        grown = realloc(pass->obs, sizeof(observation) * (pass->size ? 2 * pass->size : 64));
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        pass->obs = grown;
+        pass->size = pass->size ? 2 * pass->size : 64;
+    }
+
+    pass->obs[pass->count++] = *obs;
+    return 0;
+}
+
+// Appends an observation of ctx at ctx->daynum to pass, with every stage of it worked out that
+// isn't in skipped, whichever stages ctx is skipping meanwhile.  Returns -1 if it couldn't be
+// stored.
+int KeepSample(context_t *ctx, pass_t *pass, int skipped) {
+    observation obs = { 0 };
+    int skipping = ctx->flags & SKIP_FLAGS;
+
+    ClearFlag(ctx, SKIP_FLAGS);
+    SetFlag(ctx, skipped);
+    MakeObservation(ctx, ctx->daynum, &obs);
+    ClearFlag(ctx, SKIP_FLAGS);
+    SetFlag(ctx, skipping);
+
+    return AppendObservation(pass, &obs);
+}
+
+// Steps through the next pass at or after ctx->daynum, the way predict's Predict mode does.
+// Every sample along the way is appended to pass, unless it is NULL.  The epochs of the
+// first and last sample are stored in start and end.  Unless peak is NULL, the epoch of
+// maximum elevation is found between the samples either side of the highest and stored in it.
+//
+// NOTE: This doesn't touch any python objects, so it can (and should) run without the GIL.
+//       On failure, the reason is written to errbuff (at least 100 chars) and -1 is returned,
+//       or -2 if the samples couldn't be stored.
+//
+// NOTE: The deep-space caches are reset before every step, as MakeObservation does, so the
+//       pass is computed the same way whether or not the samples are being collected.  Only
+//       elevation and altitude steer the steps, so the sun is left out of them.
+//
+int TracePass(context_t *ctx, pass_t *pass, double *start, double *end, double *peak, char *errbuff) {
+    double epoch, t, ele, up=0.0, ele_up=0.0, down=0.0, ele_down=0.0, highest=-90.0;
+    double before=0.0, after=0.0, top=0.0;
+    char timestr[25];
+    int rc=0, skipped=ctx->flags&SKIP_FLAGS;
+
+    // Passes are only as good as the elements are fresh, which is a matter of how far the time
+    // is from their epoch rather than from the wall clock, so historical element sets work too.
+    epoch=Julian_Date_of_Epoch(ctx->tle.epoch)-2444238.5;
+    if ((ctx->daynum<epoch-365.0) || (ctx->daynum>epoch+365.0))
+    {
+        sprintf(errbuff, "time %s too far from element set epoch\n", Daynum2String(ctx->daynum,timestr));
+        return -1;
+    }
+
+    ResetDeep(ctx);
+    Calc(ctx);
+
+    if (!AosHappens(ctx))
+    {
+        sprintf(errbuff, "%lu does not rise above horizon. No AOS.\n", ctx->sat.catnum);
+        return -1;
+    }
+
+    if (Geostationary(ctx)!=0)
+    {
+        sprintf(errbuff, "%lu is geostationary.  Does not transit.\n", ctx->sat.catnum);
+        return -1;
+    }
+
+    if (Decayed(ctx,ctx->daynum)!=0)
+    {
+        sprintf(errbuff, "%lu has decayed. Cannot calculate transit.\n", ctx->sat.catnum);
+        return -1;
+    }
+
+    /* Make Predictions */
+    SetFlag(ctx, SKIP_SOLAR_FLAG);
+    ctx->daynum=FindAOS(ctx);
+    if (ctx->daynum == 0.0)
+    {
+        sprintf(errbuff, "%lu AOS not found after %ld evaluations.\n", ctx->sat.catnum, ctx->evaluations);
+        rc=-1;
+        goto done;
+    }
+    *start=*end=(ctx->daynum+3651.0)*(86400.0);
+    t=ctx->daynum;
+
+    /* Construct the pass, noting the last step that takes the satellite below the horizon */
+    while (ctx->iel>=0)
+    {
+        // Every step resets the deep-space caches, so ctx already holds what MakeObservation
+        // would work out here, but for the sun, and it is only called for the samples kept.
+        if (pass != NULL && KeepSample(ctx, pass, skipped) != 0)
+        {
+            rc=-2;
+            goto done;
+        }
+
+        *end=(ctx->daynum+3651.0)*(86400.0);
+
+        ele=ctx->sat_ele;
+        if (ele > highest)
+        {
+            highest=ele;
+            before=t;
+            top=ctx->daynum;
+        }
+
+        t=ctx->daynum;
+        ctx->daynum+=cos((ctx->sat_ele-1.0)*deg2rad)*sqrt(ctx->sat_alt)/25000.0;
+        ResetDeep(ctx);
+        Calc(ctx);
+
+        if (top == t)
+        {
+            after=ctx->daynum;
+        }
+
+        if (ele>=0.0 && ctx->sat_ele<0.0)
+        {
+            up=t;
+            ele_up=ele;
+            down=ctx->daynum;
+            ele_down=ctx->sat_ele;
+        }
+    }
+
+    /* That step brackets LOS, so it needn't be searched for like AOS */
+    if (down!=0.0)
+    {
+        ctx->evaluations=0;
+        ctx->daynum=FindCrossing(ctx, down, ele_down, up, ele_up);
+
+        *end=(ctx->daynum+3651.0)*(86400.0);
+
+        if (ctx->sat_ele > highest)
+        {
+            highest=ctx->sat_ele;
+            before=up;
+            after=top=ctx->daynum;
+        }
+
+        if (pass != NULL && KeepSample(ctx, pass, skipped) != 0)
+        {
+            rc=-2;
+            goto done;
+        }
+    }
+
+    if (peak != NULL)
+    {
+        *peak=(top+3651.0)*(86400.0);
+
+        if (after > before)
+        {
+            *peak=(FindPeak(ctx, before, after)+3651.0)*(86400.0);
+        }
+    }
+
+done:
+    ClearFlag(ctx, SKIP_FLAGS);
+    SetFlag(ctx, skipped);
+    return rc;
+}
+
+// Runs TracePass with the GIL released, then appends its samples to transit unless it is NULL,
+// each one boxed by box.
+int MakePass(context_t *ctx, PyObject *transit, PyObject *(*box)(const observation *),
+             double *start, double *end, double *peak) {
+    int i, rc;
+    char errbuff[100];
+    pass_t pass = { 0 };
+    PyObject * py_obs;
+
+    Py_BEGIN_ALLOW_THREADS
+    rc = TracePass(ctx, transit != NULL ? &pass : NULL, start, end, peak, errbuff);
+    Py_END_ALLOW_THREADS
+
+    if (rc == -2)
+    {
+        PyErr_NoMemory();
+        rc = -1;
+        goto cleanup;
+    }
+    else if (rc != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, errbuff);
+        goto cleanup;
+    }
+
+    for (i=0; i<pass.count; i++)
+    {
+        py_obs = box(&pass.obs[i]);
+
+        if (py_obs == NULL) {
+            sprintf(errbuff, "Failed to PythonifyObservation. Cannot calculate transit.\n");
+            PyErr_SetString(PyExc_RuntimeError, errbuff);
+            rc = -1;
+            goto cleanup;
+        }
+
+        if (PyList_Append(transit, py_obs) != 0)
+        {
+            Py_DECREF(py_obs);
+            rc = -1;
+            goto cleanup;
+        }
+        Py_DECREF(py_obs);
+    }
+
+cleanup:
+    free(pass.obs);
+    return rc;
+}
+
+static PyObject* quick_find(PyObject* self, PyObject *args)
+{
+    struct observation obs = { 0 };
+    context_t ctx = { 0 };
+
+    if (load(&ctx, args) != 0)
+    {
+        // load will set appropriate exceptions if it fails.
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    MakeObservation(&ctx, ctx.daynum, &obs);
+    Py_END_ALLOW_THREADS
+
+    return DictifyObservation(&obs);
+}
+
+static char quick_find_docs[] =
+    "quick_find((tle_line0, tle_line1, tle_line2), time, (gs_lat, gs_lon, gs_alt))\n";
+
+static PyObject* quick_predict(PyObject* self, PyObject *args)
+{
+    double start, end;
+    context_t ctx = { 0 };
+
+    PyObject* transit = PyList_New(0);
+
+    if (transit == NULL)
+    {
+        goto cleanup_and_raise_exception;
+    }
+
+    if (load(&ctx, args) != 0)
+    {
+        // load will set the appropriate exception string if it fails.
+        goto cleanup_and_raise_exception;
+    }
+
+    if (MakePass(&ctx, transit, DictifyObservation, &start, &end, NULL) != 0)
+    {
+        // MakePass will set the appropriate exception string if it fails.
+        goto cleanup_and_raise_exception;
+    }
+
+    return transit;
+
+cleanup_and_raise_exception:
+    Py_XDECREF(transit);
+    return NULL;
+}
+
+static char quick_predict_docs[] =
+    "quick_predict((tle_line0, tle_line1, tle_line2), time, (gs_lat, gs_lon, gs_alt))\n";
+
+static PyObject *simd_kernels(PyObject *self, PyObject *args)
+{
+    return Py_BuildValue("s", SGP4BatchKernels());
+}
+
+static char simd_kernels_docs[] =
+    "simd_kernels()\n"
+    "Returns the name of the instruction set the batch kernels in use were built for: 'avx512',\n"
+    "'avx2' or 'sse2' on x86-64, 'neon' on AArch64, or 'generic'.  The best the processor supports\n"
+    "is picked at import, unless the PYPREDICT_KERNELS environment variable names another it\n"
+    "supports; if it names one it doesn't, a RuntimeWarning says so.\n";
+
+// Ground stations with their time-independent geometry worked out once, so that a satellite
+// propagated once can be observed from all of them cheaply.  The stations are read with the GIL
+// released, so they never change once made, and are made by tp_new.
+typedef struct {
+    PyObject_HEAD
+    int count;
+    station_t *station;
+} Stations;
+
+static void Stations_dealloc(Stations *self)
+{
+    free(self->station);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject* Stations_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *qths, *seq;
+    station_t *station;
+    Stations *self;
+    double stnlat, stnlong;
+    int stnalt;
+    Py_ssize_t i, count;
+
+    if (!PyArg_ParseTuple(args, "O", &qths))
+    {
+        return NULL;
+    }
+
+    seq = PySequence_Fast(qths, "Stations needs a sequence of (lat, long, alt)");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    count = PySequence_Fast_GET_SIZE(seq);
+    if (count > INT_MAX)
+    {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "Too many stations.");
+        return NULL;
+    }
+
+    station = malloc(sizeof(station_t) * (count ? count : 1));
+    if (station == NULL)
+    {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+
+    for (i=0; i<count; i++)
+    {
+        if (!PyArg_Parse(PySequence_Fast_GET_ITEM(seq, i), "(ddi)", &stnlat, &stnlong, &stnalt))
+        {
+            free(station);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        Prepare_Station(&station[i], stnlat, stnlong, stnalt);
+    }
+
+    Py_DECREF(seq);
+
+    self = (Stations *)type->tp_alloc(type, 0);
+    if (self == NULL)
+    {
+        free(station);
+        return NULL;
+    }
+    self->station = station;
+    self->count = (int)count;
+    return (PyObject *)self;
+}
+
+static Py_ssize_t Stations_length(Stations *self)
+{
+    return self->count;
+}
+
+static PySequenceMethods Stations_as_sequence = {
+    (lenfunc)Stations_length,                   /* sq_length */
+};
+
+static PyTypeObject StationsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Stations",                        /* tp_name */
+    sizeof(Stations),                           /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Stations_dealloc,               /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &Stations_as_sequence,                      /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /* tp_flags */
+    "Stations([(gs_lat, gs_lon, gs_alt), ...])\n"
+    "Ground stations prepared once, to observe satellites from all at once.\n", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    0,                                          /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    0,                                          /* tp_init */
+    0,                                          /* tp_alloc */
+    Stations_new,                               /* tp_new */
+};
+
+// Returns a new reference to stations if it is already a Stations, or else to a Stations built
+// from it as a sequence of (lat, long, alt).
+Stations * AsStations(PyObject *stations) {
+    if (PyObject_TypeCheck(stations, &StationsType))
+    {
+        Py_INCREF(stations);
+        return (Stations *)stations;
+    }
+
+    return (Stations *)PyObject_CallFunctionObjArgs((PyObject *)&StationsType, stations, NULL);
+}
+
+// A satellite whose TLE has been parsed and whose SGP4/SDP4 initialization has been done once,
+// so that it can be observed over and over without paying for either again.
+//
+// NOTE: Methods propagate a copy of ctx with the GIL released, so one Satellite can be shared
+//       by any number of threads.  The copies share the table of deep-space checkpoints that
+//       ctx points to, so each resumes from those the others kept.  Re-initializing retires
+//       the table, as copies may still be using it, and the retired are freed with the Satellite.
+typedef struct {
+    PyObject_HEAD
+    context_t ctx;
+    deep_checkpoints_t *retired;
+} Satellite;
+
+static int Satellite_init(Satellite *self, PyObject *args, PyObject *kwds)
+{
+    const char *tle0, *tle1, *tle2;
+
+    if (!PyArg_ParseTuple(args, "(sss)", &tle0, &tle1, &tle2))
+    {
+        return -1;
+    }
+
+    if (self->ctx.sdp4.deep.kept != NULL)
+    {
+        self->ctx.sdp4.deep.kept->next = self->retired;
+        self->retired = self->ctx.sdp4.deep.kept;
+    }
+
+    memset(&self->ctx, 0, sizeof(self->ctx));
+
+    if (load_tle(&self->ctx, tle0, tle1, tle2) != 0)
+    {
+        return -1;
+    }
+
+    if (KeepDeepCheckpoints(&self->ctx) != 0)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    return 0;
+}
+
+static void Satellite_dealloc(Satellite *self)
+{
+    FreeDeepCheckpoints(self->ctx.sdp4.deep.kept);
+    FreeDeepCheckpoints(self->retired);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject* Satellite_observe(Satellite *self, PyObject *args)
+{
+    double epoch, stnlat, stnlong;
+    int stnalt, skip;
+    struct observation obs = { 0 };
+    context_t ctx = self->ctx;
+    PyObject *fields = NULL;
+
+    if (!PyArg_ParseTuple(args, "|d(ddi)O", &epoch, &stnlat, &stnlong, &stnalt, &fields))
+    {
+        return NULL;
+    }
+
+    if (load_time(&ctx, PyObject_Length(args) >= 1, epoch) != 0 ||
+        load_qth(&ctx, PyObject_Length(args) >= 2, stnlat, stnlong, stnalt) != 0 ||
+        LoadFields(fields, &skip, NULL, NULL) != 0)
+    {
+        return NULL;
+    }
+    SetFlag(&ctx, skip);
+
+    Py_BEGIN_ALLOW_THREADS
+    MakeObservation(&ctx, ctx.daynum, &obs);
+    Py_END_ALLOW_THREADS
+
+    return PythonifyObservation(&obs);
+}
+
+static char Satellite_observe_docs[] =
+    "observe(time, (gs_lat, gs_lon, gs_alt)[, fields])\n"
+    "Given a sequence of field names, the observation may leave out any others, and skips\n"
+    "working out the sun, geodetic position or decay when none of those fields need them.\n";
+
+static PyObject* Satellite_passes(Satellite *self, PyObject *args)
+{
+    double ending_after, ending_before=0.0, ts, start, end;
+    double stnlat, stnlong;
+    double tolerance=0.0;
+    int stnalt, limit=-1, has_end;
+    PyObject *py_ending_before=Py_None, *passes, *pass;
+    context_t ctx;
+
+    if (!PyArg_ParseTuple(args, "(ddi)d|Oid",
+        &stnlat, &stnlong, &stnalt, &ending_after, &py_ending_before, &limit, &tolerance))
+    {
+        return NULL;
+    }
+
+    if (tolerance < 0.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "tolerance must not be negative.");
+        return NULL;
+    }
+
+    has_end = (py_ending_before != Py_None);
+    if (has_end)
+    {
+        ending_before = PyFloat_AsDouble(py_ending_before);
+        if (ending_before == -1.0 && PyErr_Occurred())
+        {
+            return NULL;
+        }
+    }
+    else if (limit < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "passes needs ending_before or limit to stop.");
+        return NULL;
+    }
+
+    ctx = self->ctx;
+    ctx.tolerance = tolerance / secday;
+    load_qth(&ctx, 1, stnlat, stnlong, stnalt);
+
+    passes = PyList_New(0);
+    if (passes == NULL)
+    {
+        return NULL;
+    }
+
+    ts = ending_after;
+    while (limit < 0 || PyList_GET_SIZE(passes) < limit)
+    {
+        load_time(&ctx, 1, ts);
+        if (MakePass(&ctx, NULL, NULL, &start, &end, NULL) != 0)
+        {
+            Py_DECREF(passes);
+            return NULL;
+        }
+
+        if (has_end && end > ending_before)
+        {
+            break;
+        }
+
+        if (end > ending_after)
+        {
+            pass = Py_BuildValue("(dd)", start, end);
+            if (pass == NULL || PyList_Append(passes, pass) != 0)
+            {
+                Py_XDECREF(pass);
+                Py_DECREF(passes);
+                return NULL;
+            }
+            Py_DECREF(pass);
+        }
+
+        // Need to advance time cursor so predict doesn't yield same pass
+        ts = end + 60;
+    }
+
+    return passes;
+}
+
+static char Satellite_passes_docs[] =
+    "passes((gs_lat, gs_lon, gs_alt), ending_after[, ending_before[, limit[, tolerance]]])\n"
+    "Returns (start, end) epochs of the passes ending after ending_after, stopping at the\n"
+    "first pass that ends after ending_before or once limit passes have been found.\n"
+    "start and end are within tolerance seconds (default 0.1) inside the horizon crossings.\n";
+
+static PyObject* Satellite_peak(Satellite *self, PyObject *args)
+{
+    double stnlat, stnlong, start, end, epsilon=0.1, peak;
+    int stnalt;
+    context_t ctx;
+
+    if (!PyArg_ParseTuple(args, "(ddi)dd|d", &stnlat, &stnlong, &stnalt, &start, &end, &epsilon))
+    {
+        return NULL;
+    }
+
+    if (end < start || epsilon <= 0.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "peak needs start <= end and a positive epsilon.");
+        return NULL;
+    }
+
+    ctx = self->ctx;
+    ctx.tolerance = epsilon / secday;
+    load_qth(&ctx, 1, stnlat, stnlong, stnalt);
+
+    Py_BEGIN_ALLOW_THREADS
+    peak = (FindPeak(&ctx, (start/86400.0)-3651.0, (end/86400.0)-3651.0)+3651.0)*(86400.0);
+    Py_END_ALLOW_THREADS
+
+    return PyFloat_FromDouble(peak);
+}
+
+static char Satellite_peak_docs[] =
+    "peak((gs_lat, gs_lon, gs_alt), start, end[, epsilon])\n"
+    "Returns the epoch within epsilon seconds (default 0.1) of maximum elevation between start\n"
+    "and end, over which the elevation must rise and then fall, as it does over a pass.\n";
+
+// What a Transits iterator yields for each pass: just its epochs, no samples.
+static PyStructSequence_Field transit_times_fields[] = {
+    {"start", "epoch of AOS"},
+    {"end", "epoch of LOS"},
+    {"peak", "epoch within tolerance of maximum elevation"},
+    {NULL, NULL}
+};
+
+static PyStructSequence_Desc transit_times_desc = {
+    "cpredict.TransitTimes",
+    "(start, end, peak) epochs of a pass.\n",
+    transit_times_fields,
+    3
+};
+
+static PyTypeObject TransitTimesType;
+
+// Iterates over the passes of a satellite over one ground station, one pass per next(), with
+// its own copy of the satellite's context carried from one pass to the next.  It holds on to
+// the satellite, whose deep-space checkpoints the copy shares.
+typedef struct {
+    PyObject_HEAD
+    context_t ctx;
+    PyObject *satellite;
+    double ts, ending_after, ending_before;
+    int has_end, done;
+} Transits;
+
+static PyObject* Transits_iternext(Transits *self)
+{
+    double start, end, peak;
+    PyObject *times;
+
+    while (!self->done)
+    {
+        load_time(&self->ctx, 1, self->ts);
+        if (MakePass(&self->ctx, NULL, NULL, &start, &end, &peak) != 0)
+        {
+            self->done = 1;
+            return NULL;
+        }
+
+        if (self->has_end && end > self->ending_before)
+        {
+            break;
+        }
+
+        // Need to advance time cursor so predict doesn't yield same pass
+        self->ts = end + 60;
+
+        if (end > self->ending_after)
+        {
+            times = PyStructSequence_New(&TransitTimesType);
+            if (times == NULL)
+            {
+                return NULL;
+            }
+
+            PyStructSequence_SET_ITEM(times, 0, PyFloat_FromDouble(start));
+            PyStructSequence_SET_ITEM(times, 1, PyFloat_FromDouble(end));
+            PyStructSequence_SET_ITEM(times, 2, PyFloat_FromDouble(peak));
+            if (PyErr_Occurred())
+            {
+                Py_DECREF(times);
+                return NULL;
+            }
+
+            return times;
+        }
+    }
+
+    self->done = 1;
+    return NULL;
+}
+
+static void Transits_dealloc(Transits *self)
+{
+    Py_DECREF(self->satellite);
+    PyObject_Del(self);
+}
+
+static PyTypeObject TransitsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Transits",                        /* tp_name */
+    sizeof(Transits),                           /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Transits_dealloc,               /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    "Iterator over the passes of a satellite, made by Satellite.transits.\n", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    PyObject_SelfIter,                          /* tp_iter */
+    (iternextfunc)Transits_iternext,            /* tp_iternext */
+};
+
+static PyObject* Satellite_transits(Satellite *self, PyObject *args)
+{
+    double stnlat, stnlong, tolerance=0.0;
+    int stnalt;
+    PyObject *py_ending_before=Py_None;
+    Transits *transits;
+
+    transits = PyObject_New(Transits, &TransitsType);
+    if (transits == NULL)
+    {
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    transits->satellite = (PyObject *)self;
+    transits->has_end = 0;
+    transits->done = 0;
+
+    if (!PyArg_ParseTuple(args, "(ddi)d|Od",
+        &stnlat, &stnlong, &stnalt, &transits->ending_after, &py_ending_before, &tolerance))
+    {
+        goto cleanup;
+    }
+
+    if (tolerance < 0.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "tolerance must not be negative.");
+        goto cleanup;
+    }
+
+    if (py_ending_before != Py_None)
+    {
+        transits->has_end = 1;
+        transits->ending_before = PyFloat_AsDouble(py_ending_before);
+        if (transits->ending_before == -1.0 && PyErr_Occurred())
+        {
+            goto cleanup;
+        }
+    }
+
+    transits->ctx = self->ctx;
+    transits->ctx.tolerance = tolerance / secday;
+    load_qth(&transits->ctx, 1, stnlat, stnlong, stnalt);
+    transits->ts = transits->ending_after;
+
+    return (PyObject *)transits;
+
+cleanup:
+    Py_DECREF(transits);
+    return NULL;
+}
+
+static char Satellite_transits_docs[] =
+    "transits((gs_lat, gs_lon, gs_alt), ending_after[, ending_before[, tolerance]])\n"
+    "Returns an iterator over the passes ending after ending_after, as TransitTimes (start, end,\n"
+    "peak) epochs, stopping at the first pass that ends after ending_before if it is given.\n"
+    "All three are within tolerance seconds (default 0.1), peak of maximum elevation.\n"
+    "Samples of the passes are never built, so this is cheaper than passes for many passes.\n";
+
+// array.array, looked up when the module is initialized.
+static PyObject *ArrayType = NULL;
+
+// Returns a zero filled array.array of n elements of the given typecode.
+PyObject * NewArray(char typecode, Py_ssize_t n) {
+    char code[2] = { typecode, '\0' };
+    PyObject *zero, *array;
+
+    zero = PyObject_CallFunction(ArrayType, "s(i)", code, 0);
+    if (zero == NULL)
+    {
+        return NULL;
+    }
+
+    array = PySequence_Repeat(zero, n);
+    Py_DECREF(zero);
+    return array;
+}
+
+// The epochs in times, which may be anything exporting a buffer of doubles (a float64 numpy
+// array or array('d')), read in place through *view, or else any sequence of numbers, copied
+// into a malloc'd array.  Give them back with ReleaseTimes.  Returns NULL with an exception set
+// on failure.
+double * LoadTimes(PyObject *times, Py_ssize_t *n, Py_buffer *view) {
+    PyObject *seq, *item;
+    double *out;
+    Py_ssize_t i;
+
+    if (PyObject_CheckBuffer(times) &&
+        PyObject_GetBuffer(times, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0)
+    {
+        if (view->itemsize == sizeof(double) && view->format != NULL && strcmp(view->format, "d") == 0)
+        {
+            *n = view->len / sizeof(double);
+            return view->buf;
+        }
+        PyBuffer_Release(view);
+    }
+    PyErr_Clear();
+    view->obj = NULL;
+
+    seq = PySequence_Fast(times, "times must be a sequence of epochs");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    *n = PySequence_Fast_GET_SIZE(seq);
+    out = malloc(sizeof(double) * (*n ? *n : 1));
+    if (out == NULL)
+    {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    for (i=0; i<*n; i++)
+    {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        out[i] = PyFloat_AsDouble(item);
+        if (out[i] == -1.0 && PyErr_Occurred())
+        {
+            Py_DECREF(seq);
+            free(out);
+            return NULL;
+        }
+    }
+
+    Py_DECREF(seq);
+    return out;
+}
+
+void ReleaseTimes(double *times, Py_buffer *view) {
+    if (view->obj != NULL)
+    {
+        PyBuffer_Release(view);
+    }
+    else
+    {
+        free(times);
+    }
+}
+
+// Whether a buffer of format and itemsize holds what array.array would for typecode: doubles
+// for 'd', and for the integer typecodes any signed integer of the same size.
+static int SameType(const char *format, Py_ssize_t itemsize, char typecode) {
+    const char *code = format != NULL ? format : "B";
+
+    if (*code == '@' || *code == '=')
+    {
+        code++;
+    }
+#if PY_LITTLE_ENDIAN
+    else if (*code == '<')
+#else
+    else if (*code == '>' || *code == '!')
+#endif
+    {
+        code++;
+    }
+
+    if (code[0] == '\0' || code[1] != '\0')
+    {
+        return 0;
+    }
+
+    switch (typecode)
+    {
+        case 'd': return *code == 'd' && itemsize == sizeof(double);
+        case 'f': return *code == 'f' && itemsize == sizeof(float);
+        case 'l': return strchr("ilqn", *code) != NULL && itemsize == sizeof(long);
+        case 'b': return *code == 'b' && itemsize == sizeof(char);
+    }
+    return 0;
+}
+
+// Writable views of count columns of n elements each, one per key with its typecode.  If out
+// is NULL or None they are new zero filled array.array in a new dictionary, otherwise the
+// values of the dictionary out under those keys, which the caller made to be written over and
+// over without allocating.  Returns the dictionary, with *held views to release whether or not
+// it succeeded.
+//
+// NOTE: Returns NULL with an exception set if an out column is missing or isn't the right size
+// and type.
+PyObject * LoadColumns(PyObject *out, const char **keys, const char *typecodes, int count, Py_ssize_t n,
+                       Py_buffer *views, int *held) {
+    PyObject *result, *array;
+    char code[2] = { '\0', '\0' };
+
+    *held = 0;
+    if (out != NULL && out != Py_None)
+    {
+        if (!PyDict_Check(out))
+        {
+            PyErr_SetString(PyExc_TypeError, "out must be a dictionary of arrays");
+            return NULL;
+        }
+        result = out;
+        Py_INCREF(result);
+    }
+    else
+    {
+        result = PyDict_New();
+        if (result == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    for (*held=0; *held<count; (*held)++)
+    {
+        if (result == out)
+        {
+            array = PyDict_GetItemString(out, keys[*held]);
+            if (array == NULL)
+            {
+                PyErr_Format(PyExc_KeyError, "out has no '%s' array", keys[*held]);
+                goto fail;
+            }
+        }
+        else
+        {
+            array = NewArray(typecodes[*held], n);
+            if (array == NULL || PyDict_SetItemString(result, keys[*held], array) != 0)
+            {
+                Py_XDECREF(array);
+                goto fail;
+            }
+            Py_DECREF(array);
+        }
+
+        if (PyObject_GetBuffer(array, &views[*held], PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0)
+        {
+            goto fail;
+        }
+
+        if (!SameType(views[*held].format, views[*held].itemsize, typecodes[*held]) ||
+            views[*held].len != n * views[*held].itemsize)
+        {
+            PyBuffer_Release(&views[*held]);
+            code[0] = typecodes[*held];
+            PyErr_Format(PyExc_ValueError, "out['%s'] must be an array of %zd '%s'", keys[*held], n, code);
+            goto fail;
+        }
+    }
+
+    return result;
+
+fail:
+    Py_DECREF(result);
+    return NULL;
+}
+
+static PyObject* Satellite_observe_many(Satellite *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "times", "qth", "fields", "out", "incremental", NULL };
+    double stnlat, stnlong, *times = NULL;
+    int stnalt, col, held = 0, skip, count, selected[NUM_OBSERVATION_FIELDS], incremental = 0;
+    Py_ssize_t i, n = 0;
+    PyObject *py_times, *result = NULL, *fields = NULL, *out = NULL;
+    Py_buffer columns[NUM_OBSERVATION_FIELDS], view;
+    const char *keys[NUM_OBSERVATION_FIELDS];
+    char typecodes[NUM_OBSERVATION_FIELDS];
+    struct observation obs = { 0 };
+    context_t ctx = self->ctx;
+    const observation_field *field;
+    char *base;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|(ddi)OOi", kwlist,
+            &py_times, &stnlat, &stnlong, &stnalt, &fields, &out, &incremental))
+    {
+        return NULL;
+    }
+
+    if (out != NULL && out != Py_None && !PyDict_Check(out))
+    {
+        PyErr_SetString(PyExc_TypeError, "out must be a dictionary of arrays");
+        return NULL;
+    }
+
+    // Unless told otherwise, observe just what there is room for in out.
+    if ((fields == NULL || fields == Py_None) && out != NULL && out != Py_None)
+    {
+        fields = out;
+    }
+
+    if (load_qth(&ctx, PyTuple_Size(args) >= 2 || (kwds != NULL && PyDict_GetItemString(kwds, "qth") != NULL),
+                 stnlat, stnlong, stnalt) != 0 ||
+        LoadFields(fields, &skip, selected, &count) != 0)
+    {
+        return NULL;
+    }
+    SetFlag(&ctx, skip);
+
+    // A sweep forward in time can carry each step's Kepler solution and deep-space state on to
+    // the next rather than starting from epoch again.
+    if (incremental)
+    {
+        SetFlag(&ctx, INCREMENTAL_FLAG);
+    }
+
+    times = LoadTimes(py_times, &n, &view);
+    if (times == NULL)
+    {
+        return NULL;
+    }
+
+    for (col=0; col<count; col++)
+    {
+        keys[col] = observation_fields[selected[col]].key;
+        typecodes[col] = observation_fields[selected[col]].typecode;
+    }
+
+    // Get every column up front so the propagation loop can write straight into them.
+    result = LoadColumns(out, keys, typecodes, count, n, columns, &held);
+    if (result == NULL)
+    {
+        goto cleanup;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i=0; i<n; i++)
+    {
+        load_time(&ctx, 1, times[i]);
+        MakeObservation(&ctx, ctx.daynum, &obs);
+
+        for (col=0; col<count; col++)
+        {
+            field = &observation_fields[selected[col]];
+            base = (char *)&obs + field->offset;
+            switch (field->typecode)
+            {
+                case 'd': ((double *)columns[col].buf)[i] = *(double *)base; break;
+                case 'l': ((long *)columns[col].buf)[i] = *(long *)base; break;
+                case 'b': ((signed char *)columns[col].buf)[i] = *(char *)base; break;
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+cleanup:
+    for (col=0; col<held; col++)
+    {
+        PyBuffer_Release(&columns[col]);
+    }
+    ReleaseTimes(times, &view);
+    return result;
+}
+
+static char Satellite_observe_many_docs[] =
+    "observe_many(times[, (gs_lat, gs_lon, gs_alt)[, fields[, out[, incremental]]]])\n"
+    "Observes the satellite at every epoch in times in one call.  Returns a dictionary of\n"
+    "array.array, one per numeric field of observe() (or per name in fields, skipping the\n"
+    "work the others need), each with one element per epoch.  Given out, a dictionary like the\n"
+    "one returned, its arrays are written over instead and it is returned; fields then\n"
+    "defaults to its keys.  With incremental true, each epoch is propagated on from the one\n"
+    "before, which is quicker for times in increasing order.  Kepler's equation is solved to\n"
+    "the same 1e-6 radian tolerance from a different start, so positions agree with the\n"
+    "default to within about 1e-6 of the orbit's size: some 7 m in low earth orbit, 40 m at\n"
+    "geostationary altitude.\n";
+
+static PyObject* Satellite_observe_records(Satellite *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "times", "qth", "out", NULL };
+    double stnlat, stnlong, *times;
+    int stnalt;
+    Py_ssize_t i, n = 0;
+    PyObject *py_times, *out = NULL;
+    Py_buffer view;
+    Observations *result;
+    context_t ctx = self->ctx;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|(ddi)O", kwlist, &py_times, &stnlat, &stnlong, &stnalt, &out))
+    {
+        return NULL;
+    }
+
+    if (load_qth(&ctx, PyTuple_Size(args) >= 2 || (kwds != NULL && PyDict_GetItemString(kwds, "qth") != NULL),
+                 stnlat, stnlong, stnalt) != 0)
+    {
+        return NULL;
+    }
+
+    if (out != NULL && out != Py_None && !PyObject_TypeCheck(out, &ObservationsType))
+    {
+        PyErr_SetString(PyExc_TypeError, "out must be Observations");
+        return NULL;
+    }
+
+    times = LoadTimes(py_times, &n, &view);
+    if (times == NULL)
+    {
+        return NULL;
+    }
+
+    if (out != NULL && out != Py_None)
+    {
+        result = (Observations *)out;
+        if (result->count != n)
+        {
+            ReleaseTimes(times, &view);
+            PyErr_Format(PyExc_ValueError, "out holds %zd observations, not %zd", result->count, n);
+            return NULL;
+        }
+        Py_INCREF(result);
+    }
+    else
+    {
+        result = PyObject_New(Observations, &ObservationsType);
+        if (result == NULL)
+        {
+            ReleaseTimes(times, &view);
+            return NULL;
+        }
+        result->count = n;
+        result->rows = calloc(n ? n : 1, sizeof(observation));
+        if (result->rows == NULL)
+        {
+            ReleaseTimes(times, &view);
+            Py_DECREF(result);
+            return PyErr_NoMemory();
+        }
+    }
+
+    // Each observation is made in place, in the memory the buffer will export.
+    Py_BEGIN_ALLOW_THREADS
+    for (i=0; i<n; i++)
+    {
+        load_time(&ctx, 1, times[i]);
+        MakeObservation(&ctx, ctx.daynum, &result->rows[i]);
+    }
+    Py_END_ALLOW_THREADS
+
+    ReleaseTimes(times, &view);
+    return (PyObject *)result;
+}
+
+static char Satellite_observe_records_docs[] =
+    "observe_records(times[, (gs_lat, gs_lon, gs_alt)[, out]])\n"
+    "Observes the satellite at every epoch in times, like observe_many, but keeps each\n"
+    "observation whole.  Returns Observations: a sequence of Observation that also exports its\n"
+    "rows through the buffer protocol, so numpy.asarray() gives a structured array over the same\n"
+    "memory with a field per observation key.  Given out, Observations of as many epochs, the\n"
+    "observations are made over its rows instead, and it is returned.\n";
+
+static PyObject* Satellite_observe_stations(Satellite *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "time", "stations", "out", NULL };
+    static const char *keys[] = { "azimuth", "elevation", "slant_range", "range_rate", "doppler" };
+    double epoch, thetag, *columns[5];
+    int i, held;
+    Py_buffer views[5];
+    PyObject *py_stations, *result = NULL, *out = NULL;
+    Stations *stations;
+    vector_t pos, vel, obs_set;
+    context_t ctx = self->ctx;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "dO|O", kwlist, &epoch, &py_stations, &out))
+    {
+        return NULL;
+    }
+
+    stations = AsStations(py_stations);
+    if (stations == NULL)
+    {
+        return NULL;
+    }
+
+    result = LoadColumns(out, keys, "ddddd", 5, stations->count, views, &held);
+    if (result == NULL)
+    {
+        goto cleanup;
+    }
+
+    for (i=0; i<5; i++)
+    {
+        columns[i] = views[i].buf;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    // Propagate once, then observe from every station, as Calc() would for each in turn.
+    load_time(&ctx, 1, epoch);
+    ResetDeep(&ctx);
+    Propagate(&ctx, &pos, &vel);
+    thetag = ThetaG_JD(ctx.jul_utc);
+
+    for (i=0; i<stations->count; i++)
+    {
+        Calculate_Station_Obs(thetag, &pos, &vel, &stations->station[i], &obs_set);
+        columns[0][i] = Degrees(obs_set.x);
+        columns[1][i] = Degrees(obs_set.y);
+        columns[2][i] = obs_set.z;
+        columns[3][i] = obs_set.w;
+        columns[4][i] = -100.0e06*((obs_set.w*1000.0)/299792458.0);
+    }
+    Py_END_ALLOW_THREADS
+
+cleanup:
+    for (held--; held>=0; held--)
+    {
+        PyBuffer_Release(&views[held]);
+    }
+    Py_DECREF(stations);
+    return result;
+}
+
+static char Satellite_observe_stations_docs[] =
+    "observe_stations(time, stations[, out])\n"
+    "Propagates the satellite to time once and observes it from every station in stations (a\n"
+    "Stations, or a sequence of (gs_lat, gs_lon, gs_alt)).  Returns a dictionary of array.array\n"
+    "azimuth, elevation, slant_range, range_rate and doppler, one element per station.  Given\n"
+    "out, a dictionary like the one returned, its arrays are written over instead.\n";
+
+static PyMethodDef Satellite_methods[] = {
+    {"observe", (PyCFunction)Satellite_observe, METH_VARARGS, Satellite_observe_docs},
+    {"passes" , (PyCFunction)Satellite_passes , METH_VARARGS, Satellite_passes_docs},
+    {"transits", (PyCFunction)Satellite_transits, METH_VARARGS, Satellite_transits_docs},
+    {"peak", (PyCFunction)Satellite_peak, METH_VARARGS, Satellite_peak_docs},
+    {"observe_many", (PyCFunction)Satellite_observe_many, METH_VARARGS | METH_KEYWORDS, Satellite_observe_many_docs},
+    {"observe_records", (PyCFunction)Satellite_observe_records, METH_VARARGS | METH_KEYWORDS, Satellite_observe_records_docs},
+    {"observe_stations", (PyCFunction)Satellite_observe_stations, METH_VARARGS | METH_KEYWORDS, Satellite_observe_stations_docs},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject SatelliteType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Satellite",                       /* tp_name */
+    sizeof(Satellite),                          /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Satellite_dealloc,              /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /* tp_flags */
+    "Satellite((tle_line0, tle_line1, tle_line2))\n"
+    "A TLE parsed and initialized once, to be observed many times.\n", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    Satellite_methods,                          /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)Satellite_init,                   /* tp_init */
+    0,                                          /* tp_alloc */
+    PyType_GenericNew,                          /* tp_new */
+};
+
+// A set of satellites propagated together, with the near-earth ones going through the SIMD
+// batch SGP4 kernel a group of SGP4_LANES at a time.  Satellites are updated in place while
+// other threads propagate them: readers pin the batch under an rcu read lock, which never
+// waits, and writers swap in updated copies and free what they replace once no reader can
+// still be using it.
+typedef struct {
+    PyObject_HEAD
+    sgp4_batch_t *batch;
+    sgp4_rcu_t rcu;
+} Catalog;
+
+static PyObject* Catalog_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    Catalog *self = (Catalog *)type->tp_alloc(type, 0);
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    SGP4RcuInit(&self->rcu);
+    self->batch = malloc(sizeof(sgp4_batch_t));
+    if (self->batch == NULL || SGP4BatchInit(self->batch, NULL, 0) != 0)
+    {
+        free(self->batch);
+        self->batch = NULL;
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    return (PyObject *)self;
+}
+
+static void Catalog_dealloc(Catalog *self)
+{
+    if (self->batch != NULL)
+    {
+        SGP4BatchFree(self->batch);
+        free(self->batch);
+        pthread_mutex_destroy(&self->rcu.lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+// The batch to read until SGP4ReadUnlock(&self->rcu, *reader).
+static const sgp4_batch_t* CatalogRead(Catalog *self, int *reader)
+{
+    *reader = SGP4ReadLock(&self->rcu);
+    return __atomic_load_n(&self->batch, __ATOMIC_ACQUIRE);
+}
+
+// Parses and initializes a sequence of TLEs, setting *count to how many.
+static context_t* LoadContexts(PyObject *tles, Py_ssize_t *count)
+{
+    PyObject *seq;
+    const char *tle0, *tle1, *tle2;
+    context_t *ctx;
+    Py_ssize_t i;
+    char errbuff[100];
+
+    seq = PySequence_Fast(tles, "Catalog needs a sequence of TLEs");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    *count = PySequence_Fast_GET_SIZE(seq);
+    if (*count > INT_MAX)
+    {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "Too many TLEs for one catalog.");
+        return NULL;
+    }
+
+    ctx = calloc(*count ? *count : 1, sizeof(context_t));
+    if (ctx == NULL)
+    {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    for (i=0; i<*count; i++)
+    {
+        if (!PyArg_Parse(PySequence_Fast_GET_ITEM(seq, i), "(sss)", &tle0, &tle1, &tle2))
+        {
+            goto fail;
+        }
+
+        if (load_tle(&ctx[i], tle0, tle1, tle2) != 0)
+        {
+            sprintf(errbuff, "Unable to process TLE %ld of catalog", (long)i);
+            PyErr_SetString(PyExc_RuntimeError, errbuff);
+            goto fail;
+        }
+    }
+
+    Py_DECREF(seq);
+    return ctx;
+
+fail:
+    free(ctx);
+    Py_DECREF(seq);
+    return NULL;
+}
+
+static int Catalog_init(Catalog *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *tles;
+    sgp4_batch_t *batch;
+    context_t *ctx;
+    Py_ssize_t count;
+
+    if (!PyArg_ParseTuple(args, "O", &tles))
+    {
+        return -1;
+    }
+
+    ctx = LoadContexts(tles, &count);
+    if (ctx == NULL)
+    {
+        return -1;
+    }
+
+    batch = malloc(sizeof(sgp4_batch_t));
+    if (batch == NULL || SGP4BatchInit(batch, ctx, (int)count) != 0)
+    {
+        free(batch);
+        free(ctx);
+        PyErr_NoMemory();
+        return -1;
+    }
+    free(ctx);
+
+    // Initializing again replaces every satellite at once, under anyone still reading.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->rcu.lock);
+    SGP4BatchReplace(&self->batch, &self->rcu, batch);
+    pthread_mutex_unlock(&self->rcu.lock);
+    Py_END_ALLOW_THREADS
+
+    return 0;
+}
+
+static PyObject* Catalog_update(Catalog *self, PyObject *args)
+{
+    PyObject *tles;
+    context_t *ctx;
+    Py_ssize_t count;
+    int rc;
+
+    if (!PyArg_ParseTuple(args, "O", &tles))
+    {
+        return NULL;
+    }
+
+    ctx = LoadContexts(tles, &count);
+    if (ctx == NULL)
+    {
+        return NULL;
+    }
+
+    // The lock only keeps writers apart; readers never wait on it, or on us.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->rcu.lock);
+    rc = SGP4BatchUpdate(&self->batch, &self->rcu, ctx, (int)count);
+    pthread_mutex_unlock(&self->rcu.lock);
+    Py_END_ALLOW_THREADS
+
+    free(ctx);
+
+    if (rc != 0)
+    {
+        return PyErr_NoMemory();
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* Catalog_index(Catalog *self, PyObject *args)
+{
+    long norad_id;
+    int reader, index;
+
+    if (!PyArg_ParseTuple(args, "l", &norad_id))
+    {
+        return NULL;
+    }
+
+    index = SGP4BatchIndex(CatalogRead(self, &reader), norad_id);
+    SGP4ReadUnlock(&self->rcu, reader);
+
+    if (index < 0)
+    {
+        PyErr_Format(PyExc_KeyError, "%ld", norad_id);
+        return NULL;
+    }
+
+    return PyLong_FromLong(index);
+}
+
+static PyObject* Catalog_norad_ids(Catalog *self, PyObject *args)
+{
+    const sgp4_batch_t *batch;
+    PyObject *ids, *id;
+    int reader, i;
+
+    batch = CatalogRead(self, &reader);
+    ids = PyList_New(batch->count);
+    for (i=0; ids != NULL && i<batch->count; i++)
+    {
+        id = PyLong_FromLong(SGP4BatchSat(batch, i)->catnum);
+        if (id == NULL)
+        {
+            Py_CLEAR(ids);
+            break;
+        }
+        PyList_SET_ITEM(ids, i, id);
+    }
+    SGP4ReadUnlock(&self->rcu, reader);
+
+    return ids;
+}
+
+static Py_ssize_t Catalog_length(Catalog *self)
+{
+    int reader;
+    Py_ssize_t count = CatalogRead(self, &reader)->count;
+
+    SGP4ReadUnlock(&self->rcu, reader);
+    return count;
+}
+
+static PyObject* Catalog_propagate(Catalog *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "time", "out", "float32", "exact", NULL };
+    static const char *keys[] = { "x", "y", "z", "x_vel", "y_vel", "z_vel" };
+    double epoch, daynum;
+    void *columns[6];
+    Py_buffer views[6];
+    int held, reader, float32 = 0, exact = 1;
+    const sgp4_batch_t *batch;
+    PyObject *result, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|Oii", kwlist, &epoch, &out, &float32, &exact))
+    {
+        return NULL;
+    }
+
+    daynum = (epoch/86400.0)-3651.0;
+
+    // Sized and propagated under one read lock, so an update can't change the count between.
+    batch = CatalogRead(self, &reader);
+    result = LoadColumns(out, keys, float32 ? "ffffff" : "dddddd", 6, batch->count, views, &held);
+    if (result != NULL)
+    {
+        for (held=0; held<6; held++)
+        {
+            columns[held] = views[held].buf;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        if (float32)
+        {
+            SGP4Batch32(batch, daynum, columns[0], columns[1], columns[2], columns[3], columns[4], columns[5]);
+        }
+        else
+        {
+            SGP4Batch(batch, daynum, columns[0], columns[1], columns[2], columns[3], columns[4], columns[5], exact);
+        }
+        Py_END_ALLOW_THREADS
+    }
+    SGP4ReadUnlock(&self->rcu, reader);
+
+    for (held--; held>=0; held--)
+    {
+        PyBuffer_Release(&views[held]);
+    }
+    return result;
+}
+
+static PyObject* Catalog_geodetic(Catalog *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "time", "out", "float32", NULL };
+    static const char *keys[] = { "latitude", "longitude", "altitude" };
+    double epoch, daynum;
+    void *columns[3];
+    Py_buffer views[3];
+    int held, reader, float32 = 0;
+    const sgp4_batch_t *batch;
+    PyObject *result, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|Oi", kwlist, &epoch, &out, &float32))
+    {
+        return NULL;
+    }
+
+    daynum = (epoch/86400.0)-3651.0;
+
+    batch = CatalogRead(self, &reader);
+    result = LoadColumns(out, keys, float32 ? "fff" : "ddd", 3, batch->count, views, &held);
+    if (result != NULL)
+    {
+        for (held=0; held<3; held++)
+        {
+            columns[held] = views[held].buf;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
+        if (float32)
+        {
+            SGP4BatchGeodetic32(batch, daynum, columns[0], columns[1], columns[2]);
+        }
+        else
+        {
+            SGP4BatchGeodetic(batch, daynum, columns[0], columns[1], columns[2]);
+        }
+        Py_END_ALLOW_THREADS
+    }
+    SGP4ReadUnlock(&self->rcu, reader);
+
+    for (held--; held>=0; held--)
+    {
+        PyBuffer_Release(&views[held]);
+    }
+    return result;
+}
+
+static PyObject* Catalog_visibility(Catalog *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "stations", "start", "step", "steps", "min_elevation", "threads", "out", NULL };
+    double start, step, min_elevation=0.0;
+    int steps, threads=0, rc, reader;
+    size_t size;
+    const sgp4_batch_t *batch;
+    PyObject *py_stations, *bits, *out = NULL;
+    Py_buffer view;
+    Stations *stations;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oddi|diO", kwlist,
+            &py_stations, &start, &step, &steps, &min_elevation, &threads, &out))
+    {
+        return NULL;
+    }
+
+    if (steps < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "steps must not be negative.");
+        return NULL;
+    }
+
+    if (threads <= 0)
+    {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    stations = AsStations(py_stations);
+    if (stations == NULL)
+    {
+        return NULL;
+    }
+
+    batch = CatalogRead(self, &reader);
+    size = (size_t)batch->count * stations->count * ((steps+7)/8);
+    if (out != NULL && out != Py_None)
+    {
+        if (PyObject_GetBuffer(out, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0)
+        {
+            SGP4ReadUnlock(&self->rcu, reader);
+            Py_DECREF(stations);
+            return NULL;
+        }
+        if ((size_t)view.len != size)
+        {
+            SGP4ReadUnlock(&self->rcu, reader);
+            PyBuffer_Release(&view);
+            Py_DECREF(stations);
+            PyErr_Format(PyExc_ValueError, "out must be %zu bytes", size);
+            return NULL;
+        }
+        bits = out;
+        Py_INCREF(bits);
+    }
+    else
+    {
+        bits = PyByteArray_FromStringAndSize(NULL, size);
+        if (bits == NULL || PyObject_GetBuffer(bits, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0)
+        {
+            SGP4ReadUnlock(&self->rcu, reader);
+            Py_XDECREF(bits);
+            Py_DECREF(stations);
+            return NULL;
+        }
+    }
+    memset(view.buf, 0, size);
+
+    Py_BEGIN_ALLOW_THREADS
+    rc = SGP4BatchVisibility(batch, stations->station, stations->count, start, step, steps,
+        min_elevation, (unsigned char *)view.buf, threads);
+    Py_END_ALLOW_THREADS
+    SGP4ReadUnlock(&self->rcu, reader);
+
+    PyBuffer_Release(&view);
+    Py_DECREF(stations);
+
+    if (rc != 0)
+    {
+        Py_DECREF(bits);
+        return PyErr_NoMemory();
+    }
+
+    return bits;
+}
+
+static PyObject* Catalog_from_file(PyTypeObject *type, PyObject *args)
+{
+    const char *path;
+    int threads=0, fd, rc=0, failed, saved_errno=0;
+    struct stat st;
+    void *text = NULL;
+    Catalog *self;
+
+    if (!PyArg_ParseTuple(args, "s|i", &path, &threads))
+    {
+        return NULL;
+    }
+
+    if (threads <= 0)
+    {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    self = (Catalog *)Catalog_new(type, NULL, NULL);
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    // The file is mapped rather than read, and never turned into python strings at all.
+    Py_BEGIN_ALLOW_THREADS
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        rc = -3;
+    }
+    else if (S_ISDIR(st.st_mode))
+    {
+        errno = EISDIR;
+        rc = -3;
+    }
+    else if (st.st_size > 0 &&
+             (text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        rc = -3;
+    }
+    saved_errno = errno;
+
+    if (rc == 0)
+    {
+        SGP4BatchFree(self->batch);
+        rc = SGP4BatchLoad(self->batch, text, st.st_size > 0 ? st.st_size : 0, threads, &failed);
+    }
+
+    if (text != NULL && text != MAP_FAILED)
+    {
+        munmap(text, st.st_size);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    Py_END_ALLOW_THREADS
+
+    switch (rc)
+    {
+        case 0:
+            return (PyObject *)self;
+        case -1:
+            PyErr_NoMemory();
+            break;
+        case -2:
+            PyErr_Format(PyExc_RuntimeError, "Unable to process TLE %d of catalog", failed);
+            break;
+        default:
+            errno = saved_errno;
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject* Catalog_from_compiled(PyTypeObject *type, PyObject *args)
+{
+    const char *path;
+    int fd, rc;
+    Catalog *self;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    self = (Catalog *)Catalog_new(type, NULL, NULL);
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    SGP4BatchFree(self->batch);
+    fd = open(path, O_RDONLY);
+    rc = fd < 0 ? -1 : SGP4BatchMap(self->batch, fd);
+    if (fd >= 0)
+    {
+        // The mapping outlives the descriptor.
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (rc == 0)
+    {
+        return (PyObject *)self;
+    }
+
+    if (rc == -2)
+    {
+        PyErr_Format(PyExc_ValueError, "%s is not a compiled catalog this build can load", path);
+    }
+    else
+    {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject* Catalog_save(Catalog *self, PyObject *args)
+{
+    const char *path;
+    char *temp;
+    int fd, rc, saved_errno;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    temp = malloc(strlen(path) + 32);
+    if (temp == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+    sprintf(temp, "%s.%ld.tmp", path, (long)getpid());
+
+    // Written beside path and renamed over it, so that processes mapping path never see a
+    // partly written file.  Holding the writer lock keeps updates out meanwhile.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->rcu.lock);
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    rc = fd < 0 ? -1 : SGP4BatchSave(self->batch, fd);
+    saved_errno = errno;
+    if (fd >= 0 && close(fd) != 0 && rc == 0)
+    {
+        rc = -1;
+        saved_errno = errno;
+    }
+    if (rc == 0 && rename(temp, path) != 0)
+    {
+        rc = -1;
+        saved_errno = errno;
+    }
+    if (rc != 0 && fd >= 0)
+    {
+        unlink(temp);
+    }
+    pthread_mutex_unlock(&self->rcu.lock);
+    Py_END_ALLOW_THREADS
+
+    free(temp);
+
+    if (rc != 0)
+    {
+        errno = saved_errno;
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+
+    Py_RETURN_NONE;
+}
+
+static char Catalog_from_compiled_docs[] =
+    "from_compiled(path)\n"
+    "Returns the Catalog saved at path by save.  The file is memory mapped, with nothing to\n"
+    "parse or initialize, and its pages are shared with other processes mapping it.\n";
+
+static char Catalog_save_docs[] =
+    "save(path)\n"
+    "Writes the catalog, initialized, to path as a compiled catalog for from_compiled.  The\n"
+    "format is specific to the build of this module that wrote it.\n";
+
+static char Catalog_from_file_docs[] =
+    "from_file(path[, threads])\n"
+    "Returns the Catalog of every TLE in the file at path, three lines (name, line 1, line 2)\n"
+    "or two to each, as published.  The file is memory mapped and its records parsed and\n"
+    "initialized by threads (default: one per core) native threads, without making a python\n"
+    "string of any of them.\n";
+
+static char Catalog_visibility_docs[] =
+    "visibility(stations, start, step, steps[, min_elevation[, threads[, out]]])\n"
+    "Returns a bytearray bitset of whether each satellite is at or above min_elevation (default\n"
+    "0) degrees from each station at times start, start+step, ... (steps of them).  There is a\n"
+    "row of (steps+7)//8 bytes per satellite and station, satellite major, in which bit k%8 of\n"
+    "byte k//8 is set when visible at the k'th time.  Satellites are divided between threads\n"
+    "(default: one per core) native threads.  Given out, a writable buffer of that many bytes,\n"
+    "the bitset is written there instead, and out is returned.\n";
+
+static char Catalog_propagate_docs[] =
+    "propagate(time[, out[, float32[, exact]]])\n"
+    "Returns ECI x, y, z (km) and x_vel, y_vel, z_vel (km/s) of every satellite at time, as a\n"
+    "dictionary of array.array in catalog order.  Given out, a dictionary like the one\n"
+    "returned, its arrays are written over instead.  With float32 true, the near-earth\n"
+    "satellites are propagated in single precision and the arrays are of 'f' rather than 'd':\n"
+    "within 30 days of epoch, positions are then within 100 m and velocities 0.1 m/s of double\n"
+    "precision, typically a few metres (see test_float32.py).  With exact false, the near-earth\n"
+    "satellites' sines, cosines and arctangents come from the vector math of lanemath.h rather\n"
+    "than libm, which is faster, and positions are within a millimetre of exact, bar the rare\n"
+    "satellite whose Kepler's equation stops an iteration sooner or later, which moves it by up\n"
+    "to the 1e-6 radian tolerance: some 7 m in low earth orbit.\n";
+
+static char Catalog_geodetic_docs[] =
+    "geodetic(time[, out[, float32]])\n"
+    "Returns the latitude and longitude (degrees north and east) and altitude (km) of every\n"
+    "satellite at time, as observe() gives them, as a dictionary of array.array in catalog\n"
+    "order.  out and float32 are as for propagate.\n";
+
+static char Catalog_update_docs[] =
+    "update([(tle_line0, tle_line1, tle_line2), ...])\n"
+    "Replaces the elements of the satellites with the NORAD ids of the TLEs given, and adds\n"
+    "those not in the catalog, after the rest.  Other threads may go on propagating while it\n"
+    "does: each sees every satellite with either all of its old elements or all of its new.\n";
+
+static char Catalog_index_docs[] =
+    "index(norad_id)\n"
+    "Returns the position in the catalog, and so in what propagate returns, of the satellite\n"
+    "with norad_id.  Raises KeyError if there is none.\n";
+
+static char Catalog_norad_ids_docs[] =
+    "norad_ids()\n"
+    "Returns a list of the NORAD id of every satellite, in catalog order.\n";
+
+static PyMethodDef Catalog_methods[] = {
+    {"propagate", (PyCFunction)Catalog_propagate, METH_VARARGS | METH_KEYWORDS, Catalog_propagate_docs},
+    {"geodetic", (PyCFunction)Catalog_geodetic, METH_VARARGS | METH_KEYWORDS, Catalog_geodetic_docs},
+    {"update", (PyCFunction)Catalog_update, METH_VARARGS, Catalog_update_docs},
+    {"index", (PyCFunction)Catalog_index, METH_VARARGS, Catalog_index_docs},
+    {"norad_ids", (PyCFunction)Catalog_norad_ids, METH_NOARGS, Catalog_norad_ids_docs},
+    {"visibility", (PyCFunction)Catalog_visibility, METH_VARARGS | METH_KEYWORDS, Catalog_visibility_docs},
+    {"from_file", (PyCFunction)Catalog_from_file, METH_VARARGS | METH_CLASS, Catalog_from_file_docs},
+    {"from_compiled", (PyCFunction)Catalog_from_compiled, METH_VARARGS | METH_CLASS, Catalog_from_compiled_docs},
+    {"save", (PyCFunction)Catalog_save, METH_VARARGS, Catalog_save_docs},
+    {NULL, NULL, 0, NULL}
+};
+
+static PySequenceMethods Catalog_as_sequence = {
+    (lenfunc)Catalog_length,                    /* sq_length */
+};
+
+static PyTypeObject CatalogType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Catalog",                         /* tp_name */
+    sizeof(Catalog),                            /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Catalog_dealloc,                /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &Catalog_as_sequence,                       /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /* tp_flags */
+    "Catalog([(tle_line0, tle_line1, tle_line2), ...])\n"
+    "Many TLEs, parsed and initialized once, to be propagated together.\n", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    Catalog_methods,                            /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)Catalog_init,                     /* tp_init */
+    0,                                          /* tp_alloc */
+    Catalog_new,                                /* tp_new */
+};
+
+// Every element set of many satellites over time, sorted by NORAD id and epoch, from which each
+// query picks the one whose epoch is nearest its time.  Archives never change once made, so they
+// are made by tp_new.  The satellite last picked is kept, initialized, for the next query to reuse.
+typedef struct {
+    PyObject_HEAD
+    tle_archive_t archive;
+    int picked;
+    PyObject *satellite;
+} Archive;
+
+static Archive* Archive_alloc(PyTypeObject *type)
+{
+    Archive *self = (Archive *)type->tp_alloc(type, 0);
+
+    if (self != NULL)
+    {
+        self->picked = -1;
+    }
+    return self;
+}
+
+static PyObject* Archive_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *tles, *seq;
+    const char *tle0, *tle1, *tle2;
+    tle_entry_t *entry;
+    Py_ssize_t i, count;
+    Archive *self;
+
+    if (!PyArg_ParseTuple(args, "O", &tles))
+    {
+        return NULL;
+    }
+
+    seq = PySequence_Fast(tles, "Archive needs a sequence of TLEs");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    count = PySequence_Fast_GET_SIZE(seq);
+    if (count > INT_MAX)
+    {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "Too many TLEs for one archive.");
+        return NULL;
+    }
+
+    entry = malloc(sizeof(tle_entry_t) * (count ? count : 1));
+    if (entry == NULL)
+    {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+
+    for (i=0; i<count; i++)
+    {
+        if (!PyArg_Parse(PySequence_Fast_GET_ITEM(seq, i), "(sss)", &tle0, &tle1, &tle2))
+        {
+            goto fail;
+        }
+
+        if (TLEEntry(&entry[i], tle0, tle1, tle2) != 0)
+        {
+            PyErr_Format(PyExc_RuntimeError, "Unable to process TLE %ld of archive", (long)i);
+            goto fail;
+        }
+    }
+    Py_DECREF(seq);
+
+    self = Archive_alloc(type);
+    if (self == NULL)
+    {
+        free(entry);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    TLEArchiveInit(&self->archive, entry, (int)count);
+    Py_END_ALLOW_THREADS
+
+    return (PyObject *)self;
+
+fail:
+    free(entry);
+    Py_DECREF(seq);
+    return NULL;
+}
+
+static void Archive_dealloc(Archive *self)
+{
+    Py_XDECREF(self->satellite);
+    TLEArchiveFree(&self->archive);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t Archive_length(Archive *self)
+{
+    return self->archive.count;
+}
+
+// Opens path and runs load (TLEArchiveLoad or TLEArchiveMap, by whether text is wanted) on it with
+// the GIL released, raising OSError, MemoryError or the given complaint about its contents.
+static PyObject* Archive_open(PyTypeObject *type, const char *path, int text)
+{
+    int fd, rc = 0, failed, saved_errno = 0;
+    struct stat st;
+    void *map = NULL;
+    Archive *self = Archive_alloc(type);
+
+    if (self == NULL)
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        rc = -1;
+    }
+    else if (S_ISDIR(st.st_mode))
+    {
+        errno = EISDIR;
+        rc = -1;
+    }
+    else if (!text)
+    {
+        rc = TLEArchiveMap(&self->archive, fd);
+    }
+    else if (st.st_size > 0 &&
+             (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        rc = -1;
+    }
+    saved_errno = errno;
+
+    if (rc == 0 && text)
+    {
+        rc = TLEArchiveLoad(&self->archive, map, st.st_size > 0 ? st.st_size : 0, &failed);
+        saved_errno = ENOMEM;
+    }
+
+    if (map != NULL && map != MAP_FAILED)
+    {
+        munmap(map, st.st_size);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (rc == 0)
+    {
+        return (PyObject *)self;
+    }
+
+    if (rc == -2 && text)
+    {
+        PyErr_Format(PyExc_RuntimeError, "Unable to process TLE %d of archive", failed);
+    }
+    else if (rc == -2)
+    {
+        PyErr_Format(PyExc_ValueError, "%s is not an archive this build can load", path);
+    }
+    else
+    {
+        errno = saved_errno;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject* Archive_from_file(PyTypeObject *type, PyObject *args)
+{
+    const char *path;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    return Archive_open(type, path, 1);
+}
+
+static PyObject* Archive_from_compiled(PyTypeObject *type, PyObject *args)
+{
+    const char *path;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    return Archive_open(type, path, 0);
+}
+
+static PyObject* Archive_save(Archive *self, PyObject *args)
+{
+    const char *path;
+    char *temp;
+    int fd, rc, saved_errno;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    temp = malloc(strlen(path) + 32);
+    if (temp == NULL)
+    {
+        return PyErr_NoMemory();
+    }
+    sprintf(temp, "%s.%ld.tmp", path, (long)getpid());
+
+    // Renamed over path once written, like Catalog.save.
+    Py_BEGIN_ALLOW_THREADS
+    fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    rc = fd < 0 ? -1 : TLEArchiveSave(&self->archive, fd);
+    saved_errno = errno;
+    if (fd >= 0 && close(fd) != 0 && rc == 0)
+    {
+        rc = -1;
+        saved_errno = errno;
+    }
+    if (rc == 0 && rename(temp, path) != 0)
+    {
+        rc = -1;
+        saved_errno = errno;
+    }
+    if (rc != 0 && fd >= 0)
+    {
+        unlink(temp);
+    }
+    Py_END_ALLOW_THREADS
+
+    free(temp);
+
+    if (rc != 0)
+    {
+        errno = saved_errno;
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+    }
+
+    Py_RETURN_NONE;
+}
+
+// The index of the element set of norad_id to use at epoch, or -1 with KeyError raised.
+static int ArchivePick(Archive *self, long norad_id, double epoch, int before)
+{
+    int index = TLEArchiveFind(&self->archive, norad_id, (epoch/86400.0)-3651.0, before);
+
+    if (index < 0)
+    {
+        PyErr_Format(PyExc_KeyError, "%ld", norad_id);
+    }
+    return index;
+}
+
+// A new reference to the Satellite of element set index, made once for repeated picks of it.
+static PyObject* ArchiveSatellite(Archive *self, int index)
+{
+    const tle_entry_t *entry = &self->archive.entry[index];
+    PyObject *satellite;
+
+    if (index != self->picked)
+    {
+        satellite = PyObject_CallFunction((PyObject *)&SatelliteType, "((sss))",
+            entry->name, entry->line1, entry->line2);
+        if (satellite == NULL)
+        {
+            return NULL;
+        }
+        Py_XDECREF(self->satellite);
+        self->satellite = satellite;
+        self->picked = index;
+    }
+
+    Py_INCREF(self->satellite);
+    return self->satellite;
+}
+
+static PyObject* Archive_find(Archive *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "norad_id", "time", "before", NULL };
+    const tle_entry_t *entry;
+    long norad_id;
+    double epoch;
+    int before = 0, index;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ld|i", kwlist, &norad_id, &epoch, &before) ||
+        (index = ArchivePick(self, norad_id, epoch, before)) < 0)
+    {
+        return NULL;
+    }
+
+    entry = &self->archive.entry[index];
+    return Py_BuildValue("(sss)", entry->name, entry->line1, entry->line2);
+}
+
+static PyObject* Archive_satellite(Archive *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "norad_id", "time", "before", NULL };
+    long norad_id;
+    double epoch;
+    int before = 0, index;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ld|i", kwlist, &norad_id, &epoch, &before) ||
+        (index = ArchivePick(self, norad_id, epoch, before)) < 0)
+    {
+        return NULL;
+    }
+
+    return ArchiveSatellite(self, index);
+}
+
+static PyObject* Archive_observe(Archive *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "norad_id", "time", "qth", "fields", "before", NULL };
+    long norad_id;
+    double epoch;
+    int before = 0, index;
+    PyObject *qth = NULL, *fields = NULL, *satellite, *observe_args, *result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ld|OOi", kwlist, &norad_id, &epoch, &qth, &fields, &before) ||
+        (index = ArchivePick(self, norad_id, epoch, before)) < 0)
+    {
+        return NULL;
+    }
+
+    satellite = ArchiveSatellite(self, index);
+    if (satellite == NULL)
+    {
+        return NULL;
+    }
+
+    if (fields != NULL && fields != Py_None)
+    {
+        observe_args = Py_BuildValue("(dOO)", epoch, qth != NULL ? qth : Py_None, fields);
+    }
+    else if (qth != NULL && qth != Py_None)
+    {
+        observe_args = Py_BuildValue("(dO)", epoch, qth);
+    }
+    else
+    {
+        observe_args = Py_BuildValue("(d)", epoch);
+    }
+
+    result = observe_args != NULL ? Satellite_observe((Satellite *)satellite, observe_args) : NULL;
+    Py_XDECREF(observe_args);
+    Py_DECREF(satellite);
+    return result;
+}
+
+static char Archive_from_file_docs[] =
+    "from_file(path)\n"
+    "Returns the Archive of every TLE in the file at path, which is read as Catalog.from_file\n"
+    "reads it.\n";
+
+static char Archive_from_compiled_docs[] =
+    "from_compiled(path)\n"
+    "Returns the Archive written to path by save, memory mapped read only and shared with\n"
+    "every other process mapping it.\n";
+
+static char Archive_save_docs[] =
+    "save(path)\n"
+    "Writes the archive to path for from_compiled.\n";
+
+static char Archive_find_docs[] =
+    "find(norad_id, time[, before])\n"
+    "Returns (tle_line0, tle_line1, tle_line2), the element set of norad_id whose epoch is\n"
+    "nearest time or, if before is true, the latest at or before it.  Raises KeyError if\n"
+    "there is none.\n";
+
+static char Archive_satellite_docs[] =
+    "satellite(norad_id, time[, before])\n"
+    "Returns the Satellite of the element set find picks, for its pass and observation\n"
+    "methods.  Asking again for the same element set returns the same Satellite.\n";
+
+static char Archive_observe_docs[] =
+    "observe(norad_id, time[, (gs_lat, gs_lon, gs_alt)[, fields[, before]]])\n"
+    "Returns the observation of norad_id at time, by the element set find picks for time.\n";
+
+static PyMethodDef Archive_methods[] = {
+    {"find", (PyCFunction)Archive_find, METH_VARARGS | METH_KEYWORDS, Archive_find_docs},
+    {"satellite", (PyCFunction)Archive_satellite, METH_VARARGS | METH_KEYWORDS, Archive_satellite_docs},
+    {"observe", (PyCFunction)Archive_observe, METH_VARARGS | METH_KEYWORDS, Archive_observe_docs},
+    {"save", (PyCFunction)Archive_save, METH_VARARGS, Archive_save_docs},
+    {"from_file", (PyCFunction)Archive_from_file, METH_VARARGS | METH_CLASS, Archive_from_file_docs},
+    {"from_compiled", (PyCFunction)Archive_from_compiled, METH_VARARGS | METH_CLASS, Archive_from_compiled_docs},
+    {NULL, NULL, 0, NULL}
+};
+
+static PySequenceMethods Archive_as_sequence = {
+    (lenfunc)Archive_length,                    /* sq_length */
+};
+
+static PyTypeObject ArchiveType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "cpredict.Archive",                         /* tp_name */
+    sizeof(Archive),                            /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor)Archive_dealloc,                /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &Archive_as_sequence,                       /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   /* tp_flags */
+    "Archive([(tle_line0, tle_line1, tle_line2), ...])\n"
+    "Every element set of many satellites over time, by NORAD id and epoch.\n", /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    Archive_methods,                            /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    0,                                          /* tp_init */
+    0,                                          /* tp_alloc */
+    Archive_new,                                /* tp_new */
+};
+
+int LoadArrayType() {
+    PyObject *module = PyImport_ImportModule("array");
+
+    if (module == NULL)
+    {
+        return -1;
+    }
+
+    ArrayType = PyObject_GetAttrString(module, "array");
+    Py_DECREF(module);
+    return ArrayType == NULL ? -1 : 0;
+}
+
+// Picks the best batch kernels the processor runs, unless the PYPREDICT_KERNELS environment
+// variable names others.  If it names ones that are unknown, or that the processor doesn't run,
+// the best are used anyway, with a RuntimeWarning saying so.
+int LoadKernels() {
+    const char *name = getenv("PYPREDICT_KERNELS");
+    char message[200];
+
+    if (SGP4BatchSelectKernels(name) == 0)
+    {
+        return 0;
+    }
+
+    SGP4BatchSelectKernels(NULL);
+    snprintf(message, sizeof(message), "PYPREDICT_KERNELS=%.40s names no kernels this processor runs, using %s",
+             name, SGP4BatchKernels());
+    return PyErr_WarnEx(PyExc_RuntimeWarning, message, 1);
+}
+
+static PyMethodDef pypredict_funcs[] = {
+    {"quick_find"   , (PyCFunction)quick_find   , METH_VARARGS, quick_find_docs},
+    {"quick_predict", (PyCFunction)quick_predict, METH_VARARGS, quick_predict_docs},
+    {"simd_kernels" , (PyCFunction)simd_kernels , METH_NOARGS , simd_kernels_docs},
+    {NULL, NULL, 0, NULL}
+};
+
+#if PY_MAJOR_VERSION >= 3
+    static int cpredict_traverse(PyObject *m, visitproc visit, void *arg) {
+        return 0;
+    }
+
+    static int cpredict_clear(PyObject *m) {
+        return 0;
+    }
+
+    static void cpredict_free(void *m) {
+        ClearObservationFreelist();
+    }
+
+    static struct PyModuleDef moduledef = {
+        PyModuleDef_HEAD_INIT,
+        "cpredict",
+        "Python port of the predict open source satellite tracking library",
+        0,
+        pypredict_funcs,
+        NULL,
+        cpredict_traverse,
+        cpredict_clear,
+        cpredict_free
+    };
+
+    PyMODINIT_FUNC
+    PyInit_cpredict(void)
+    {
+        PyObject *module;
+
+        load_checksums();
+        PyStructSequence_InitType(&TransitTimesType, &transit_times_desc);
+
+        if (PyType_Ready(&SatelliteType) < 0 || PyType_Ready(&CatalogType) < 0 || PyType_Ready(&StationsType) < 0 ||
+            PyType_Ready(&ArchiveType) < 0 ||
+            PyType_Ready(&TransitsType) < 0 ||
+            PyType_Ready(&ObservationType) < 0 || PyType_Ready(&ObservationsType) < 0 ||
+            LoadArrayType() != 0 || LoadObservationKeys() != 0 || LoadObservationFormat() != 0 ||
+            LoadKernels() != 0) {
+            return NULL;
+        }
+
+        module = PyModule_Create(&moduledef);
+
+        if (module == NULL) {
+            fprintf(stderr, "ERROR: Unable to initialize python module 'cpredict'\n");
+            return NULL;
+        }
+
+        Py_INCREF(&SatelliteType);
+        PyModule_AddObject(module, "Satellite", (PyObject *)&SatelliteType);
+
+        Py_INCREF(&CatalogType);
+        PyModule_AddObject(module, "Catalog", (PyObject *)&CatalogType);
+
+        Py_INCREF(&StationsType);
+        PyModule_AddObject(module, "Stations", (PyObject *)&StationsType);
+
+        Py_INCREF(&ArchiveType);
+        PyModule_AddObject(module, "Archive", (PyObject *)&ArchiveType);
+
+        Py_INCREF(&TransitTimesType);
+        PyModule_AddObject(module, "TransitTimes", (PyObject *)&TransitTimesType);
+
+        Py_INCREF(&ObservationType);
+        PyModule_AddObject(module, "Observation", (PyObject *)&ObservationType);
+
+        Py_INCREF(&ObservationsType);
+        PyModule_AddObject(module, "Observations", (PyObject *)&ObservationsType);
+
+        return module;
+    }
+#else
+    void initcpredict(void)
+    {
+        PyObject *m;
+
+        load_checksums();
+        PyStructSequence_InitType(&TransitTimesType, &transit_times_desc);
+
+        if (PyType_Ready(&SatelliteType) < 0 || PyType_Ready(&CatalogType) < 0 || PyType_Ready(&StationsType) < 0 ||
+            PyType_Ready(&ArchiveType) < 0 ||
+            PyType_Ready(&TransitsType) < 0 ||
+            PyType_Ready(&ObservationType) < 0 || PyType_Ready(&ObservationsType) < 0 ||
+            LoadArrayType() != 0 || LoadObservationKeys() != 0 || LoadObservationFormat() != 0 ||
+            LoadKernels() != 0) {
+            return;
+        }
+
+        m = Py_InitModule3("cpredict", pypredict_funcs,
+                        "Python port of the predict open source satellite tracking library");
 
         if (m == NULL) {
             fprintf(stderr, "ERROR: Unable to initialize python module 'cpredict'\n");
+            return;
         }
+
+        Py_INCREF(&SatelliteType);
+        PyModule_AddObject(m, "Satellite", (PyObject *)&SatelliteType);
+
+        Py_INCREF(&CatalogType);
+        PyModule_AddObject(m, "Catalog", (PyObject *)&CatalogType);
+
+        Py_INCREF(&StationsType);
+        PyModule_AddObject(m, "Stations", (PyObject *)&StationsType);
+
+        Py_INCREF(&ArchiveType);
+        PyModule_AddObject(m, "Archive", (PyObject *)&ArchiveType);
+
+        Py_INCREF(&TransitTimesType);
+        PyModule_AddObject(m, "TransitTimes", (PyObject *)&TransitTimesType);
+
+        Py_INCREF(&ObservationType);
+        PyModule_AddObject(m, "Observation", (PyObject *)&ObservationType);
+
+        Py_INCREF(&ObservationsType);
+        PyModule_AddObject(m, "Observations", (PyObject *)&ObservationsType);
     }
 #endif
 
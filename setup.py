@@ -10,5 +10,10 @@ setup(
     maintainer_email="ben.gaudiosi@analyticalspace.com",
     url="https://github.com/analyticalspace/pypredict/",
     py_modules=['predict'],
-    ext_modules=[Extension('cpredict', ['predict.c', 'pypredict.c'])]
+    ext_modules=[Extension('cpredict', ['predict.c', 'batch.c', 'pypredict.c'],
+        # rebuild when the headers change too, lanemath.h above all, which is nothing but inline code
+        depends=['predict.h', 'lanemath.h'],
+        # batch.c passes SIMD vectors between static functions, which is only an ABI concern across objects;
+        # its kernels are built for several instruction sets, which must all round alike
+        extra_compile_args=['-Wno-psabi', '-ffp-contract=off'])]
     )
@@ -0,0 +1,75 @@
+"""
+Checks that observing into caller-supplied out= arrays allocates nothing in the steady state, as a
+real-time tracker repointing at a few dozen satellites at 10 Hz needs, and that the values written
+are the ones the allocating calls return.
+"""
+import array
+import time
+import tracemalloc
+
+import predict
+
+TLES = [
+    '0 OBJECT NY\n1 43550U 98067NY  19009.55938219 +.00013482 +00000-0 +17279-3 0  9995\n2 43550 051.6378 066.3469 0004106 279.6394 080.4135 15.59492665028120',
+    '0 LEMUR 1\n1 40044U 14033AL  15013.74135905  .00002013  00000-0  31503-3 0  6119\n2 40044 097.9584 269.2923 0059425 258.2447 101.2095 14.72707190 30443',
+]
+QTH = (37.771034, 122.413815, 7)
+SATELLITES = 40
+TICKS = 500
+
+satellites = [predict.Satellite(TLES[i % len(TLES)].split('\n')) for i in range(SATELLITES)]
+catalog = predict.Catalog([tle.split('\n') for tle in TLES])
+stations = predict.Stations([QTH, (0, 0, 0)])
+
+now = array.array('d', [1547051000.0])
+pointing = [{'azimuth': array.array('d', [0.0]), 'elevation': array.array('d', [0.0])} for _ in satellites]
+records = [satellite.observe_records(now, QTH) for satellite in satellites]
+looks = satellites[0].observe_stations(now[0], stations)
+states = catalog.propagate(now[0])
+bits = bytearray(len(catalog) * len(stations) * 2)
+
+def tick(t):
+    now[0] = t
+    for satellite, out, rows in zip(satellites, pointing, records):
+        satellite.observe_many(now, QTH, out=out)
+        satellite.observe_records(now, QTH, out=rows)
+    satellites[0].observe_stations(t, stations, out=looks)
+    catalog.propagate(t, out=states)
+    catalog.visibility(stations, t, 60.0, 16, out=bits)
+
+# Warm up, so anything cached on first use is already there.
+for i in range(10):
+    tick(1547051000.0 + i * 0.1)
+
+epochs = [1547051001.0 + i * 0.1 for i in range(TICKS)]
+tracemalloc.start()
+before = tracemalloc.take_snapshot()
+for t in epochs:
+    tick(t)
+after = tracemalloc.take_snapshot()
+tracemalloc.stop()
+
+def ours(stat):
+    return all(frame.filename != tracemalloc.__file__ for frame in stat.traceback)
+
+grown = [stat for stat in after.compare_to(before, 'traceback') if stat.size_diff > 0 and ours(stat)]
+for stat in grown:
+    print(stat)
+assert not grown, "steady state observing allocated memory"
+
+expected = satellites[1].observe(t, QTH)
+assert pointing[1]['azimuth'][0] == expected['azimuth']
+assert pointing[1]['elevation'][0] == expected['elevation']
+assert records[1][0] == expected
+assert list(looks['elevation']) == list(satellites[0].observe_stations(t, stations)['elevation'])
+assert list(states['x']) == list(catalog.propagate(t)['x'])
+assert bits == catalog.visibility(stations, t, 60.0, 16)
+
+try:
+    satellites[0].observe_many(now, QTH, out={'elevation': array.array('f', [0.0])})
+except ValueError:
+    pass
+else:
+    raise AssertionError("out arrays of the wrong type must be refused")
+
+print("%d satellites x %d ticks observed into out= without allocating" % (SATELLITES, TICKS))
@@ -0,0 +1,113 @@
+"""
+Checks Archive against a search through its element sets in python: find must pick the element
+set of a satellite nearest a time, or the latest at or before it, and observe must observe by
+that element set as Satellite.observe does.  An Archive read from a file, or saved and memory
+mapped again, must pick the same element sets.
+"""
+import os
+import random
+import shutil
+import struct
+import tempfile
+
+import predict
+
+QTH = (37.771034, 122.413815, 7)
+YEAR = 1767225600.0  # 2026-01-01, day 1.0 of the TLE epochs below
+
+
+def checksum(line):
+    return str(sum(int(c) if c.isdigit() else (c == '-') for c in line) % 10)
+
+
+def tle(catnum, day, mean_anomaly):
+    line1 = '1 %05dU 26001A   26%012.8f  .00001000  00000-0  10000-3 0  999' % (catnum, day)
+    line2 = '2 %05d  51.6400 120.0000 0004000  90.0000 %8.4f 15.50000000  100' % (catnum, mean_anomaly)
+    return ('SAT %d' % catnum, line1 + checksum(line1), line2 + checksum(line2))
+
+
+# A few element sets a week for each satellite, in no particular order, one with a single one.
+rng = random.Random(19)
+element_sets = {}
+for catnum in (25544, 1, 99999, 43550, 40044):
+    days = sorted(rng.uniform(1, 120) for _ in range(1 if catnum == 1 else 40))
+    element_sets[catnum] = [tle(catnum, day, rng.uniform(0, 360)) for day in days]
+tles = [lines for sets in element_sets.values() for lines in sets]
+rng.shuffle(tles)
+
+
+def epoch(lines):
+    return YEAR + (float(lines[1][20:32]) - 1) * 86400
+
+
+def expected(catnum, t, before):
+    sets = element_sets[catnum]
+    if before:
+        sets = [lines for lines in sets if epoch(lines) <= t]
+        return max(sets, key=epoch) if sets else None
+    return min(sets, key=lambda lines: abs(epoch(lines) - t))
+
+
+def check(archive):
+    assert len(archive) == len(tles)
+    for catnum, sets in element_sets.items():
+        # A second either side of each epoch, which is converted with some rounding, and anywhere
+        times = [epoch(lines) + delta for lines in sets for delta in (-1, 1)] + [YEAR + rng.uniform(-10, 130) * 86400 for _ in range(50)]
+        for t in times:
+            for before in (False, True):
+                want = expected(catnum, t, before)
+                if want is None:
+                    try:
+                        archive.find(catnum, t, before)
+                    except KeyError:
+                        continue
+                    raise AssertionError("nothing of %d before %f, but found one" % (catnum, t))
+                found = archive.find(catnum, t, before)
+                # Ties between the two nearest go either way
+                assert tuple(found) == want or (not before and abs(epoch(found) - t) == abs(epoch(want) - t)), (catnum, t, before)
+                assert archive.satellite(catnum, t, before) is archive.satellite(catnum, t, before)
+        t = times[-1]
+        assert archive.observe(catnum, t, QTH) == predict.Satellite(list(archive.find(catnum, t))).observe(t, QTH)
+    try:
+        archive.find(12345, YEAR)
+    except KeyError:
+        pass
+    else:
+        raise AssertionError("an unknown NORAD id must raise KeyError")
+
+
+archive = predict.Archive(tles)
+check(archive)
+
+directory = tempfile.mkdtemp()
+try:
+    path = os.path.join(directory, 'archive.tle')
+    with open(path, 'w') as f:
+        f.write(''.join('\n'.join(lines) + '\n' for lines in tles))
+    check(predict.Archive.from_file(path))
+
+    path = os.path.join(directory, 'archive.bin')
+    archive.save(path)
+    check(predict.Archive.from_compiled(path))
+
+    # An entry whose strings run on to the end of its array, the last one's into the end of the map,
+    # is refused.  The header is 8 bytes of magic, 4 ints and 2 offsets, the entries' the first.
+    with open(path, 'rb') as f:
+        good = f.read()
+    entry_offset = struct.unpack_from('=8s4i2q', good)[5]
+    entry_size = struct.unpack_from('=8s4i2q', good)[3]
+    for field, size in ((16, 25), (41, 70), (111, 70)):
+        at = entry_offset + (len(tles) - 1) * entry_size + field
+        with open(path, 'wb') as f:
+            f.write(good[:at] + b'9' * size + good[at + size:])
+        try:
+            predict.Archive.from_compiled(path)
+        except ValueError:
+            pass
+        else:
+            raise AssertionError("an archive with unterminated strings must be refused")
+finally:
+    shutil.rmtree(directory)
+
+print("Archive finds and observes by the element sets expected among %d element sets of %d satellites, read and mapped alike"
+      % (len(tles), len(element_sets)))
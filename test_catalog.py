@@ -0,0 +1,193 @@
+"""
+Checks Catalog against Satellite, satellite by satellite, over a catalog of every orbit class the
+batch kernels tell apart: near-earth ones low enough for SGP4's simple model, the rest of the
+near-earth ones, and deep-space ones propagated by SDP4, resonant and not.  With exact=True, its
+default, Catalog.propagate must give bit for bit the positions and velocities Satellite.observe does.
+Catalog.from_file must read the same catalog from a file of its TLEs, and refuse one with a bad
+checksum.  Catalog.update must replace elements, moving satellites between orbit classes, and
+append new satellites, without a thread propagating meanwhile ever seeing half of an update.
+Catalog.save and Catalog.from_compiled must round-trip the catalog, and refuse damaged files.
+"""
+import os
+import random
+import shutil
+import struct
+import tempfile
+import threading
+
+import predict
+
+QTH = (0, 0, 0)
+EPOCH = 1791806400.0  # 2026 day 285.5, the epoch of every element set
+STATE = ('x', 'y', 'z', 'x_vel', 'y_vel', 'z_vel')
+
+
+def checksum(line):
+    return str(sum(int(c) if c.isdigit() else (c == '-') for c in line) % 10)
+
+
+def tle(catnum, incl, raan, ecc, argp, mean_anomaly, mean_motion, bstar):
+    line1 = '1 %05dU 26001A   26285.50000000  .00001000  00000-0 %s 0  999' % (catnum, bstar)
+    line2 = '2 %05d %8.4f %8.4f %07d %8.4f %8.4f %11.8f  100' % (catnum, incl, raan, ecc, argp, mean_anomaly, mean_motion)
+    return ['REF %d' % catnum, line1 + checksum(line1), line2 + checksum(line2)]
+
+
+# (name, mean motion, eccentricity * 1e7) of each orbit class: perigees below 220 km take the simple
+# model, and SDP4 integrates resonance for periods near a day, or half a day with eccentricity over 0.5
+CLASSES = [
+    ('simple', (16.3, 16.5), (0, 5000)),
+    ('near-earth', (11.5, 15.9), (0, 50000)),
+    ('deep-space', (3.0, 6.3), (0, 200000)),
+    ('12 hour resonant', (1.9, 2.1), (5000000, 7400000)),
+    ('geostationary', (0.99, 1.01), (0, 5000)),
+]
+
+rng = random.Random(22)
+
+
+def elements(catnum, orbit_class):
+    name, (mm_low, mm_high), (ecc_low, ecc_high) = orbit_class
+    bstar = ' %05d-4' % rng.randint(10000, 99999) if mm_low > 11 else ' 00000+0'
+    return tle(catnum, rng.uniform(0, 180), rng.uniform(0, 360), rng.randint(ecc_low, ecc_high),
+               rng.uniform(0, 360), rng.uniform(0, 360), rng.uniform(mm_low, mm_high), bstar)
+
+
+tles = [elements(20000 + i, CLASSES[i % len(CLASSES)]) for i in range(250)]
+classes = [CLASSES[i % len(CLASSES)][0] for i in range(250)]
+
+catalog = predict.Catalog(tles)
+satellites = [predict.Satellite(lines) for lines in tles]
+assert len(catalog) == len(tles)
+
+checked = dict((name, 0) for name, _, _ in CLASSES)
+for minutes in (-2880, -90, 0, 17, 600, 4320):
+    t = EPOCH + minutes * 60
+    states = catalog.propagate(t, exact=True)
+    assert catalog.propagate(t) == states, "Catalog.propagate must default to exact"
+    for satellite, lines, name in zip(satellites, tles, classes):
+        expected = satellite.observe(t, QTH)
+        i = catalog.index(int(lines[1][2:7]))
+        got = tuple(states[k][i] for k in STATE)
+        assert got == tuple(expected[k] for k in STATE), \
+            "%s satellite %s at %+d minutes: %r, not %r" % (name, lines[1][2:7], minutes, got, tuple(expected[k] for k in STATE))
+        checked[name] += 1
+
+print("Catalog.propagate(exact=True) matches Satellite.observe: %s"
+      % ", ".join("%d %s" % (checked[name], name) for name, _, _ in CLASSES))
+
+# The same TLEs in a file, some with a name line and some without, some with CRLF line ends.
+directory = tempfile.mkdtemp()
+try:
+    path = os.path.join(directory, 'catalog.tle')
+    with open(path, 'wb') as f:
+        for i, lines in enumerate(tles):
+            f.write(('\r\n' if i % 3 == 2 else '\n').join(lines[i % 2:]).encode() + b'\n')
+    t = EPOCH + 1000
+    expected = catalog.propagate(t, exact=True)
+    for threads in (1, 3, 0):
+        loaded = predict.Catalog.from_file(path, threads)
+        assert len(loaded) == len(catalog) and loaded.norad_ids() == catalog.norad_ids()
+        assert loaded.propagate(t, exact=True) == expected
+
+    # A record whose checksum is wrong is refused.
+    with open(path, 'rb') as f:
+        text = f.read()
+    with open(path, 'wb') as f:
+        f.write(text.replace(tles[7][2].encode(), (tles[7][2][:-1] + str((int(tles[7][2][-1]) + 1) % 10)).encode()))
+    try:
+        predict.Catalog.from_file(path)
+    except RuntimeError:
+        pass
+    else:
+        raise AssertionError("a TLE with a bad checksum must be refused")
+finally:
+    shutil.rmtree(directory)
+
+print("Catalog.from_file reads the same catalog")
+
+# New elements for every third satellite, each in the next orbit class along, and new satellites.
+old_ids = catalog.norad_ids()
+replaced = dict((20000 + i, elements(20000 + i, CLASSES[(i + 1) % len(CLASSES)])) for i in range(0, len(tles), 3))
+added = [elements(29000 + i, CLASSES[i % len(CLASSES)]) for i in range(12)]
+updated = [replaced.get(int(lines[1][2:7]), lines) for lines in tles] + added
+
+t = EPOCH + 7200
+before = catalog.propagate(t, exact=True)
+after = [satellite.observe(t, QTH) for satellite in (predict.Satellite(lines) for lines in updated)]
+catalog.update(list(replaced.values()) + added)
+assert catalog.norad_ids() == old_ids + [int(lines[1][2:7]) for lines in added]
+states = catalog.propagate(t, exact=True)
+for lines, expected in zip(updated, after):
+    i = catalog.index(int(lines[1][2:7]))
+    assert tuple(states[k][i] for k in STATE) == tuple(expected[k] for k in STATE), lines[1][2:7]
+
+# Swapping back and forth under a propagating thread: every satellite it sees is wholly one or the other.
+olds = [tuple(before[k][i] for k in STATE) for i in range(len(tles))]
+news = [tuple(states[k][i] for k in STATE) for i in range(len(tles))]
+seen = []
+done = threading.Event()
+
+
+def propagate():
+    while not done.is_set():
+        states = catalog.propagate(t, exact=True)
+        seen.append([tuple(states[k][i] for k in STATE) for i in range(len(tles))])
+
+
+reader = threading.Thread(target=propagate)
+reader.start()
+try:
+    for i in range(200):
+        catalog.update([tles[j] for j in range(0, len(tles), 3)] if i % 2 == 0 else list(replaced.values()))
+finally:
+    done.set()
+    reader.join()
+assert seen and all(state in (old, new) for states in seen for state, old, new in zip(states, olds, news))
+
+print("Catalog.update replaces and appends satellites, seen wholly before or after by %d propagations" % len(seen))
+
+# Compiled catalogs propagate as the catalog saved does, keeping deep-space checkpoints of their
+# own, and can be saved again.  The header is 8 bytes of magic, 10 ints and 8 offsets, the
+# deep-space contexts' the second of them.
+HEADER = struct.Struct('=8s10i8q')
+directory = tempfile.mkdtemp()
+try:
+    path = os.path.join(directory, 'catalog.bin')
+    catalog.propagate(EPOCH + 40 * 86400, exact=True)
+    catalog.save(path)
+    loaded = predict.Catalog.from_compiled(path)
+    assert len(loaded) == len(catalog) and loaded.norad_ids() == catalog.norad_ids()
+    for days in (0, 40, 3, -20, 41.5):
+        t = EPOCH + days * 86400
+        assert loaded.propagate(t, exact=True) == catalog.propagate(t, exact=True), days
+        assert loaded.propagate(t, exact=False) == catalog.propagate(t, exact=False), days
+    again = os.path.join(directory, 'again.bin')
+    loaded.save(again)
+    assert predict.Catalog.from_compiled(again).propagate(EPOCH, exact=True) == catalog.propagate(EPOCH, exact=True)
+
+    with open(path, 'rb') as f:
+        good = f.read()
+    header = HEADER.unpack_from(good)
+    deep_count, deep_offset, sat_offset = header[9], header[12], header[13]
+    assert deep_count > 0
+    damaged = {
+        'magic': b'X' + good[1:],
+        'version': good[:8] + struct.pack('=i', header[1] + 1) + good[12:],
+        'truncated': good[:len(good) // 2],
+        'deep-space contexts': good[:deep_offset] + b'\xff' * (sat_offset - deep_offset) + good[sat_offset:],
+        'satellite name': good[:sat_offset + 140] + b'X' * 25 + good[sat_offset + 165:],
+        'element lines': good[:sat_offset] + b'1' * 140 + good[sat_offset + 140:],
+    }
+    for damage, data in damaged.items():
+        with open(path, 'wb') as f:
+            f.write(data)
+        try:
+            predict.Catalog.from_compiled(path)
+        except ValueError:
+            pass
+        else:
+            raise AssertionError("a compiled catalog with damaged %s must be refused" % damage)
+finally:
+    shutil.rmtree(directory)
+
+print("Catalog.save and Catalog.from_compiled round-trip, and damaged files are refused")
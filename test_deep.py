@@ -0,0 +1,137 @@
+"""
+Checks that SDP4's resonance integrator, resumed from the checkpoints it keeps on the way out
+from epoch, comes to exactly what it does integrating from epoch afresh.  A Satellite keeps
+checkpoints from one call to the next, and from one thread to another, so must observe bit for
+bit what a fresh Satellite.observe does at every time, in any order, and Catalog.visibility
+keeps them from one step to the next, so its bits must say just when a fresh Satellite.observe
+finds each satellite up.  Resuming makes a time far from epoch cost no more to observe than one
+near it, once the way out has been integrated.
+"""
+import random
+import threading
+import time
+
+import predict
+
+QTH = (37.771034, 122.413815, 7)
+EPOCH = 1791806400.0  # 2026 day 285.5, the epoch of every element set
+STATE = ('x', 'y', 'z', 'x_vel', 'y_vel', 'z_vel', 'latitude', 'longitude', 'altitude', 'azimuth', 'elevation')
+
+
+def checksum(line):
+    return str(sum(int(c) if c.isdigit() else (c == '-') for c in line) % 10)
+
+
+def tle(catnum, incl, ecc, mean_motion):
+    line1 = '1 %05dU 26001A   26285.50000000  .00000000  00000-0  00000+0 0  999' % catnum
+    line2 = '2 %05d %8.4f 120.0000 %07d 270.0000  30.0000 %11.8f  100' % (catnum, incl, ecc, mean_motion)
+    return ['DEEP %d' % catnum, line1 + checksum(line1), line2 + checksum(line2)]
+
+
+# Resonant orbits, whose integrator steps out from epoch: Molniya and GPS at half a day,
+# geostationary and drifting near it at a day.
+tles = [tle(30001, 63.4, 7200000, 2.00563), tle(30002, 55.0, 5100000, 2.00562),
+        tle(30003, 0.05, 2000, 1.00272), tle(30004, 7.5, 300000, 0.99100)]
+
+rng = random.Random(20)
+
+# Far out first, each way, then times nearer epoch that start from the checkpoints kept getting
+# there, two days apart, and times beyond them.
+far = [days * 86400 for days in (90, -75, 30.2, -30.2)]
+times = [EPOCH + t + d for t in far for d in (0, -43200, -1, 1, 43200)]
+times += [EPOCH + rng.uniform(-80, 100) * 86400 for _ in range(60)]
+times += [EPOCH + days * 86400 for days in (400, -390, 383.9, -384.1)]
+checked = 0
+for lines in tles:
+    satellite = predict.Satellite(lines)
+    fresh = [predict.Satellite(lines).observe(t, QTH) for t in times]
+    states = satellite.observe_many(times, QTH)
+    for i, t in enumerate(times):
+        got = tuple(states[k][i] for k in STATE)
+        assert got == tuple(fresh[i][k] for k in STATE), "%s at %+.3f days" % (lines[0], (t - EPOCH) / 86400)
+        checked += 1
+
+    # One observation at a time, in another order, from the checkpoints already kept
+    order = list(range(len(times)))
+    rng.shuffle(order)
+    for i in order:
+        got = satellite.observe(times[i], QTH)
+        assert all(got[k] == fresh[i][k] for k in STATE), "%s at %+.3f days" % (lines[0], (times[i] - EPOCH) / 86400)
+        checked += 1
+
+# Threads sharing one satellite keep checkpoints for each other as they go.
+lines = tles[0]
+satellite = predict.Satellite(lines)
+spans = [[EPOCH + rng.uniform(-200, 200) * 86400 for _ in range(200)] for _ in range(8)]
+results = [None] * len(spans)
+
+
+def observe(n):
+    results[n] = satellite.observe_many(spans[n], QTH)
+
+
+threads = [threading.Thread(target=observe, args=(n,)) for n in range(len(spans))]
+for thread in threads:
+    thread.start()
+for thread in threads:
+    thread.join()
+for span, states in zip(spans, results):
+    for i, t in enumerate(span):
+        fresh = predict.Satellite(lines).observe(t, QTH)
+        assert tuple(states[k][i] for k in STATE) == tuple(fresh[k] for k in STATE), "threaded, %+.3f days" % ((t - EPOCH) / 86400)
+        checked += 1
+
+print("%d observations resumed from checkpoints match fresh ones" % checked)
+
+# Visibility steps each satellite out from epoch, resuming from the checkpoint of a step before.
+catalog = predict.Catalog(tles)
+satellites = [predict.Satellite(lines) for lines in tles]
+STEP, STEPS = 0.37 * 86400, 240
+row = (STEPS + 7) // 8
+set_bits = 0
+for start in (EPOCH, EPOCH - STEPS * STEP):
+    bits = catalog.visibility([QTH], start, STEP, STEPS, 0, 1)
+    for lines, satellite in zip(tles, satellites):
+        i = catalog.index(int(lines[1][2:7]))
+        for k in range(STEPS):
+            visible = satellite.observe(start + k * STEP, QTH)['elevation'] >= 0
+            bit = bits[i * row + k // 8] >> (k % 8) & 1
+            assert bit == visible, "%s at step %d: bit %d" % (lines[0], k, bit)
+            set_bits += bit
+
+print("visibility resumed from checkpoints over %d steps matches fresh elevations, %d bits set" % (STEPS, set_bits))
+
+
+# Random times up to 300 days out cost about what random times up to 10 days out do, once the
+# satellite has been there, and so does observing one time over and over far from epoch.
+def per_time(satellite, times):
+    best = float('inf')
+    for _ in range(3):
+        rng.shuffle(times)
+        start = time.time()
+        satellite.observe_many(times, QTH)
+        best = min(best, (time.time() - start) / len(times))
+    return best
+
+
+def per_observe(satellite, t):
+    best = float('inf')
+    for _ in range(3):
+        start = time.time()
+        for i in range(200):
+            satellite.observe(t + i, QTH)
+        best = min(best, (time.time() - start) / 200)
+    return best
+
+
+satellite = predict.Satellite(tles[0])
+near = [EPOCH + rng.uniform(0, 10) * 86400 for _ in range(2000)]
+wide = [EPOCH + rng.uniform(0, 300) * 86400 for _ in range(2000)]
+satellite.observe_many(wide, QTH)
+near_cost, wide_cost = per_time(satellite, near), per_time(satellite, wide)
+assert wide_cost < 3 * near_cost, "%.1f us a time over 300 days, %.1f over 10" % (wide_cost * 1e6, near_cost * 1e6)
+day_cost, far_cost = per_observe(satellite, EPOCH + 86400), per_observe(satellite, EPOCH + 300 * 86400)
+assert far_cost < 3 * day_cost, "%.1f us an observation at day 300, %.1f at day 1" % (far_cost * 1e6, day_cost * 1e6)
+
+print("random times over 300 days take %.1f us each, over 10 days %.1f; observing at day 300 %.1f us, at day 1 %.1f" %
+      (wide_cost * 1e6, near_cost * 1e6, far_cost * 1e6, day_cost * 1e6))
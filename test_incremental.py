@@ -0,0 +1,43 @@
+"""
+Holds Satellite.observe_many(incremental=True) to its documented bound: sweeping forward in time,
+each time starting Kepler's equation from the solution before it and keeping the deep-space state,
+positions must stay within 1.1e-6 of the semi-major axis of what the default path gives, as both
+stop at Kepler's equation's 1e-6 radian tolerance from different starts.  That is some 8 m in low
+earth orbit, 30 m for half-day orbits like GPS and Molniya and 47 m at geostationary.
+"""
+import math
+
+import predict
+
+QTH = (37.771034, 122.413815, 7)
+START = 1791806400.0 + 1.5 * 86400  # a day and a half after 2026 day 285.5, the epoch of each
+BOUND = 1.1e-6
+MU = 398600.8  # km^3/s^2, SGP4's WGS-72 gravitational parameter
+
+TLES = [
+    ('ISS', '1 25544U 98067A   26285.50000000  .00016717  00000-0  10270-3 0  9993',
+            '2 25544  51.6416 247.4627 0006703 130.5360 325.0288 15.72125391563537'),
+    ('SSO', '1 40044U 14033AL  26284.74135905  .00002013  00000-0  31503-3 0  6111',
+            '2 40044  97.9584 269.2923 0059425 258.2447 101.2095 14.72707190304436'),
+    ('GPS', '1 32711U 08012A   26285.50000000 -.00000058  00000-0  00000+0 0  9996',
+            '2 32711  55.4408 300.3623 0111131  52.5620 308.4826  2.00563146 85345'),
+    ('MOLNIYA', '1 21118U 91012A   26285.50000000  .00000136  00000-0  10000-3 0  9998',
+                '2 21118  62.8640 103.1190 7283420 269.4519  16.6823  2.00612789199996'),
+    ('GEO', '1 28884U 05041A   26285.50000000 -.00000100  00000-0  00000+0 0  9999',
+            '2 28884   8.5000  60.0000 0002000 100.0000 260.0000  1.00400000 70004'),
+]
+
+worst_ratio = 0.0
+for lines in TLES:
+    satellite = predict.Satellite(list(lines))
+    mean_motion = float(lines[2][52:63]) * 2 * math.pi / 86400
+    bound = BOUND * (MU / mean_motion ** 2) ** (1.0 / 3)
+    for step in (1.0, 10.0, 60.0, 600.0):
+        times = [START + k * step for k in range(3000)]
+        default = satellite.observe_many(times, QTH, ('x', 'y', 'z'))
+        stepped = satellite.observe_many(times, QTH, ('x', 'y', 'z'), incremental=True)
+        worst = max(math.sqrt(sum((stepped[k][i] - default[k][i]) ** 2 for k in 'xyz')) for i in range(len(times)))
+        assert worst <= bound, "%s at %gs steps: %.2f m, past %.2f m" % (lines[0], step, worst * 1000, bound * 1000)
+        worst_ratio = max(worst_ratio, worst / bound * BOUND)
+
+print("incremental sweeps stay within %.3g of the semi-major axis of the default path" % worst_ratio)
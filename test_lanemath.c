@@ -0,0 +1,369 @@
+/* Accuracy test of lanemath.h against libm: every function over lanes
+   of doubles is run over random arguments across its domain, and
+   near the edges of each range reduction and approximation, and its
+   results must stay within MAX_ULPS units in the last place of what
+   libm gives, special values included.  lane_fmod2p() must match
+   FMod2p() bit for bit.  The single precision lane32_sincos() and
+   lane32_atan2() must stay within MAX_ULPS32 units in the last place
+   of a float of the double precision result.  Reports the worst error
+   and the time per lane of each against libm.
+
+	make test_lanemath && ./test_lanemath
+*/
+
+#include "predict.h"
+#include "lanemath.h"
+
+#define CASES     400000
+#define MAX_ULPS  2.0
+#define MAX_ULPS32  2.0
+
+typedef struct  {
+           const char  *name;
+           double  worst, at_y, at_x;
+           long  cases;
+        }  accuracy_t;
+
+static double Uniform(double low, double high)
+{
+	/* 53 random bits, scaled */
+
+	double u=((double)(rand()&0x3ffffff)*134217728.0+(rand()&0x7ffffff))/9007199254740992.0;
+
+	return low+(high-low)*u;
+}
+
+static double LogUniform(double low, double high)
+{
+	/* Magnitude spread evenly over the decades, either sign */
+
+	double x=exp(Uniform(log(low), log(high)));
+
+	return rand()&1 ? -x : x;
+}
+
+static double Ulps(double got, double want)
+{
+	/* got-want in units of the last place of want */
+
+	double ulp;
+
+	if (got==want || (isnan(got) && isnan(want)))
+		return 0.0;
+
+	if (isnan(got) || isnan(want) || isinf(want))
+		return INFINITY;
+
+	ulp=nextafter(fabs(want), INFINITY)-fabs(want);
+
+	return fabs(got-want)/ulp;
+}
+
+static double Ulps32(float got, double want)
+{
+	/* got-want in units of the last place of want as a float */
+
+	float ulp;
+
+	if (isnan(got) && isnan(want))
+		return 0.0;
+
+	if (isnan(got) || isnan(want) || isinf(want))
+		return got==want ? 0.0 : INFINITY;
+
+	ulp=nextafterf(fabsf((float)want), INFINITY)-fabsf((float)want);
+
+	return fabs(got-want)/ulp;
+}
+
+static void Note(accuracy_t *e, double ulps, double y, double x)
+{
+	if (ulps>e->worst)
+	{
+		e->worst=ulps;
+		e->at_y=y;
+		e->at_x=x;
+	}
+
+	e->cases++;
+}
+
+static void Record(accuracy_t *e, double got, double want, double y, double x)
+{
+	Note(e, Ulps(got, want), y, x);
+}
+
+static void SinCos(accuracy_t *es, accuracy_t *ec, const double *x, int n)
+{
+	lane_t v, sinx, cosx;
+	int i, j;
+
+	for (i=0; i+SGP4_LANES<=n; i+=SGP4_LANES)
+	{
+		for (j=0; j<SGP4_LANES; j++)
+			v[j]=x[i+j];
+
+		lane_sincos(v, &sinx, &cosx);
+
+		for (j=0; j<SGP4_LANES; j++)
+		{
+			Record(es, sinx[j], sin(v[j]), 0.0, v[j]);
+			Record(ec, cosx[j], cos(v[j]), 0.0, v[j]);
+		}
+	}
+}
+
+static void Atan2(accuracy_t *e, const double *y, const double *x, int n)
+{
+	lane_t vy, vx, r;
+	int i, j;
+
+	for (i=0; i+SGP4_LANES<=n; i+=SGP4_LANES)
+	{
+		for (j=0; j<SGP4_LANES; j++)
+		{
+			vy[j]=y[i+j];
+			vx[j]=x[i+j];
+		}
+
+		r=lane_atan2(vy, vx);
+
+		for (j=0; j<SGP4_LANES; j++)
+			Record(e, r[j], atan2(vy[j], vx[j]), vy[j], vx[j]);
+	}
+}
+
+static void SinCos32(accuracy_t *es, accuracy_t *ec, const double *x, int n)
+{
+	lane32_t v, sinx, cosx;
+	int i, j;
+
+	for (i=0; i+SGP4_LANES32<=n; i+=SGP4_LANES32)
+	{
+		for (j=0; j<SGP4_LANES32; j++)
+			v[j]=x[i+j];
+
+		lane32_sincos(v, &sinx, &cosx);
+
+		for (j=0; j<SGP4_LANES32; j++)
+		{
+			Note(es, Ulps32(sinx[j], sin(v[j])), 0.0, v[j]);
+			Note(ec, Ulps32(cosx[j], cos(v[j])), 0.0, v[j]);
+		}
+	}
+}
+
+static void Atan2_32(accuracy_t *e, const double *y, const double *x, int n)
+{
+	lane32_t vy, vx, r;
+	int i, j;
+
+	for (i=0; i+SGP4_LANES32<=n; i+=SGP4_LANES32)
+	{
+		for (j=0; j<SGP4_LANES32; j++)
+		{
+			vy[j]=y[i+j];
+			vx[j]=x[i+j];
+		}
+
+		r=lane32_atan2(vy, vx);
+
+		for (j=0; j<SGP4_LANES32; j++)
+			Note(e, Ulps32(r[j], atan2(vy[j], vx[j])), vy[j], vx[j]);
+	}
+}
+
+static int FMod(const double *x, int n)
+{
+	/* Lanes of lane_fmod2p() that differ from FMod2p() at all */
+
+	lane_t v, r;
+	int i, j, differ=0;
+
+	for (i=0; i+SGP4_LANES<=n; i+=SGP4_LANES)
+	{
+		for (j=0; j<SGP4_LANES; j++)
+			v[j]=x[i+j];
+
+		r=lane_fmod2p(v);
+
+		for (j=0; j<SGP4_LANES; j++)
+		{
+			double want=FMod2p(v[j]);
+
+			if (memcmp(&r[j], &want, sizeof(double))!=0)
+				differ++;
+		}
+	}
+
+	return differ;
+}
+
+static double Seconds(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec+tv.tv_usec/1.0e6;
+}
+
+static double Nanoseconds(int vector, int which, const double *y, const double *x, int n)
+{
+	/* Time per lane of sincos (0) or atan2 (1), through */
+	/* lanemath.h or through libm                        */
+
+	volatile double sink=0.0;
+	lane_t vy, vx, a, b;
+	double start=Seconds();
+	int i, j, k;
+
+	for (k=0; k<8; k++)
+		for (i=0; i+SGP4_LANES<=n; i+=SGP4_LANES)
+		{
+			for (j=0; j<SGP4_LANES; j++)
+			{
+				vy[j]=y[i+j];
+				vx[j]=x[i+j];
+			}
+
+			if (vector)
+			{
+				if (which==0)
+					lane_sincos(vx, &a, &b);
+				else
+					a=b=lane_atan2(vy, vx);
+			}
+
+			else
+				for (j=0; j<SGP4_LANES; j++)
+				{
+					a[j]=which==0 ? sin(vx[j]) : atan2(vy[j], vx[j]);
+					b[j]=which==0 ? cos(vx[j]) : a[j];
+				}
+
+			sink+=a[0]+b[SGP4_LANES-1];
+		}
+
+	return (Seconds()-start)*1.0e9/(8.0*n);
+}
+
+int main(void)
+{
+	static double x[CASES], y[CASES];
+	static const double sincos_range[]={1.0, 2.0*pi, 100.0, 1.0e4, 1.0e5};
+	accuracy_t e[6]={
+		{"sin", 0.0, 0.0, 0.0, 0}, {"cos", 0.0, 0.0, 0.0, 0}, {"atan2", 0.0, 0.0, 0.0, 0},
+		{"sinf", 0.0, 0.0, 0.0, 0}, {"cosf", 0.0, 0.0, 0.0, 0}, {"atan2f", 0.0, 0.0, 0.0, 0}
+	};
+	int i, k, bad=0, differ;
+	double t_vector, t_libm;
+
+	srand(25);
+
+	/* sin and cos: uniform over widening ranges, tiny arguments, */
+	/* next to multiples of pi/2 where the reduction cancels, and */
+	/* beyond 1e5 where libm takes over.                          */
+	for (k=0; k<(int)(sizeof(sincos_range)/sizeof(sincos_range[0])); k++)
+	{
+		for (i=0; i<CASES; i++)
+			x[i]=Uniform(-sincos_range[k], sincos_range[k]);
+
+		SinCos(&e[0], &e[1], x, CASES);
+		SinCos32(&e[3], &e[4], x, CASES);
+	}
+
+	for (i=0; i<CASES; i++)
+		x[i]=LogUniform(1.0e-300, 1.0);
+
+	SinCos(&e[0], &e[1], x, CASES);
+	SinCos32(&e[3], &e[4], x, CASES);
+
+	for (i=0; i<CASES; i++)
+		x[i]=(rand()%20001-10000)*pio2+LogUniform(1.0e-12, 1.0e-3);
+
+	SinCos(&e[0], &e[1], x, CASES);
+	SinCos32(&e[3], &e[4], x, CASES);
+
+	for (i=0; i<CASES; i++)
+		x[i]=LogUniform(1.0e5, 1.0e300);
+
+	x[0]=INFINITY;
+	x[1]=-INFINITY;
+	x[2]=NAN;
+	SinCos(&e[0], &e[1], x, CASES);
+	SinCos32(&e[3], &e[4], x, CASES);
+
+	/* atan2: either sign, magnitudes over many decades, along */
+	/* the axes and the diagonals, and the libm special cases. */
+	for (i=0; i<CASES; i++)
+	{
+		y[i]=LogUniform(1.0e-30, 1.0e30);
+		x[i]=LogUniform(1.0e-30, 1.0e30);
+	}
+
+	Atan2(&e[2], y, x, CASES);
+	Atan2_32(&e[5], y, x, CASES);
+
+	for (i=0; i<CASES; i++)
+	{
+		y[i]=Uniform(-1.0, 1.0);
+		x[i]=i%4==0 ? 0.0 : i%4==1 ? -0.0 : i%4==2 ? y[i]*Uniform(0.999, 1.001) : Uniform(-1.0, 1.0);
+
+		if (i%8==7)
+			y[i]=i%16==7 ? 0.0 : -0.0;
+	}
+
+	y[0]=INFINITY;
+	y[1]=NAN;
+	x[5]=-INFINITY;
+	Atan2(&e[2], y, x, CASES);
+	Atan2_32(&e[5], y, x, CASES);
+
+	printf("%-6s %9s  %9s  %s\n", "", "cases", "max ulps", "at");
+
+	for (k=0; k<6; k++)
+	{
+		printf("%-6s %9ld  %9.3f  %.17g", e[k].name, e[k].cases, e[k].worst, e[k].at_x);
+
+		if (k==2 || k==5)
+			printf(" (y %.17g)", e[k].at_y);
+
+		printf("\n");
+
+		if (!(e[k].worst<=(k<3 ? MAX_ULPS : MAX_ULPS32)))
+			bad=1;
+	}
+
+	/* fmod 2 pi: the arguments SGP4 reduces, and the rest of int */
+	for (i=0; i<CASES; i++)
+		x[i]=i%2 ? Uniform(-1.0e4, 1.0e4) : Uniform(-1.0e9, 1.0e9);
+
+	differ=FMod(x, CASES);
+	printf("%-6s %9d  %9s\n", "fmod2p", CASES, differ ? "DIFFERS" : "exact");
+
+	if (differ)
+		bad=1;
+
+	printf("\n%-6s %12s  %12s\n", "", "lanemath ns", "libm ns");
+
+	for (i=0; i<CASES; i++)
+	{
+		y[i]=Uniform(-1.0, 1.0);
+		x[i]=Uniform(-1.0, 1.0);
+	}
+
+	for (k=0; k<2; k++)
+	{
+		t_vector=Nanoseconds(1, k, y, x, CASES);
+		t_libm=Nanoseconds(0, k, y, x, CASES);
+		printf("%-6s %12.2f  %12.2f  (%.1fx)\n", k==0 ? "sincos" : "atan2", t_vector, t_libm, t_libm/t_vector);
+	}
+
+	if (bad)
+	{
+		printf("lanemath strayed more than %.0f ulps from libm\n", MAX_ULPS);
+		return 1;
+	}
+
+	return 0;
+}
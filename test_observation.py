@@ -0,0 +1,116 @@
+"""
+Checks that observations still work wherever the dictionaries they used to be did: observe,
+quick_find and quick_predict return real dictionaries, and the Observation that Satellite.observe
+returns is a Mapping that can be assigned to, and that pickles, copies and serializes to JSON as
+the dictionary of its fields.  Observing only some fields must give the same values for those
+fields as observing them all, and observe_records' rows, seen through the buffer protocol, the
+values observe gives.
+"""
+import copy
+import gc
+import json
+import pickle
+import struct
+import weakref
+
+try:
+    from collections.abc import Mapping
+except ImportError:
+    from collections import Mapping
+
+import predict
+
+TLE = '0 OBJECT NY\n1 43550U 98067NY  19009.55938219 +.00013482 +00000-0 +17279-3 0  9995\n2 43550 051.6378 066.3469 0004106 279.6394 080.4135 15.59492665028120'
+QTH = (37.771034, 122.413815, 7)
+T = 1547051000.0
+
+# The public functions hand back plain dictionaries, as they always have.
+expected = predict.observe(TLE, QTH, T)
+assert type(expected) is dict
+assert type(predict.quick_find(TLE.split('\n'), T, QTH)) is dict
+assert all(type(obs) is dict for obs in predict.quick_predict(TLE.split('\n'), T, QTH))
+assert json.loads(json.dumps(expected)) == expected
+assert pickle.loads(pickle.dumps(expected)) == expected
+
+obs = predict.Satellite(TLE.split('\n')).observe(T, QTH)
+assert isinstance(obs, Mapping)
+assert obs == expected and obs['elevation'] == obs.elevation == expected['elevation']
+
+# Round trips, each as the dictionary of the fields.
+for protocol in range(pickle.HIGHEST_PROTOCOL + 1):
+    assert pickle.loads(pickle.dumps(obs, protocol)) == expected
+assert copy.copy(obs) == expected and copy.deepcopy(obs) == expected
+assert json.loads(json.dumps(dict(obs))) == json.loads(json.dumps(expected))
+
+# Assigning and deleting keys, and reading them back by every route.
+obs['station'] = 'home'
+obs['elevation'] = 90.0
+del obs['doppler']
+assert obs['station'] == obs.station == obs.get('station') == 'home'
+assert obs['elevation'] == obs.elevation == 90.0
+assert 'doppler' not in obs and obs.get('doppler', 'gone') == 'gone'
+assert len(obs) == len(expected) and set(obs) == set(obs.keys()) == set(expected) - {'doppler'} | {'station'}
+assert dict(obs.items())['station'] == 'home' and 'home' in obs.values()
+assert pickle.loads(pickle.dumps(obs))['station'] == 'home'
+try:
+    del obs['doppler']
+except KeyError:
+    pass
+else:
+    raise AssertionError("deleting a missing key must raise KeyError")
+
+# Freed observations are reused, and must come back without the assigned keys.
+del obs
+for i in range(10):
+    assert 'station' not in predict.Satellite(TLE.split('\n')).observe(T, QTH)
+
+# An observation assigned to can be part of a cycle, which the garbage collector must break.
+class Probe(object):
+    pass
+
+
+probe = Probe()
+gone = weakref.ref(probe)
+obs = predict.Satellite(TLE.split('\n')).observe(T, QTH)
+obs['probe'] = probe
+probe.obs = obs
+assert gc.is_tracked(obs)
+del obs, probe
+gc.collect()
+assert gone() is None, "a cycle through an observation must be collected"
+
+# Observing a subset of the fields skips the work of the others, but not a bit of their values.
+satellite = predict.Satellite(TLE.split('\n'))
+TIMES = [T + 60 * i for i in range(30)]
+full = satellite.observe_many(TIMES, QTH)
+for fields in (('azimuth', 'elevation'), ('sunlit', 'eclipse_depth'), ('latitude', 'longitude', 'altitude', 'footprint'),
+               ('decayed',), ('x', 'y', 'z', 'doppler'), ('visibility',)):
+    observed = satellite.observe(T, QTH, fields)
+    assert all(observed[k] == expected[k] for k in fields), fields
+    numeric = [k for k in fields if k in full]
+    if numeric:
+        many = satellite.observe_many(TIMES, QTH, numeric)
+        assert sorted(many) == sorted(numeric) and all(many[k] == full[k] for k in numeric), fields
+
+# observe_records keeps whole observations in rows exported through the buffer protocol.
+records = satellite.observe_records(TIMES, QTH)
+assert len(records) == len(TIMES)
+assert all(record == satellite.observe(t, QTH) for record, t in zip(records, TIMES))
+view = memoryview(records)
+assert view.shape == (len(TIMES),) and view.nbytes == len(TIMES) * view.itemsize
+assert records[-1]['epoch'] == struct.unpack_from('<d', view.tobytes(), (len(TIMES) - 1) * view.itemsize)[0]
+del view
+assert satellite.observe_records([t + 3600 for t in TIMES], QTH, out=records) is records
+assert records[0] == satellite.observe(T + 3600, QTH)
+try:
+    import numpy
+except ImportError:
+    numpy = None
+if numpy is not None:
+    rows = numpy.asarray(records)
+    assert rows.shape == (len(TIMES),)
+    later = satellite.observe_many([t + 3600 for t in TIMES], QTH)
+    assert all(list(rows[k]) == list(later[k]) for k in later)
+    assert rows['name'][0].decode() == expected['name'] and rows['orbital_model'][0].decode() == expected['orbital_model']
+
+print("observations round-trip through json, pickle and copy, subsets of fields match, and records export")
@@ -0,0 +1,75 @@
+"""
+Checks observing from many ground stations at once against observing from each in turn:
+Satellite.observe_stations must give what Satellite.observe does from every station, and a
+range_rate that observe reports only as its doppler.  Catalog.visibility's bits must say just
+when Satellite.observe finds each satellite at or above the minimum elevation from each station.
+"""
+import predict
+
+TLES = [
+    '0 OBJECT NY\n1 43550U 98067NY  19009.55938219 +.00013482 +00000-0 +17279-3 0  9995\n2 43550 051.6378 066.3469 0004106 279.6394 080.4135 15.59492665028120',
+    '0 LEMUR 1\n1 40044U 14033AL  15013.74135905  .00002013  00000-0  31503-3 0  6119\n2 40044 097.9584 269.2923 0059425 258.2447 101.2095 14.72707190 30443',
+]
+T = 1547051000.0
+
+
+def checksum(line):
+    return str(sum(int(c) if c.isdigit() else (c == '-') for c in line) % 10)
+
+
+# Deep-space satellites, with the epoch of the first of TLES: a Molniya orbit, GPS and geostationary.
+for catnum, incl, ecc, mean_motion in ((90001, 63.4, 7200000, 2.00563), (90002, 55.0, 100000, 2.00562), (90003, 0.05, 2000, 1.00272)):
+    line1 = '1 %05dU 19001A   19009.55938219  .00000000  00000-0  00000+0 0  999' % catnum
+    line2 = '2 %05d %8.4f 066.3469 %07d 270.0000 080.4135 %11.8f  100' % (catnum, incl, ecc, mean_motion)
+    TLES.append('0 DEEP %d\n%s%s\n%s%s' % (catnum, line1, checksum(line1), line2, checksum(line2)))
+LOOK = ('azimuth', 'elevation', 'slant_range', 'doppler')
+
+# Stations all over the world, poles and the antimeridian included, at sea level and up mountains.
+QTHS = [(lat, lon, alt) for lat in (-90, -60, -33.9, 0, 37.771034, 64.8, 90)
+        for lon in (-180, -122.4, 0, 45, 122.413815, 179.9) for alt in (0, 2400)]
+stations = predict.Stations(QTHS)
+# Stations are read with the GIL released, so they can't be made over once made.
+stations.__init__(QTHS[:1])
+assert len(stations) == len(QTHS)
+
+looked = 0
+for tle in TLES:
+    satellite = predict.Satellite(tle.split('\n'))
+    for t in (T, T + 1234.5, T + 86400):
+        for given in (stations, QTHS):
+            looks = satellite.observe_stations(t, given)
+            for j, qth in enumerate(QTHS):
+                expected = satellite.observe(t, qth)
+                got = tuple(looks[k][j] for k in LOOK)
+                assert got == tuple(expected[k] for k in LOOK), "from %r at %f: %r, not %r" % (qth, t, got, tuple(expected[k] for k in LOOK))
+                assert -100.0e06 * ((looks['range_rate'][j] * 1000.0) / 299792458.0) == expected['doppler']
+                looked += 1
+
+print("observe_stations matches observe from %d stations, %d looks" % (len(QTHS), looked))
+
+catalog = predict.Catalog([tle.split('\n') for tle in TLES])
+satellites = [predict.Satellite(tle.split('\n')) for tle in TLES]
+QTHS = QTHS[::3]
+STEP, STEPS = 97.0, 300
+row = (STEPS + 7) // 8
+
+set_bits = 0
+for min_elevation in (0, 10):
+    for threads in (1, 0):
+        bits = catalog.visibility(QTHS, T, STEP, STEPS, min_elevation, threads)
+        assert len(bits) == len(catalog) * len(QTHS) * row
+        for tle, satellite in zip(TLES, satellites):
+            i = catalog.index(int(tle.split('\n')[1][2:7]))
+            for j, qth in enumerate(QTHS):
+                for k in range(STEPS):
+                    visible = satellite.observe(T + k * STEP, qth)['elevation'] >= min_elevation
+                    bit = bits[(i * len(QTHS) + j) * row + k // 8] >> (k % 8) & 1
+                    assert bit == visible, "satellite %d from %r at step %d: bit %d" % (i, qth, k, bit)
+                    set_bits += bit
+        expected = bytes(bits)
+        bits[:] = bytes(len(bits))
+        assert catalog.visibility(QTHS, T, STEP, STEPS, min_elevation, threads, out=bits) is bits
+        assert bits == expected
+
+print("visibility matches observe elevations over %d steps from %d stations, %d bits set"
+      % (STEPS, len(QTHS), set_bits))
@@ -0,0 +1,61 @@
+"""
+Checks that pass prediction scales across threads now that cpredict releases the GIL
+while propagating.  Speedup is only asserted when there is more than one core to use.
+"""
+import os
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import predict
+
+TLES = [
+    '0 OBJECT NY\n1 43550U 98067NY  19009.55938219 +.00013482 +00000-0 +17279-3 0  9995\n2 43550 051.6378 066.3469 0004106 279.6394 080.4135 15.59492665028120',
+    '0 LEMUR 1\n1 40044U 14033AL  15013.74135905  .00002013  00000-0  31503-3 0  6119\n2 40044 097.9584 269.2923 0059425 258.2447 101.2095 14.72707190 30443',
+]
+QTH = (37.771034, 122.413815, 7)
+PASSES = 200
+START = time.time()
+
+def checksum(line):
+    return str(sum(int(c) if c.isdigit() else (1 if c == '-' else 0) for c in line[:68]) % 10)
+
+# quick_predict refuses times more than a year from the TLE, so move the epoch to today.
+def refresh(tle):
+    name, line1, line2 = tle.split('\n')
+    now = time.gmtime()
+    epoch = '%02d%012.8f' % (now.tm_year % 100, now.tm_yday)
+    line1 = line1[:18] + epoch + line1[32:68]
+    return [name, line1 + checksum(line1), line2]
+
+def job(tle):
+    satellite = predict.Satellite(tle)
+    ts, out = START, []
+    for _ in range(PASSES):
+        out.append(predict.quick_predict(tle, ts, QTH)[-1]['epoch'])
+        out.append(satellite.passes(QTH, ts, None, 1)[0])
+        ts = out[-2] + 60
+    return out
+
+def timed(workers, jobs):
+    start = time.time()
+    if workers == 1:
+        results = [job(tle) for tle in jobs]
+    else:
+        with ThreadPoolExecutor(max_workers=workers) as pool:
+            results = list(pool.map(job, jobs))
+    return time.time() - start, results
+
+cores = len(os.sched_getaffinity(0)) if hasattr(os, 'sched_getaffinity') else os.cpu_count()
+workers = max(2, min(cores, 8))
+jobs = [refresh(TLES[i % len(TLES)]) for i in range(2 * workers)]
+
+serial, expected = timed(1, jobs)
+threaded, results = timed(workers, jobs)
+assert results == expected, "threaded results differ from serial results"
+
+speedup = serial / threaded
+print("%d threads on %d cores: serial %.2fs, threaded %.2fs, speedup %.2fx" % (workers, cores, serial, threaded, speedup))
+if cores > 1:
+    assert speedup > 0.7 * workers, "expected near-linear speedup, got %.2fx with %d threads" % (speedup, workers)
+else:
+    print("single core, speedup not checked")
@@ -0,0 +1,64 @@
+"""
+Checks the passes Satellite.passes and Satellite.transits find against Satellite.observe: each
+must start and end above the horizon, within its tolerance of the satellite rising and setting,
+and the iterators of Satellite.transits and predict.transits must find the same ones, their
+peaks within the tolerance of the maximum elevation.
+Times reach SGP4 as Julian dates, whose last place is some 40 microseconds, so the horizon is only
+found to within that: each end is allowed SLACK seconds further inside the pass.
+"""
+import predict
+
+TLES = [
+    ('0 OBJECT NY\n1 43550U 98067NY  19009.55938219 +.00013482 +00000-0 +17279-3 0  9995\n2 43550 051.6378 066.3469 0004106 279.6394 080.4135 15.59492665028120', 1547051000.0),
+    ('0 LEMUR 1\n1 40044U 14033AL  15013.74135905  .00002013  00000-0  31503-3 0  6119\n2 40044 097.9584 269.2923 0059425 258.2447 101.2095 14.72707190 30443', 1421198000.0),
+]
+QTHS = [(37.771034, 122.413815, 7), (-33.9, -18.4, 40), (51.5, 0.1, 20)]
+DAYS = 3
+SLACK = 1e-4
+FLAT = 1e-9  # degrees
+
+
+def checksum(line):
+    return str(sum(int(c) if c.isdigit() else (c == '-') for c in line) % 10)
+
+
+# A Molniya orbit, whose passes last hours, with the epoch of the first of TLES.
+line1 = '1 90001U 19001A   19009.55938219  .00000000  00000-0  00000+0 0  999'
+line2 = '2 90001  63.4000 066.3469 7200000 270.0000 080.4135  2.00563000  100'
+TLES.append(('0 MOLNIYA\n%s%s\n%s%s' % (line1, checksum(line1), line2, checksum(line2)), 1547051000.0))
+
+found = 0
+for tle, start in TLES:
+    satellite = predict.Satellite(tle.split('\n'))
+    for qth in QTHS:
+        elevation = lambda t: satellite.observe(t, qth)['elevation']
+        for tolerance in (0.1, 1.0, 0.01):
+            passes = satellite.passes(qth, start, start + DAYS * 86400, 1000, tolerance)
+            assert passes, "no passes of %s over %r" % (tle.split('\n')[0], qth)
+            for aos, los in passes:
+                assert aos < los
+                assert elevation(aos + SLACK) >= 0 > elevation(aos - tolerance), "AOS %f of %s over %r" % (aos, tle.split('\n')[0], qth)
+                assert elevation(los - SLACK) >= 0 > elevation(los + tolerance), "LOS %f of %s over %r" % (los, tle.split('\n')[0], qth)
+                found += 1
+
+            # The Transits iterator finds the same passes, and predict.transits wraps them
+            times = list(satellite.transits(qth, start, start + DAYS * 86400, tolerance))
+            assert [(aos, los) for aos, los, _ in times] == passes
+            for aos, los, peak in times:
+                assert aos <= peak <= los
+                # The maximum is within tolerance: rising before, falling after, but for rounding
+                # where the top of a pass hours long is as flat as a double can tell
+                d = tolerance / 10
+                for top in (peak, satellite.peak(qth, aos, los, tolerance)):
+                    assert elevation(max(aos, top - tolerance)) <= elevation(max(aos, top - tolerance) + d) + FLAT, "peak %f over %r" % (top, qth)
+                    assert elevation(min(los, top + tolerance)) <= elevation(min(los, top + tolerance) - d) + FLAT, "peak %f over %r" % (top, qth)
+            if tolerance == 0.1:
+                transits = list(predict.transits(tle, qth, start, start + DAYS * 86400))
+                assert [(transit.start, transit.end, transit.peak_time) for transit in transits] == [tuple(t) for t in times]
+
+            # Without ending_before there is no end, and a pass in progress comes first
+            aos, los = passes[0]
+            current = next(iter(satellite.transits(qth, (aos + los) / 2, None, tolerance)))
+            assert abs(current.start - aos) <= tolerance and abs(current.end - los) <= tolerance
+
+print("%d passes start and end within their tolerance of the horizon" % found)